@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <array>
+#include <optional>
+
+namespace my_redis::bench
+{
+    enum class Op : types::u8
+    {
+        GET,
+        SET,
+        DEL
+    };
+    constexpr types::size K_OP_COUNT = 3;
+
+    constexpr const char *opName(Op op) noexcept
+    {
+        switch (op)
+        {
+            case Op::GET: return "GET";
+            case Op::SET: return "SET";
+            case Op::DEL: return "DEL";
+            default: return "?";
+        }
+    }
+
+    // Benchmark settings, filled from the command line
+    struct Options
+    {
+        const char *host = "127.0.0.1";
+        types::u16 port = 9999;
+        types::u32 connections = 50;
+        types::u32 threads = 1;
+        types::u32 pipeline = 1;                // Requests in flight per connection
+        types::u64 requests = 100'000;          // Total requests, unless `duration` is set
+        types::u32 duration = 0;                // Seconds
+        types::u64 rate = 0;                    // Requests per second across all connections, 0: as fast as possible
+        types::u64 keyspace = 100'000;
+        types::u32 valueSize = 64;
+        double zipf = 0.0;                      // Skew of the key distribution in [0, 1), 0: uniform
+        std::array<types::u32, K_OP_COUNT> mix{ 80, 20, 0 };   // Weights of GET, SET, DEL
+        bool prefill = false;                   // SET every key before the measurement
+    };
+
+    // Parse command line arguments. Returns std::nullopt on invalid arguments.
+    std::optional<Options> parseArgs(int argc, char *argv[]);
+
+    // Print command line usage to stderr
+    void printUsage(const char *program);
+
+} // namespace my_redis::bench
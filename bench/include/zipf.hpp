@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cmath>
+#include <random>
+
+namespace my_redis::bench
+{
+    // Zipfian integers in [0, n), rank 0 being the most frequent.
+    // Gray et al., "Quickly Generating Billion-Record Synthetic Databases", as used by YCSB:
+    // constant time per sample after an O(n) precomputation of zeta(n). `theta` must be in
+    // [0, 1), 0 draws uniformly.
+    class Zipf
+    {
+    public:
+        Zipf(types::u64 n, double theta) : m_N(n), m_Theta(theta)
+        {
+            if (theta == 0.0)
+                return;
+
+            m_ZetaN = zeta(n, theta);
+            m_Alpha = 1.0 / (1.0 - theta);
+            m_Eta = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) / (1.0 - zeta(2, theta) / m_ZetaN);
+            m_Half = 1.0 + std::pow(0.5, theta);
+        }
+
+        template <typename Rng>
+        types::u64 operator()(Rng &rng) const
+        {
+            if (m_Theta == 0.0)
+                return std::uniform_int_distribution<types::u64>{ 0, m_N - 1 }(rng);
+
+            double u = std::uniform_real_distribution<double>{ 0.0, 1.0 }(rng);
+            double uz = u * m_ZetaN;
+            if (uz < 1.0)
+                return 0;
+            if (uz < m_Half)
+                return 1 % m_N;
+
+            auto rank = static_cast<types::u64>(static_cast<double>(m_N) * std::pow(m_Eta * u - m_Eta + 1.0, m_Alpha));
+            return rank < m_N ? rank : m_N - 1;
+        }
+
+    private:
+        static double zeta(types::u64 n, double theta)
+        {
+            double sum = 0.0;
+            for (types::u64 i = 1; i <= n; ++i)
+                sum += 1.0 / std::pow(static_cast<double>(i), theta);
+            return sum;
+        }
+
+    private:
+        types::u64 m_N;
+        double m_Theta;
+        double m_ZetaN = 0.0;
+        double m_Alpha = 0.0;
+        double m_Eta = 0.0;
+        double m_Half = 0.0;
+    };
+} // namespace my_redis::bench
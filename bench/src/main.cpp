@@ -0,0 +1,453 @@
+#include "options.hpp"
+#include "zipf.hpp"
+
+#include "buffer.hpp"
+#include "response.hpp"
+#include "socket.hpp"
+#include "stats.hpp"
+
+#include <netinet/tcp.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+    using bench::Op;
+    using bench::Options;
+
+    constexpr u32 K_PREFILL_DEPTH = 64;     // Pipeline depth of the prefill, whatever -P is
+    constexpr size K_READ_CHUNK = 64 * 1024;
+
+    u64 nowNs() noexcept
+    {
+        return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Append a request: | len | nargs | len1 | arg1 | ... | lenN | argN |
+    void appendRequest(std::vector<u8> &out, std::initializer_list<std::string_view> args)
+    {
+        u32 len = 4;
+        for (auto arg : args)
+            len += 4 + static_cast<u32>(arg.size());
+
+        auto put = [&out](const void *data, size n) {
+            const auto *bytes = static_cast<const u8 *>(data);
+            out.insert(out.end(), bytes, bytes + n);
+        };
+
+        u32 nargs = static_cast<u32>(args.size());
+        put(&len, 4);
+        put(&nargs, 4);
+        for (auto arg : args)
+        {
+            u32 argLen = static_cast<u32>(arg.size());
+            put(&argLen, 4);
+            put(arg.data(), arg.size());
+        }
+    }
+
+    // Outcome of asking a workload for the next request of a connection
+    enum class Issue
+    {
+        SENT,
+        LATER,  // Not due yet on this connection, see `Connection::nextSendNs`
+        DONE    // No more requests for any connection
+    };
+
+    struct InFlight
+    {
+        Op op;
+        u64 startNs;    // Intended send time in fixed-rate mode, actual send time otherwise
+    };
+
+    struct Connection
+    {
+        sockets::Socket socket;
+        std::vector<u8> out;
+        size outSent = 0;
+        buffer::Buffer in;
+        std::deque<InFlight> inFlight;  // Responses come back in request order
+        u64 nextSendNs = 0;             // Schedule of the fixed-rate mode
+    };
+
+    sockets::Socket connectTo(const Options &options)
+    {
+        sockets::Socket socket{ ::socket(AF_INET, SOCK_STREAM, 0) };
+        sockets::Endpoint endpoint{ options.host, options.port };
+        auto addr = endpoint.sockaddr();
+        if (!socket.isValid() || -1 == ::connect(socket.fd(), (const struct sockaddr *)&addr, endpoint.socklen()))
+            return sockets::Socket{};
+
+        // Pipelined requests are small, do not let Nagle hold them back
+        int one = 1;
+        ::setsockopt(socket.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        socket.setNonBlock();
+        return socket;
+    }
+
+    // Requests still to be issued, shared by the workers
+    struct Budget
+    {
+        std::atomic<u64> issued{ 0 };
+        u64 total = 0;          // Request count mode
+        u64 deadlineNs = 0;     // Duration mode, when non zero
+    };
+
+    class Worker
+    {
+    public:
+        Worker(const Options &options, u32 id, u32 connections)
+            : m_Options(options),
+              m_Rng(0x9E3779B97F4A7C15ull * (id + 1)),
+              m_Zipf(options.keyspace, options.zipf),
+              m_Value(options.valueSize, 'x')
+        {
+            for (u32 i = 0; i < connections; ++i)
+            {
+                auto &connection = m_Connections.emplace_back(std::make_unique<Connection>());
+                connection->socket = connectTo(options);
+            }
+        }
+
+        bool connected() const noexcept
+        {
+            return std::ranges::all_of(m_Connections, [](const auto &c) { return c->socket.isValid(); });
+        }
+
+        // SET the keys in [begin, end)
+        void prefill(u64 begin, u64 end)
+        {
+            drive(K_PREFILL_DEPTH, false, [&](Connection &, u64 now, InFlight &request) {
+                if (begin == end)
+                    return Issue::DONE;
+                issue(request, Op::SET, begin++, now);
+                return Issue::SENT;
+            });
+        }
+
+        // The measured run. `firstConnection` staggers the fixed-rate schedules of all connections.
+        void run(Budget &budget, u64 startNs, u32 firstConnection)
+        {
+            u64 interval = 0;
+            if (m_Options.rate > 0)
+            {
+                interval = 1'000'000'000ull * m_Options.connections / m_Options.rate;
+                for (size i = 0; i < m_Connections.size(); ++i)
+                    m_Connections[i]->nextSendNs = startNs + (firstConnection + i) * 1'000'000'000ull / m_Options.rate;
+            }
+
+            drive(m_Options.pipeline, true, [&](Connection &connection, u64 now, InFlight &request) {
+                if (interval > 0 && connection.nextSendNs > now)
+                    return Issue::LATER;
+
+                if (budget.deadlineNs ? now >= budget.deadlineNs
+                                      : budget.issued.fetch_add(1, std::memory_order_relaxed) >= budget.total)
+                    return Issue::DONE;
+
+                // Latency counts from when the request should have been sent, so a
+                // stalled server is charged for the requests it kept from being sent
+                u64 start = now;
+                if (interval > 0)
+                {
+                    start = connection.nextSendNs;
+                    connection.nextSendNs += interval;
+                }
+                issue(request, pickOp(), m_Zipf(m_Rng), start);
+                return Issue::SENT;
+            });
+        }
+
+        const stats::Histogram &latency(Op op) const noexcept { return m_Latency[static_cast<size>(op)]; }
+        u64 errors() const noexcept { return m_Errors; }
+
+    private:
+        Op pickOp()
+        {
+            const auto &mix = m_Options.mix;
+            u32 roll = std::uniform_int_distribution<u32>{ 0, mix[0] + mix[1] + mix[2] - 1 }(m_Rng);
+            if (roll < mix[0])
+                return Op::GET;
+            return roll < mix[0] + mix[1] ? Op::SET : Op::DEL;
+        }
+
+        // Encode a request for `key` into `m_Pending`
+        void issue(InFlight &request, Op op, u64 key, u64 startNs)
+        {
+            char name[32] = "key:";
+            auto end = std::to_chars(name + 4, name + sizeof(name), key).ptr;
+            std::string_view keyName{ name, static_cast<size>(end - name) };
+
+            m_Pending.clear();
+            switch (op)
+            {
+                case Op::GET: appendRequest(m_Pending, { "get", keyName }); break;
+                case Op::SET: appendRequest(m_Pending, { "set", keyName, m_Value }); break;
+                case Op::DEL: appendRequest(m_Pending, { "del", keyName }); break;
+            }
+            request = { op, startNs };
+        }
+
+        // Keep up to `depth` requests in flight on every connection, taking them from
+        // `next(connection, now, request)` until it is done and every response arrived
+        template <typename Next>
+        void drive(u32 depth, bool record, Next &&next)
+        {
+            std::vector<pollfd> fds(m_Connections.size());
+            bool done = false;
+
+            while (true)
+            {
+                u64 now = nowNs();
+                bool waiting = false;
+                u64 wakeAt = ~u64{ 0 };     // Earliest request due later
+
+                for (auto &connection : m_Connections)
+                {
+                    while (!done && connection->inFlight.size() < depth)
+                    {
+                        InFlight request{};
+                        Issue result = next(*connection, now, request);
+                        if (result == Issue::DONE)
+                            done = true;
+                        else if (result == Issue::LATER)
+                            wakeAt = std::min(wakeAt, connection->nextSendNs);
+                        if (result != Issue::SENT)
+                            break;
+
+                        connection->out.insert(connection->out.end(), m_Pending.begin(), m_Pending.end());
+                        connection->inFlight.push_back(request);
+                    }
+
+                    flush(*connection);
+                    waiting |= !connection->inFlight.empty();
+                }
+
+                if (done && !waiting)
+                    return;
+
+                for (size i = 0; i < m_Connections.size(); ++i)
+                {
+                    const Connection &connection = *m_Connections[i];
+                    fds[i].fd = connection.socket.fd();
+                    fds[i].events = static_cast<short>((connection.inFlight.empty() ? 0 : POLLIN) |
+                                                       (connection.outSent < connection.out.size() ? POLLOUT : 0));
+                    fds[i].revents = 0;
+                }
+
+                timespec timeout{};
+                timespec *timeoutPtr = nullptr;
+                if (!done && wakeAt != ~u64{ 0 })
+                {
+                    u64 wait = wakeAt > now ? wakeAt - now : 0;
+                    timeout.tv_sec = static_cast<time_t>(wait / 1'000'000'000);
+                    timeout.tv_nsec = static_cast<long>(wait % 1'000'000'000);
+                    timeoutPtr = &timeout;
+                }
+
+                if (-1 == ::ppoll(fds.data(), fds.size(), timeoutPtr, nullptr) && errno != EINTR)
+                {
+                    std::perror("ppoll()");
+                    return;
+                }
+
+                now = nowNs();
+                for (size i = 0; i < m_Connections.size(); ++i)
+                {
+                    if (fds[i].revents & (POLLIN | POLLERR | POLLHUP))
+                    {
+                        if (!receive(*m_Connections[i], now, record))
+                            return;
+                    }
+                }
+            }
+        }
+
+        void flush(Connection &connection)
+        {
+            while (connection.outSent < connection.out.size())
+            {
+                auto n = ::write(connection.socket.fd(), connection.out.data() + connection.outSent,
+                                 connection.out.size() - connection.outSent);
+                if (n < 0)
+                    break;
+                connection.outSent += static_cast<size>(n);
+            }
+
+            if (connection.outSent == connection.out.size())
+            {
+                connection.out.clear();
+                connection.outSent = 0;
+            }
+        }
+
+        // Read what is available and complete the requests whose response arrived
+        bool receive(Connection &connection, u64 now, bool record)
+        {
+            while (true)
+            {
+                // Read straight into the free space of the buffer, no zero-filling
+                u8 *buffer = connection.in.prepare(K_READ_CHUNK);
+                auto n = ::read(connection.socket.fd(), buffer, connection.in.writable());
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+                {
+                    std::fprintf(stderr, "> Connection lost with %zu request(s) in flight\n", connection.inFlight.size());
+                    return false;
+                }
+                if (n < 0)
+                    break;
+                connection.in.commit(static_cast<size>(n));
+            }
+
+            // | len | status | data |, decoded in place
+            while (connection.in.size() >= 4 && !connection.inFlight.empty())
+            {
+                u32 len = 0;
+                std::memcpy(&len, connection.in.data(), 4);
+                if (connection.in.size() - 4 < len)
+                    break;
+
+                Response::Status status = Response::Status::RES_ERR;
+                if (len >= 4)
+                    std::memcpy(&status, connection.in.data() + 4, 4);
+                connection.in.consume(4 + len);
+
+                InFlight request = connection.inFlight.front();
+                connection.inFlight.pop_front();
+                if (status == Response::Status::RES_ERR)
+                    m_Errors++;
+                if (record)
+                    m_Latency[static_cast<size>(request.op)].record(now > request.startNs ? now - request.startNs : 0);
+            }
+            return true;
+        }
+
+    private:
+        const Options &m_Options;
+        std::vector<std::unique_ptr<Connection>> m_Connections;
+        std::mt19937_64 m_Rng;
+        bench::Zipf m_Zipf;
+        std::string m_Value;
+        std::vector<u8> m_Pending;      // Encoded request handed out by `issue()`
+
+        std::array<stats::Histogram, bench::K_OP_COUNT> m_Latency;
+        u64 m_Errors = 0;
+    };
+
+    void printRow(const char *name, const stats::Summary &summary, double seconds)
+    {
+        auto usec = [](u64 ns) { return static_cast<double>(ns) / 1000.0; };
+        std::printf("%-6s %12llu %12.0f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+                    static_cast<unsigned long long>(summary.count), summary.count / seconds, summary.mean() / 1000.0,
+                    usec(summary.percentile(0.50)), usec(summary.percentile(0.90)), usec(summary.percentile(0.99)),
+                    usec(summary.percentile(0.999)), usec(summary.max));
+    }
+
+    // Run `fn(worker, index)` on one thread per worker
+    template <typename Fn>
+    void onEveryWorker(std::vector<std::unique_ptr<Worker>> &workers, Fn &&fn)
+    {
+        std::vector<std::thread> threads;
+        for (size i = 0; i < workers.size(); ++i)
+            threads.emplace_back([&, i] { fn(*workers[i], static_cast<u32>(i)); });
+        for (auto &thread : threads)
+            thread.join();
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    auto options = bench::parseArgs(argc, argv);
+    if (!options)
+    {
+        bench::printUsage(argv[0]);
+        return 1;
+    }
+
+    // Connections are spread evenly over the threads
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<u32> firstConnection;
+    for (u32 t = 0, first = 0; t < options->threads; ++t)
+    {
+        u32 count = options->connections / options->threads + (t < options->connections % options->threads ? 1 : 0);
+        workers.emplace_back(std::make_unique<Worker>(*options, t, count));
+        firstConnection.push_back(first);
+        first += count;
+
+        if (!workers.back()->connected())
+        {
+            std::fprintf(stderr, "> Failed to connect to %s:%u : %s\n", options->host, options->port, std::strerror(errno));
+            return 1;
+        }
+    }
+
+    if (options->prefill)
+    {
+        u64 begin = nowNs();
+        onEveryWorker(workers, [&](Worker &worker, u32 t) {
+            worker.prefill(options->keyspace * t / options->threads, options->keyspace * (t + 1) / options->threads);
+        });
+        std::printf("Prefilled %llu keys in %.2f s\n", static_cast<unsigned long long>(options->keyspace),
+                    static_cast<double>(nowNs() - begin) / 1e9);
+    }
+
+    Budget budget;
+    budget.total = options->requests;
+    u64 start = nowNs();
+    if (options->duration > 0)
+        budget.deadlineNs = start + options->duration * 1'000'000'000ull;
+
+    onEveryWorker(workers, [&](Worker &worker, u32 t) { worker.run(budget, start, firstConnection[t]); });
+    double seconds = static_cast<double>(nowNs() - start) / 1e9;
+
+    std::printf("%u connection(s), %u thread(s), pipeline %u, %llu keys (%s %.2f), %u byte values, mix %u:%u:%u\n",
+                options->connections, options->threads, options->pipeline,
+                static_cast<unsigned long long>(options->keyspace), options->zipf > 0 ? "zipf" : "uniform", options->zipf,
+                options->valueSize, options->mix[0], options->mix[1], options->mix[2]);
+    if (options->rate > 0)
+        std::printf("Fixed rate of %llu requests/s, latency measured from the intended send time\n",
+                    static_cast<unsigned long long>(options->rate));
+    else
+        std::printf("Closed loop, latency measured from the actual send time\n");
+
+    std::printf("\n%-6s %12s %12s %10s %10s %10s %10s %10s %10s\n", "op", "requests", "ops/s",
+                "avg(us)", "p50", "p90", "p99", "p99.9", "max");
+
+    stats::Summary all;
+    u64 errors = 0;
+    for (size i = 0; i < bench::K_OP_COUNT; ++i)
+    {
+        auto op = static_cast<Op>(i);
+        stats::Summary summary;
+        for (const auto &worker : workers)
+        {
+            summary.add(worker->latency(op));
+            all.add(worker->latency(op));
+        }
+        if (summary.count > 0)
+            printRow(bench::opName(op), summary, seconds);
+    }
+    printRow("ALL", all, seconds);
+
+    for (const auto &worker : workers)
+        errors += worker->errors();
+    std::printf("\n%.2f s, %llu error response(s)\n", seconds, static_cast<unsigned long long>(errors));
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "options.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <string_view>
+
+namespace my_redis::bench
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        // Unsigned integer in [min, max]
+        bool parseNumber(const char *text, u64 min, u64 max, u64 &out)
+        {
+            char *end = nullptr;
+            errno = 0;
+            auto value = std::strtoull(text, &end, 10);
+            if (errno != 0 || end == text || *end != '\0' || value < min || value > max)
+                return false;
+            out = value;
+            return true;
+        }
+
+        // "get:set:del" weights, e.g. "80:20:0"
+        bool parseMix(const char *text, std::array<u32, K_OP_COUNT> &mix)
+        {
+            unsigned get = 0, set = 0, del = 0;
+            int consumed = 0;
+            if (std::sscanf(text, "%u:%u:%u%n", &get, &set, &del, &consumed) != 3 || text[consumed] != '\0')
+                return false;
+            if (get + set + del == 0)
+                return false;
+            mix = { get, set, del };
+            return true;
+        }
+    } // namespace
+
+    std::optional<Options> parseArgs(int argc, char *argv[])
+    {
+        Options options{};
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg{ argv[i] };
+
+            if (arg == "--prefill")
+            {
+                options.prefill = true;
+                continue;
+            }
+
+            // Every other option takes exactly one value
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "> Missing value for option '%s'\n", argv[i]);
+                return std::nullopt;
+            }
+            const char *value = argv[++i];
+
+            u64 number = 0;
+            bool valid = true;
+            if (arg == "-h")
+                options.host = value;
+            else if (arg == "-p")
+            {
+                valid = parseNumber(value, 1, 65535, number);
+                options.port = static_cast<u16>(number);
+            }
+            else if (arg == "-c")
+            {
+                valid = parseNumber(value, 1, 100'000, number);
+                options.connections = static_cast<u32>(number);
+            }
+            else if (arg == "-t")
+            {
+                valid = parseNumber(value, 1, 256, number);
+                options.threads = static_cast<u32>(number);
+            }
+            else if (arg == "-P")
+            {
+                valid = parseNumber(value, 1, 65'536, number);
+                options.pipeline = static_cast<u32>(number);
+            }
+            else if (arg == "-n")
+                valid = parseNumber(value, 1, ~u64{ 0 }, options.requests);
+            else if (arg == "-d")
+            {
+                valid = parseNumber(value, 1, 86'400, number);
+                options.duration = static_cast<u32>(number);
+            }
+            else if (arg == "--rate")
+                valid = parseNumber(value, 1, ~u64{ 0 }, options.rate);
+            else if (arg == "-k")
+                valid = parseNumber(value, 1, ~u64{ 0 } >> 1, options.keyspace);
+            else if (arg == "-s")
+            {
+                valid = parseNumber(value, 0, 16 << 20, number);
+                options.valueSize = static_cast<u32>(number);
+            }
+            else if (arg == "--zipf")
+            {
+                char *end = nullptr;
+                options.zipf = std::strtod(value, &end);
+                valid = end != value && *end == '\0' && options.zipf >= 0.0 && options.zipf < 1.0;
+            }
+            else if (arg == "--mix")
+                valid = parseMix(value, options.mix);
+            else
+            {
+                std::fprintf(stderr, "> Unknown option '%s'\n", argv[i - 1]);
+                return std::nullopt;
+            }
+
+            if (!valid)
+            {
+                std::fprintf(stderr, "> Invalid value '%s' for option '%s'\n", value, argv[i - 1]);
+                return std::nullopt;
+            }
+        }
+
+        if (options.threads > options.connections)
+            options.threads = options.connections;
+
+        return options;
+    }
+
+    void printUsage(const char *program)
+    {
+        std::fprintf(stderr, "Usage:\n"
+                             "  %s [options]\n"
+                             "Options:\n"
+                             "  -h <ip>              Server address (default: 127.0.0.1)\n"
+                             "  -p <port>            Server port (default: 9999)\n"
+                             "  -c <connections>     Connections, spread over the threads (default: 50)\n"
+                             "  -t <threads>         Client threads (default: 1)\n"
+                             "  -P <depth>           Requests in flight per connection (default: 1)\n"
+                             "  -n <requests>        Total requests (default: 100000)\n"
+                             "  -d <seconds>         Run for a duration instead of a request count\n"
+                             "  --rate <ops/s>       Fixed request rate, latency is measured from the intended\n"
+                             "                       send time to correct coordinated omission (default: unbounded)\n"
+                             "  -k <keys>            Key space size (default: 100000)\n"
+                             "  -s <bytes>           Value size of SET (default: 64)\n"
+                             "  --zipf <theta>       Zipfian key distribution, theta in [0, 1) (default: 0, uniform)\n"
+                             "  --mix <g:s:d>        Weights of GET, SET and DEL (default: 80:20:0)\n"
+                             "  --prefill            SET every key before the measurement\n", program);
+    }
+} // namespace my_redis::bench
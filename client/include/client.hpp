@@ -0,0 +1,132 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "response.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace my_redis::client
+{
+    /*
+        * Asynchronous client over a pool of pipelined connections.
+        *
+        * Requests are encoded by the calling thread into the pending buffer of a
+        * connection, and written by a single I/O thread. Every request queued while
+        * the I/O thread was busy goes out in the same write, so concurrent callers
+        * share one system call and one round trip. Responses are decoded in place from
+        * the read buffer, a `Reply` points into it and lives for its callback only.
+        *
+        * A calling thread always uses the same connection, so that its requests are
+        * sent, and answered, in order. The threads are spread over the pool.
+    */
+
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        types::u16 port = 9999;
+        std::string unixSocket;     // Connect to this unix domain socket instead, when set
+        types::u32 connections = 1;
+    };
+
+    // A response, valid only while the callback it was passed to runs
+    struct Reply
+    {
+        Response::Status status;
+        std::string_view data;
+
+        bool ok() const noexcept { return status != Response::Status::RES_ERR; }
+    };
+
+    // Reads the items of a RES_ARR reply without copying them
+    class ArrayReader
+    {
+    public:
+        explicit ArrayReader(std::string_view data) noexcept;
+
+        types::u32 count() const noexcept { return m_Count; }
+
+        // The next item, std::nullopt for a nil one. Returns false after the last item,
+        // or on a malformed reply.
+        bool next(std::optional<std::string_view> &item) noexcept;
+
+    private:
+        std::string_view m_Data;
+        types::u32 m_Count = 0;
+        types::u32 m_Read = 0;
+    };
+
+    // A response owning its data, handed over by the futures of `Client::call()`
+    struct Result
+    {
+        Response::Status status;
+        std::string data;
+    };
+
+    // Runs on the I/O thread, and must neither block nor throw. A request that cannot be
+    // sent, or whose connection is lost, gets a RES_ERR reply.
+    using Callback = std::function<void(const Reply &)>;
+
+    struct Connection;
+
+    class Client
+    {
+    public:
+        // Connects every connection of the pool, throws `errno_exception` on failure
+        explicit Client(const Options &options);
+        // Requests still in flight get a RES_ERR reply
+        ~Client();
+
+        Client(const Client &)              = delete;
+        Client &operator=(const Client &)   = delete;
+
+    public:
+        // Queue a request, `callback` receives its response. Thread-safe.
+        void send(std::span<const std::string_view> args, Callback callback);
+        void send(std::initializer_list<std::string_view> args, Callback callback)
+        {
+            send(std::span{ args.begin(), args.size() }, std::move(callback));
+        }
+
+        // Queue a request, the future receives a copy of its response. Thread-safe.
+        std::future<Result> call(std::span<const std::string_view> args);
+        std::future<Result> call(std::initializer_list<std::string_view> args)
+        {
+            return call(std::span{ args.begin(), args.size() });
+        }
+
+    private:
+        void wake() noexcept;
+        void ioLoop(std::stop_token stop);
+
+        // I/O thread only
+        void watch(Connection &connection, bool writable);
+        void flush(Connection &connection);
+        void receive(Connection &connection);
+        void fail(Connection &connection, std::string_view reason);
+        void reconnect(Connection &connection);
+        void finishConnect(Connection &connection);
+
+    private:
+        Options m_Options;
+        std::vector<std::unique_ptr<Connection>> m_Connections;
+        types::i32 m_EpollFd = -1;
+        types::i32 m_WakeFd = -1;
+        std::atomic<bool> m_WakePending{ false };  // Written to `m_WakeFd`, not handled yet
+        std::jthread m_Thread;
+    };
+
+    // Append a request to `out`: | len | nargs | len1 | arg1 | ... | lenN | argN |
+    void appendRequest(buffer::Buffer &out, std::span<const std::string_view> args);
+
+} // namespace my_redis::client
@@ -0,0 +1,509 @@
+#include "client.hpp"
+
+#include "exception.hpp"
+#include "socket.hpp"
+
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+namespace my_redis::client
+{
+    using namespace my_redis::types;
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection
+    {
+        std::mutex lock;
+        // Guarded by `lock`: requests queued by the callers, not handed to the I/O thread yet
+        buffer::Buffer queued;
+        std::vector<Callback> queuedCallbacks;
+        std::vector<Callback> refused;  // Sent while the whole pool was lost, failed by the I/O thread
+        bool broken = false;    // Lost and not reconnected yet, requests are refused
+
+        // I/O thread only
+        sockets::Socket socket;
+        buffer::Buffer out;             // Being written
+        buffer::Buffer in;
+        std::deque<Callback> inFlight;  // Responses come back in request order
+        bool writable = false;          // Waiting for EPOLLOUT
+        bool connecting = false;        // Non-blocking connect in progress, EPOLLOUT reports its outcome
+        Clock::time_point retryAt{};    // No reconnection attempt before
+    };
+
+    namespace
+    {
+        constexpr size K_MAX_EVENTS = 64;
+        constexpr size K_READ_CHUNK = 64 * 1024;
+        constexpr std::chrono::milliseconds K_RECONNECT_INTERVAL{ 1000 };
+
+        // Connection of the calling thread, in every pool
+        std::atomic<u32> g_nextSlot{ 0 };
+        thread_local u32 t_slot = g_nextSlot.fetch_add(1, std::memory_order_relaxed);
+
+        // Start connecting a non-blocking socket to the server. `pending` is set while
+        // the connection is still being set up, the socket turns writable once it is done.
+        sockets::Socket connectTo(const Options &options, bool &pending)
+        {
+            pending = false;
+            if (!options.unixSocket.empty())
+            {
+                // Unix sockets connect at once, or fail with EAGAIN on a full backlog
+                sockets::Socket socket{ ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) };
+                sockets::UnixEndpoint endpoint{ options.unixSocket.c_str() };
+                auto addr = endpoint.sockaddr();
+                if (!socket.isValid() || -1 == ::connect(socket.fd(), (const struct sockaddr *)&addr, endpoint.socklen()))
+                    return sockets::Socket{};
+                return socket;
+            }
+
+            sockets::Socket socket{ ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) };
+            if (!socket.isValid())
+                return socket;
+
+            // Batches are written as soon as they are formed, do not let Nagle hold them back
+            int one = 1;
+            ::setsockopt(socket.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            sockets::Endpoint endpoint{ options.host.c_str(), options.port };
+            auto addr = endpoint.sockaddr();
+            if (-1 == ::connect(socket.fd(), (const struct sockaddr *)&addr, endpoint.socklen()))
+            {
+                if (errno != EINPROGRESS)
+                    return sockets::Socket{};
+                pending = true;
+            }
+            return socket;
+        }
+
+        // Outcome of a non-blocking connect, once its socket turned writable. Sets errno on failure.
+        bool connected(const sockets::Socket &socket) noexcept
+        {
+            i32 error = 0;
+            socklen_t len = sizeof(error);
+            if (-1 == ::getsockopt(socket.fd(), SOL_SOCKET, SO_ERROR, &error, &len))
+                return false;
+            errno = error;
+            return error == 0;
+        }
+
+        // Block until a pending connect completes, for the callers that need the outcome
+        bool waitConnected(const sockets::Socket &socket) noexcept
+        {
+            pollfd fd{ .fd = socket.fd(), .events = POLLOUT, .revents = 0 };
+            while (-1 == ::poll(&fd, 1, -1))
+            {
+                if (errno != EINTR)
+                    return false;
+            }
+            return connected(socket);
+        }
+    } // namespace
+
+    ArrayReader::ArrayReader(std::string_view data) noexcept
+    {
+        if (data.size() < 4)
+            return;
+        std::memcpy(&m_Count, data.data(), 4);
+        m_Data = data.substr(4);
+    }
+
+    bool ArrayReader::next(std::optional<std::string_view> &item) noexcept
+    {
+        if (m_Read == m_Count || m_Data.size() < 4)
+            return false;
+
+        u32 len = 0;
+        std::memcpy(&len, m_Data.data(), 4);
+        m_Data.remove_prefix(4);
+        if (len == Response::K_NIL_LEN)
+            item.reset();
+        else
+        {
+            if (len > m_Data.size())
+                return false;
+            item = m_Data.substr(0, len);
+            m_Data.remove_prefix(len);
+        }
+
+        m_Read++;
+        return true;
+    }
+
+    Client::Client(const Options &options) : m_Options(options)
+    {
+        for (u32 i = 0; i < std::max(options.connections, 1u); ++i)
+        {
+            auto &connection = m_Connections.emplace_back(std::make_unique<Connection>());
+            bool pending = false;
+            connection->socket = connectTo(options, pending);
+            if (!connection->socket.isValid() || (pending && !waitConnected(connection->socket)))
+                throw exception::errno_exception{ "Client::Client(const Options &options) -> connect()" };
+        }
+
+        m_EpollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (-1 == m_EpollFd)
+            throw exception::errno_exception{ "Client::Client(const Options &options) -> epoll_create1()" };
+
+        m_WakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (-1 == m_WakeFd)
+        {
+            i32 error = errno;
+            ::close(m_EpollFd);
+            throw exception::errno_exception{ "Client::Client(const Options &options) -> eventfd()", error };
+        }
+
+        // The wake-up eventfd is told apart from the connections by a null pointer
+        epoll_event event{ .events = EPOLLIN, .data = { .ptr = nullptr } };
+        ::epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, m_WakeFd, &event);
+        for (auto &connection : m_Connections)
+        {
+            event = { .events = EPOLLIN, .data = { .ptr = connection.get() } };
+            ::epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, connection->socket.fd(), &event);
+        }
+
+        m_Thread = std::jthread{ [this](std::stop_token stop) { ioLoop(stop); } };
+    }
+
+    Client::~Client()
+    {
+        m_Thread.request_stop();
+        u64 one = 1;
+        [[maybe_unused]] auto n = ::write(m_WakeFd, &one, sizeof(one));
+        m_Thread.join();
+
+        ::close(m_WakeFd);
+        ::close(m_EpollFd);
+    }
+
+    void Client::send(std::span<const std::string_view> args, Callback callback)
+    {
+        // Another connection of the pool takes over while the thread's own one is lost
+        size count = m_Connections.size();
+        for (size i = 0; i < count; ++i)
+        {
+            Connection &connection = *m_Connections[(t_slot + i) % count];
+            {
+                std::lock_guard guard{ connection.lock };
+                if (connection.broken)
+                    continue;
+                appendRequest(connection.queued, args);
+                connection.queuedCallbacks.push_back(std::move(callback));
+            }
+            wake();
+            return;
+        }
+
+        // Callbacks only run on the I/O thread, it fails the request on the next wake-up
+        Connection &own = *m_Connections[t_slot % count];
+        {
+            std::lock_guard guard{ own.lock };
+            own.refused.push_back(std::move(callback));
+        }
+        wake();
+    }
+
+    std::future<Result> Client::call(std::span<const std::string_view> args)
+    {
+        auto promise = std::make_shared<std::promise<Result>>();
+        std::future<Result> future = promise->get_future();
+        send(args, [promise](const Reply &reply) {
+            promise->set_value(Result{ reply.status, std::string{ reply.data } });
+        });
+        return future;
+    }
+
+    void Client::wake() noexcept
+    {
+        // One write per batch: the callers queuing before the I/O thread wakes up share it
+        if (m_WakePending.exchange(true, std::memory_order_acq_rel))
+            return;
+
+        u64 one = 1;
+        [[maybe_unused]] auto n = ::write(m_WakeFd, &one, sizeof(one));
+    }
+
+    void Client::ioLoop(std::stop_token stop)
+    {
+        std::array<epoll_event, K_MAX_EVENTS> events;
+        while (!stop.stop_requested())
+        {
+            // Sleep until the next reconnection attempt is due, if any connection is lost
+            i32 timeout = -1;
+            auto now = Clock::now();
+            for (const auto &connection : m_Connections)
+            {
+                if (connection->socket.isValid())
+                    continue;
+                auto wait = std::chrono::ceil<std::chrono::milliseconds>(connection->retryAt - now).count();
+                auto due = static_cast<i32>(std::max<decltype(wait)>(wait, 0));
+                timeout = timeout < 0 ? due : std::min(timeout, due);
+            }
+
+            auto n = ::epoll_wait(m_EpollFd, events.data(), static_cast<i32>(events.size()), timeout);
+            if (-1 == n)
+            {
+                if (errno == EINTR)
+                    continue;
+                std::perror("epoll_wait()");
+                break;
+            }
+
+            for (i32 i = 0; i < n; ++i)
+            {
+                auto *connection = static_cast<Connection *>(events[i].data.ptr);
+                if (!connection)
+                {
+                    u64 counter = 0;
+                    [[maybe_unused]] auto r = ::read(m_WakeFd, &counter, sizeof(counter));
+                    // Acquire the requests queued before the callers saw the flag set
+                    m_WakePending.exchange(false, std::memory_order_acq_rel);
+                    for (auto &queued : m_Connections)
+                        flush(*queued);
+                    continue;
+                }
+
+                if (connection->connecting)
+                {
+                    finishConnect(*connection);
+                    continue;
+                }
+
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                    receive(*connection);
+                if ((events[i].events & EPOLLOUT) && connection->socket.isValid())
+                    flush(*connection);
+            }
+
+            for (auto &connection : m_Connections)
+                reconnect(*connection);
+        }
+
+        for (auto &connection : m_Connections)
+            fail(*connection, "client closed");
+    }
+
+    void Client::watch(Connection &connection, bool writable)
+    {
+        if (connection.writable == writable)
+            return;
+
+        epoll_event event{ .events = EPOLLIN | (writable ? EPOLLOUT : 0u), .data = { .ptr = &connection } };
+        ::epoll_ctl(m_EpollFd, EPOLL_CTL_MOD, connection.socket.fd(), &event);
+        connection.writable = writable;
+    }
+
+    // Take over the requests queued by the callers, and write as much as the socket accepts
+    void Client::flush(Connection &connection)
+    {
+        std::vector<Callback> refused;
+        {
+            std::lock_guard guard{ connection.lock };
+            refused.swap(connection.refused);
+            if (!connection.queuedCallbacks.empty())
+            {
+                // Swapping hands the drained storage back to the callers, no allocation in steady state
+                if (connection.out.empty())
+                    connection.out.swap(connection.queued);
+                else
+                {
+                    connection.out.append(connection.queued.data(), connection.queued.size());
+                    connection.queued.clear();
+                }
+
+                for (auto &callback : connection.queuedCallbacks)
+                    connection.inFlight.push_back(std::move(callback));
+                connection.queuedCallbacks.clear();
+            }
+        }
+
+        Reply notConnected{ Response::Status::RES_ERR, "not connected" };
+        for (auto &callback : refused)
+            callback(notConnected);
+
+        // Still connecting, EPOLLOUT stays registered for the outcome
+        if (connection.connecting)
+            return;
+
+        while (!connection.out.empty())
+        {
+            auto n = ::send(connection.socket.fd(), connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+            if (n >= 0)
+            {
+                connection.out.consume(static_cast<size>(n));
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+            {
+                watch(connection, true);
+                return;
+            }
+
+            fail(connection, "connection lost");
+            return;
+        }
+
+        watch(connection, false);
+    }
+
+    // Read what is available, and run the callbacks of the complete responses
+    void Client::receive(Connection &connection)
+    {
+        while (connection.socket.isValid())
+        {
+            // Room for the whole response being received, so that it ends up contiguous
+            size want = K_READ_CHUNK;
+            if (connection.in.size() >= 4)
+            {
+                u32 len = 0;
+                std::memcpy(&len, connection.in.data(), 4);
+                size missing = 4 + static_cast<size>(len) - connection.in.size();
+                want = std::max(want, missing);
+            }
+
+            auto n = ::recv(connection.socket.fd(), connection.in.prepare(want), want, 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno == EAGAIN)
+                return;
+            if (n <= 0)
+            {
+                fail(connection, "connection lost");
+                return;
+            }
+            connection.in.commit(static_cast<size>(n));
+
+            // | len | status | data |, decoded in place
+            while (connection.in.size() >= 4)
+            {
+                u32 len = 0;
+                std::memcpy(&len, connection.in.data(), 4);
+                if (connection.in.size() - 4 < len)
+                    break;
+                if (len < 4 || connection.inFlight.empty())
+                {
+                    fail(connection, "protocol error");
+                    return;
+                }
+
+                Response::Status status;
+                std::memcpy(&status, connection.in.data() + 4, 4);
+                Reply reply{ status, std::string_view{ reinterpret_cast<const char *>(connection.in.data()) + 8, len - 4 } };
+
+                Callback callback = std::move(connection.inFlight.front());
+                connection.inFlight.pop_front();
+                callback(reply);
+                connection.in.consume(4 + len);
+            }
+
+            if (static_cast<size>(n) < want)
+                return;
+        }
+    }
+
+    // Close the connection and fail every request sent or queued on it
+    void Client::fail(Connection &connection, std::string_view reason)
+    {
+        std::deque<Callback> failed = std::move(connection.inFlight);
+        connection.inFlight.clear();
+        {
+            std::lock_guard guard{ connection.lock };
+            connection.broken = true;
+            for (auto &callback : connection.queuedCallbacks)
+                failed.push_back(std::move(callback));
+            for (auto &callback : connection.refused)
+                failed.push_back(std::move(callback));
+            connection.queuedCallbacks.clear();
+            connection.refused.clear();
+            connection.queued.clear();
+        }
+
+        // Closing the socket removes it from the epoll set
+        connection.socket = sockets::Socket{};
+        connection.out.clear();
+        connection.in.clear();
+        connection.writable = false;
+        connection.connecting = false;
+
+        Reply reply{ Response::Status::RES_ERR, reason };
+        for (auto &callback : failed)
+            callback(reply);
+    }
+
+    // Start a new connection once the previous attempt is old enough, without blocking
+    void Client::reconnect(Connection &connection)
+    {
+        auto now = Clock::now();
+        if (connection.socket.isValid() || now < connection.retryAt)
+            return;
+
+        connection.retryAt = now + K_RECONNECT_INTERVAL;
+        connection.socket = connectTo(m_Options, connection.connecting);
+        if (!connection.socket.isValid())
+            return;
+
+        // A pending connect is watched for EPOLLOUT, which reports its outcome
+        epoll_event event{ .events = connection.connecting ? EPOLLOUT : EPOLLIN, .data = { .ptr = &connection } };
+        ::epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, connection.socket.fd(), &event);
+        connection.writable = connection.connecting;
+
+        if (!connection.connecting)
+        {
+            std::lock_guard guard{ connection.lock };
+            connection.broken = false;
+        }
+    }
+
+    // A pending connect completed: serve the connection, or retry once the interval elapsed
+    void Client::finishConnect(Connection &connection)
+    {
+        connection.connecting = false;
+        if (!connected(connection.socket))
+        {
+            connection.socket = sockets::Socket{};
+            connection.writable = false;
+            return;
+        }
+
+        watch(connection, false);
+        std::lock_guard guard{ connection.lock };
+        connection.broken = false;
+    }
+
+    void appendRequest(buffer::Buffer &out, std::span<const std::string_view> args)
+    {
+        u32 len = 4;
+        for (auto arg : args)
+            len += 4 + static_cast<u32>(arg.size());
+
+        u8 *at = out.prepare(4 + static_cast<size>(len));
+        auto put = [&at](const void *data, size n) {
+            std::memcpy(at, data, n);
+            at += n;
+        };
+
+        u32 nargs = static_cast<u32>(args.size());
+        put(&len, 4);
+        put(&nargs, 4);
+        for (auto arg : args)
+        {
+            u32 argLen = static_cast<u32>(arg.size());
+            put(&argLen, 4);
+            put(arg.data(), arg.size());
+        }
+        out.commit(4 + static_cast<size>(len));
+    }
+} // namespace my_redis::client
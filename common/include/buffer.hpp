@@ -1,6 +1,9 @@
 #pragma once
 
 #include "types.hpp"
+
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace my_redis::buffer
@@ -22,4 +25,61 @@ namespace my_redis::buffer
         buffer.erase(buffer.begin(), buffer.begin() + n);
     }
 
-} //  namespace my_redis::buffer
\ No newline at end of file
+    /*
+        * Growable byte buffer with read and write cursors, used for connection I/O.
+        * | consumed | readable (data(), size()) | writable (prepare()) |
+        *            ^ m_ReadPos                 ^ m_WritePos           ^ m_Capacity
+        * Consuming only advances the read cursor. The readable bytes are moved back
+        * to the front only when the tail runs out of space, so that parsing a deep
+        * pipeline does not memmove the remaining buffer after every request.
+        * Storage grows by powers of two from a small block, and is released once
+        * a buffer grown past the pooled chunk size is emptied.
+    */
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        ~Buffer();
+
+        Buffer(Buffer &&other) noexcept;
+        Buffer &operator=(Buffer &&other) noexcept;
+
+        Buffer(const Buffer &)              = delete;
+        Buffer &operator=(const Buffer &)   = delete;
+
+    public:
+        const types::u8 *data() const noexcept { return m_Storage + m_ReadPos; }
+        types::u8 *data() noexcept { return m_Storage + m_ReadPos; }
+        types::size size() const noexcept { return m_WritePos - m_ReadPos; }
+        bool empty() const noexcept { return m_WritePos == m_ReadPos; }
+        types::size capacity() const noexcept { return m_Capacity; }
+
+        // Returns at least `n` writable bytes at the tail, compacting or growing if needed.
+        // The bytes become readable after `commit()`.
+        types::u8 *prepare(types::size n);
+        void commit(types::size n) noexcept { m_WritePos += n; }
+
+        // Number of bytes that can be written without compacting or growing
+        types::size writable() const noexcept { return m_Capacity - m_WritePos; }
+
+        void append(const void *data, types::size n);
+        void consume(types::size n) noexcept;
+        void clear() noexcept { m_ReadPos = m_WritePos = 0; }
+
+        void swap(Buffer &other) noexcept;
+
+    private:
+        void reserve(types::size n);
+        void release() noexcept;
+
+    private:
+        types::u8 *m_Storage{ nullptr };
+        types::size m_Capacity{ 0 };
+        types::size m_ReadPos{ 0 };
+        types::size m_WritePos{ 0 };
+    };
+
+    // Bytes of storage held by live `Buffer`s, blocks pooled for reuse excluded
+    types::size allocatedBytes() noexcept;
+
+} //  namespace my_redis::buffer
@@ -17,6 +17,7 @@ namespace my_redis::payload
     */
     constexpr types::size HEADER_LEN = 4;
     // constexpr size MSG_LEN = 4096;
+    // Largest buffered message, the server streams larger requests into a blob up to the 4 GiB of the header
     constexpr types::size MAX_MSG_LEN = 32 << 20;
     constexpr types::size PAYLOAD_LEN = HEADER_LEN + MAX_MSG_LEN + 1;
 
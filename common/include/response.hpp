@@ -11,9 +11,13 @@ namespace my_redis
         {
             RES_OK = 0,
             RES_ERR,
-            RES_NX
+            RES_NX,
+            RES_ARR     // Data: | count (4 bytes) | len1 | str1 | ... | lenN | strN |
         } status = Status::RES_OK;
 
+        // Length of a missing item in RES_ARR data, not followed by any bytes
+        static constexpr types::u32 K_NIL_LEN = ~types::u32{ 0 };
+
         std::vector<types::u8> data;
 
         friend constexpr const char *statusStr(const Status &status) noexcept
@@ -23,6 +27,7 @@ namespace my_redis
                 case Status::RES_OK: return "OK";
                 case Status::RES_ERR: return "ERR";
                 case Status::RES_NX: return "NX";
+                case Status::RES_ARR: return "ARR";
                 default: return "UNKNOWN";
             }
         }
@@ -6,6 +6,7 @@
 #include <netinet/ip.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <netinet/ip.h>
 #include <unistd.h>
@@ -38,6 +39,24 @@ namespace my_redis::sockets
         }
     };
 
+    struct UnixEndpoint
+    {
+        const char *path;
+
+        sockaddr_un sockaddr() const noexcept;
+        socklen_t socklen() const noexcept { return sizeof(sockaddr_un); }
+    };
+
+    // Options of a listening socket. Linux copies them to the sockets it accepts.
+    struct ListenOptions
+    {
+        bool noDelay = true;                // TCP_NODELAY, TCP only
+        types::i32 recvBuffer = 0;          // SO_RCVBUF in bytes, kernel default when 0
+        types::i32 sendBuffer = 0;          // SO_SNDBUF in bytes, kernel default when 0
+        types::i32 deferAcceptSecs = 0;     // TCP_DEFER_ACCEPT: accept once the client sent data, TCP only
+        types::i32 busyPollUsecs = 0;       // SO_BUSY_POLL: spin on the device queue before sleeping, TCP only
+    };
+
     class Socket
     {
     public:
@@ -84,10 +103,20 @@ namespace my_redis::sockets
     {
     public:
         using Socket::operator=;
-        ServerSocket(const Endpoint &endpoint);
+        // With `reusePort`, several sockets can listen on the same endpoint and
+        // the kernel load-balances incoming connections between them (SO_REUSEPORT).
+        ServerSocket(const Endpoint &endpoint, bool reusePort = false, const ListenOptions &options = {});
+        // A stale socket file left at the path is replaced
+        ServerSocket(const UnixEndpoint &endpoint, const ListenOptions &options = {});
 
     public:
         Socket accept() const;
+
+        // Another descriptor of the same listening socket, loops sharing it accept in turns
+        ServerSocket duplicate() const;
+
+    private:
+        explicit ServerSocket(Socket &&socket) : Socket(std::move(socket)) {}
     };
 
     enum class IOResultType
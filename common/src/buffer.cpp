@@ -0,0 +1,168 @@
+#include "buffer.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+
+namespace
+{
+    using namespace my_redis::types;
+
+    // Storage blocks of the read chunk size are recycled through a small per-thread
+    // pool, so that short-lived connections do not hit the allocator.
+    constexpr size K_CHUNK_SIZE = 16 * 1024;
+    constexpr size K_MAX_POOLED_CHUNKS = 256;
+
+    // Storage starts small: a reply forwarded between shards, or held behind one,
+    // is usually a few bytes, and a deep pipeline keeps a thousand of them alive.
+    constexpr size K_MIN_CAPACITY = 256;
+
+    // Storage of the live buffers of every thread, pooled chunks are free to reuse
+    std::atomic<size> g_allocatedBytes{ 0 };
+
+    struct ChunkPool
+    {
+        std::vector<u8 *> chunks;
+
+        ~ChunkPool()
+        {
+            for (u8 *chunk : chunks)
+                delete[] chunk;
+        }
+    };
+
+    thread_local ChunkPool t_chunkPool;
+
+    u8 *allocate(size capacity)
+    {
+        g_allocatedBytes.fetch_add(capacity, std::memory_order_relaxed);
+        if (capacity == K_CHUNK_SIZE && !t_chunkPool.chunks.empty())
+        {
+            u8 *chunk = t_chunkPool.chunks.back();
+            t_chunkPool.chunks.pop_back();
+            return chunk;
+        }
+
+        // Not value-initialized on purpose, the bytes are always written before being read
+        return new u8[capacity];
+    }
+
+    void deallocate(u8 *storage, size capacity) noexcept
+    {
+        g_allocatedBytes.fetch_sub(capacity, std::memory_order_relaxed);
+        if (capacity == K_CHUNK_SIZE && t_chunkPool.chunks.size() < K_MAX_POOLED_CHUNKS)
+        {
+            t_chunkPool.chunks.push_back(storage);
+            return;
+        }
+
+        delete[] storage;
+    }
+} // namespace
+
+namespace my_redis::buffer
+{
+    Buffer::~Buffer()
+    {
+        release();
+    }
+
+    Buffer::Buffer(Buffer &&other) noexcept
+    {
+        swap(other);
+    }
+
+    Buffer &Buffer::operator=(Buffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    types::u8 *Buffer::prepare(types::size n)
+    {
+        if (writable() < n)
+            reserve(n);
+
+        return m_Storage + m_WritePos;
+    }
+
+    void Buffer::append(const void *data, types::size n)
+    {
+        std::memcpy(prepare(n), data, n);
+        commit(n);
+    }
+
+    void Buffer::consume(types::size n) noexcept
+    {
+        assert(n <= size());
+        m_ReadPos += n;
+
+        if (m_ReadPos != m_WritePos)
+            return;
+
+        // Rewinding an empty buffer is free. Storage grown past a chunk by a large
+        // request or reply goes back to the allocator, an idle connection must not
+        // keep it; the next `prepare()` starts again from a pooled chunk.
+        if (m_Capacity > K_CHUNK_SIZE)
+            release();
+        else
+            m_ReadPos = m_WritePos = 0;
+    }
+
+    void Buffer::swap(Buffer &other) noexcept
+    {
+        std::swap(m_Storage, other.m_Storage);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_ReadPos, other.m_ReadPos);
+        std::swap(m_WritePos, other.m_WritePos);
+    }
+
+    // Make room for `n` more bytes after the readable ones
+    void Buffer::reserve(types::size n)
+    {
+        types::size used = size();
+
+        // Compact when the consumed prefix alone is enough, and at least as large
+        // as the bytes that have to be moved, which keeps the copying amortized O(1).
+        if (m_ReadPos >= n && m_ReadPos >= used)
+        {
+            std::memmove(m_Storage, m_Storage + m_ReadPos, used);
+            m_ReadPos = 0;
+            m_WritePos = used;
+            return;
+        }
+
+        // Capacities are powers of two, so that a growing buffer passes by the pooled size
+        types::size capacity = std::max({ K_MIN_CAPACITY, m_Capacity * 2, std::bit_ceil(used + n) });
+        types::u8 *storage = allocate(capacity);
+        if (used > 0)
+            std::memcpy(storage, m_Storage + m_ReadPos, used);
+
+        release();
+        m_Storage = storage;
+        m_Capacity = capacity;
+        m_ReadPos = 0;
+        m_WritePos = used;
+    }
+
+    void Buffer::release() noexcept
+    {
+        if (m_Storage)
+            deallocate(m_Storage, m_Capacity);
+
+        m_Storage = nullptr;
+        m_Capacity = m_ReadPos = m_WritePos = 0;
+    }
+
+    size allocatedBytes() noexcept
+    {
+        return g_allocatedBytes.load(std::memory_order_relaxed);
+    }
+} // namespace my_redis::buffer
@@ -3,8 +3,10 @@
 #include "types.hpp"
 
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -13,10 +15,50 @@
 #include <cstdio>
 #include <cassert>
 
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+
+    void setOption(const sockets::Socket &s, i32 level, i32 name, i32 value, const char *what)
+    {
+        if (-1 == ::setsockopt(s.fd(), level, name, &value, sizeof(value)))
+        {
+            throw exception::errno_exception{ what };
+        }
+    }
+
+    // Buffer sizes have to be set before listen() for the TCP window scale to follow them
+    void applyOptions(const sockets::Socket &s, const sockets::ListenOptions &options, bool tcp)
+    {
+        if (options.recvBuffer > 0)
+            setOption(s, SOL_SOCKET, SO_RCVBUF, options.recvBuffer, "ServerSocket::ServerSocket() -> setsockopt(SO_RCVBUF)");
+        if (options.sendBuffer > 0)
+            setOption(s, SOL_SOCKET, SO_SNDBUF, options.sendBuffer, "ServerSocket::ServerSocket() -> setsockopt(SO_SNDBUF)");
+        if (!tcp)
+            return;
+
+        if (options.noDelay)
+            setOption(s, IPPROTO_TCP, TCP_NODELAY, 1, "ServerSocket::ServerSocket() -> setsockopt(TCP_NODELAY)");
+        if (options.deferAcceptSecs > 0)
+            setOption(s, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.deferAcceptSecs, "ServerSocket::ServerSocket() -> setsockopt(TCP_DEFER_ACCEPT)");
+        if (options.busyPollUsecs > 0)
+            setOption(s, SOL_SOCKET, SO_BUSY_POLL, options.busyPollUsecs, "ServerSocket::ServerSocket() -> setsockopt(SO_BUSY_POLL)");
+    }
+} // namespace
+
 namespace my_redis::sockets
 {
     using namespace my_redis::types;
 
+    sockaddr_un UnixEndpoint::sockaddr() const noexcept
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+
     void Socket::setNonBlock() const
     {
         auto flags = ::fcntl(m_Fd, F_GETFL);
@@ -33,7 +75,7 @@ namespace my_redis::sockets
         }        
     }
 
-    ServerSocket::ServerSocket(const Endpoint &endpoint)
+    ServerSocket::ServerSocket(const Endpoint &endpoint, bool reusePort, const ListenOptions &options)
     {
         Socket s{ ::socket(AF_INET, SOCK_STREAM, 0) };
         if (!s.isValid())
@@ -43,8 +85,13 @@ namespace my_redis::sockets
 
         auto _true = 1;
         setsockopt(s.fd(), SOL_SOCKET, SO_REUSEADDR, &_true, sizeof(_true));
+        if (reusePort && -1 == setsockopt(s.fd(), SOL_SOCKET, SO_REUSEPORT, &_true, sizeof(_true)))
+        {
+            throw exception::errno_exception{ "ServerSocket::ServerSocket(const Endpoint &endpoint) -> setsockopt(SO_REUSEPORT)" };
+        }
 
         s.setNonBlock();
+        applyOptions(s, options, true);
 
         auto sockaddr = endpoint.sockaddr();
         if (-1 == ::bind(s.fd(), (const struct sockaddr *)&sockaddr, sizeof(sockaddr)))
@@ -60,6 +107,50 @@ namespace my_redis::sockets
         this->operator=(std::move(s));
     }
 
+    ServerSocket::ServerSocket(const UnixEndpoint &endpoint, const ListenOptions &options)
+    {
+        if (std::strlen(endpoint.path) >= sizeof(sockaddr_un::sun_path))
+        {
+            throw exception::errno_exception{ "ServerSocket::ServerSocket(const UnixEndpoint &endpoint) -> path", ENAMETOOLONG };
+        }
+
+        Socket s{ ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) };
+        if (!s.isValid())
+        {
+            throw exception::errno_exception{ "ServerSocket::ServerSocket(const UnixEndpoint &endpoint) -> socket()" };
+        }
+
+        applyOptions(s, options, false);
+
+        // Only a socket file is removed, never a regular file given by mistake
+        struct stat st{};
+        if (0 == ::lstat(endpoint.path, &st) && S_ISSOCK(st.st_mode))
+            ::unlink(endpoint.path);
+
+        auto sockaddr = endpoint.sockaddr();
+        if (-1 == ::bind(s.fd(), (const struct sockaddr *)&sockaddr, endpoint.socklen()))
+        {
+            throw exception::errno_exception{ "ServerSocket::ServerSocket(const UnixEndpoint &endpoint) -> bind()" };
+        }
+
+        if (-1 == ::listen(s.fd(), SOMAXCONN))
+        {
+            throw exception::errno_exception{ "ServerSocket::ServerSocket(const UnixEndpoint &endpoint) -> listen()" };
+        }
+
+        this->operator=(std::move(s));
+    }
+
+    ServerSocket ServerSocket::duplicate() const
+    {
+        Socket s{ ::fcntl(fd(), F_DUPFD_CLOEXEC, 0) };
+        if (!s.isValid())
+        {
+            throw exception::errno_exception{ "ServerSocket ServerSocket::duplicate() const -> fcntl(F_DUPFD_CLOEXEC)" };
+        }
+        return ServerSocket{ std::move(s) };
+    }
+
     IOResultType read(i32 fd, u8 *buffer, size n)
     {
         while (n > 0)
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace my_redis::microbench
+{
+    // Heap allocations made by the calling thread since it started: malloc, calloc,
+    // realloc, aligned allocations, and everything built on them such as operator new
+    types::u64 allocations() noexcept;
+
+    // Hardware cache misses of the calling thread, through perf_event_open(2).
+    // Unavailable without a PMU or when perf_event_paranoid forbids it.
+    class CacheMisses
+    {
+    public:
+        CacheMisses();
+        ~CacheMisses();
+
+        CacheMisses(CacheMisses &&other) noexcept : m_Fd(std::exchange(other.m_Fd, -1)) {}
+
+        CacheMisses(const CacheMisses &)            = delete;
+        CacheMisses &operator=(const CacheMisses &) = delete;
+
+    public:
+        bool available() const noexcept { return m_Fd >= 0; }
+        void start() noexcept;
+        types::u64 stop() noexcept;
+
+    private:
+        types::i32 m_Fd{ -1 };
+    };
+
+    struct Param
+    {
+        const char *name;
+        types::u64 value;
+    };
+
+    struct Result
+    {
+        std::string name;
+        std::vector<Param> params;
+        types::u64 ops;                 // Operations measured over all rounds
+        types::u32 rounds;
+        double nsPerOp;
+        double allocsPerOp;
+        std::optional<double> cacheMissesPerOp;
+    };
+
+    class Suite
+    {
+    public:
+        // Options: --filter <substring>, --max-keys <n>, --min-time-ms <ms>
+        static std::optional<Suite> fromArgs(int argc, char *argv[]);
+
+    public:
+        bool enabled(std::string_view name) const noexcept;
+        types::u64 maxKeys() const noexcept { return m_MaxKeys; }
+
+        // Run `setup()` untimed and `body()` timed until the timed rounds add up to the
+        // minimum time. `body` performs `ops` operations, or returns how many it performed.
+        template <typename Setup, typename Body>
+        void run(std::string_view name, std::vector<Param> params, types::u64 ops, Setup &&setup, Body &&body)
+        {
+            if (!enabled(name))
+                return;
+
+            Round total{};
+            types::u64 totalOps = 0;
+            types::u32 rounds = 0;
+            do
+            {
+                setup();
+                Round round = begin();
+                if constexpr (std::is_void_v<std::invoke_result_t<Body &>>)
+                {
+                    body();
+                    end(round);
+                    totalOps += ops;
+                }
+                else
+                {
+                    types::u64 performed = body();
+                    end(round);
+                    totalOps += performed;
+                }
+
+                total.ns += round.ns;
+                total.allocations += round.allocations;
+                total.cacheMisses += round.cacheMisses;
+                rounds++;
+            } while (total.ns < m_MinTimeNs && rounds < K_MAX_ROUNDS);
+
+            record(name, std::move(params), totalOps, rounds, total);
+        }
+
+        // Write every result as a JSON document
+        void writeJson(std::FILE *out) const;
+
+    private:
+        static constexpr types::u32 K_MAX_ROUNDS = 1000;
+
+        struct Round
+        {
+            types::u64 ns;
+            types::u64 allocations;
+            types::u64 cacheMisses;
+        };
+
+        Round begin() noexcept;
+        void end(Round &round) noexcept;
+        void record(std::string_view name, std::vector<Param> params, types::u64 ops, types::u32 rounds, const Round &total);
+
+    private:
+        std::string m_Filter;
+        types::u64 m_MaxKeys = 10'000'000;
+        types::u64 m_MinTimeNs = 200'000'000;
+        CacheMisses m_CacheMisses;
+        std::vector<Result> m_Results;
+    };
+} // namespace my_redis::microbench
@@ -0,0 +1,269 @@
+#include "harness.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace my_redis::types;
+
+// Allocation counting: the malloc family is interposed and forwarded to glibc, so
+// operator new, std::calloc in the hashtable and aligned slab pages are all seen.
+extern "C"
+{
+    void *__libc_malloc(std::size_t n);
+    void *__libc_calloc(std::size_t count, std::size_t n);
+    void *__libc_realloc(void *ptr, std::size_t n);
+    void *__libc_memalign(std::size_t alignment, std::size_t n);
+    void __libc_free(void *ptr);
+}
+
+namespace
+{
+    thread_local u64 t_allocations = 0;
+} // namespace
+
+extern "C"
+{
+    void *malloc(std::size_t n)
+    {
+        t_allocations++;
+        return __libc_malloc(n);
+    }
+
+    void *calloc(std::size_t count, std::size_t n)
+    {
+        t_allocations++;
+        return __libc_calloc(count, n);
+    }
+
+    void *realloc(void *ptr, std::size_t n)
+    {
+        t_allocations++;
+        return __libc_realloc(ptr, n);
+    }
+
+    void *aligned_alloc(std::size_t alignment, std::size_t n)
+    {
+        t_allocations++;
+        return __libc_memalign(alignment, n);
+    }
+
+    void *memalign(std::size_t alignment, std::size_t n)
+    {
+        t_allocations++;
+        return __libc_memalign(alignment, n);
+    }
+
+    int posix_memalign(void **out, std::size_t alignment, std::size_t n)
+    {
+        t_allocations++;
+        void *ptr = __libc_memalign(alignment, n);
+        if (ptr == nullptr)
+            return ENOMEM;
+        *out = ptr;
+        return 0;
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+
+namespace my_redis::microbench
+{
+    using Clock = std::chrono::steady_clock;
+
+    u64 allocations() noexcept
+    {
+        return t_allocations;
+    }
+
+    CacheMisses::CacheMisses()
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        // This thread, on any CPU
+        m_Fd = static_cast<i32>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    CacheMisses::~CacheMisses()
+    {
+        if (m_Fd >= 0)
+            ::close(m_Fd);
+    }
+
+    void CacheMisses::start() noexcept
+    {
+        if (m_Fd < 0)
+            return;
+        ::ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    u64 CacheMisses::stop() noexcept
+    {
+        if (m_Fd < 0)
+            return 0;
+        ::ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        u64 count = 0;
+        if (::read(m_Fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    }
+
+    namespace
+    {
+        bool parseNumber(const char *text, u64 min, u64 &out)
+        {
+            char *end = nullptr;
+            errno = 0;
+            auto value = std::strtoull(text, &end, 10);
+            if (errno != 0 || end == text || *end != '\0' || value < min)
+                return false;
+            out = value;
+            return true;
+        }
+
+        void writeDouble(std::FILE *out, double value)
+        {
+            std::fprintf(out, "%.3f", value);
+        }
+    } // namespace
+
+    std::optional<Suite> Suite::fromArgs(int argc, char *argv[])
+    {
+        Suite suite{};
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg{ argv[i] };
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "> Missing value for option '%s'\n", argv[i]);
+                return std::nullopt;
+            }
+            const char *value = argv[++i];
+
+            bool valid = true;
+            if (arg == "--filter")
+                suite.m_Filter = value;
+            else if (arg == "--max-keys")
+                valid = parseNumber(value, 1000, suite.m_MaxKeys);
+            else if (arg == "--min-time-ms")
+            {
+                u64 ms = 0;
+                valid = parseNumber(value, 1, ms);
+                suite.m_MinTimeNs = ms * 1'000'000;
+            }
+            else
+            {
+                std::fprintf(stderr, "> Unknown option '%s'\n", argv[i - 1]);
+                return std::nullopt;
+            }
+
+            if (!valid)
+            {
+                std::fprintf(stderr, "> Invalid value '%s' for option '%s'\n", value, argv[i - 1]);
+                return std::nullopt;
+            }
+        }
+
+        return suite;
+    }
+
+    bool Suite::enabled(std::string_view name) const noexcept
+    {
+        return m_Filter.empty() || name.find(m_Filter) != std::string_view::npos;
+    }
+
+    Suite::Round Suite::begin() noexcept
+    {
+        Round round{};
+        round.allocations = allocations();
+        m_CacheMisses.start();
+        round.ns = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+        return round;
+    }
+
+    void Suite::end(Round &round) noexcept
+    {
+        auto now = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+        round.cacheMisses = m_CacheMisses.stop();
+        round.ns = now - round.ns;
+        round.allocations = allocations() - round.allocations;
+    }
+
+    void Suite::record(std::string_view name, std::vector<Param> params, u64 ops, u32 rounds, const Round &total)
+    {
+        Result result{};
+        result.name = name;
+        result.params = std::move(params);
+        result.ops = ops > 0 ? ops : 1;
+        result.rounds = rounds;
+
+        auto perOp = [&](u64 value) { return static_cast<double>(value) / static_cast<double>(result.ops); };
+        result.nsPerOp = perOp(total.ns);
+        result.allocsPerOp = perOp(total.allocations);
+        if (m_CacheMisses.available())
+            result.cacheMissesPerOp = perOp(total.cacheMisses);
+
+        // Progress on stderr, stdout carries the JSON document
+        std::fprintf(stderr, "%-28s", result.name.c_str());
+        for (const auto &param : result.params)
+            std::fprintf(stderr, " %s=%-10llu", param.name, static_cast<unsigned long long>(param.value));
+        std::fprintf(stderr, " %10.2f ns/op %8.3f allocs/op", result.nsPerOp, result.allocsPerOp);
+        if (result.cacheMissesPerOp)
+            std::fprintf(stderr, " %8.3f misses/op", *result.cacheMissesPerOp);
+        std::fprintf(stderr, "\n");
+
+        m_Results.push_back(std::move(result));
+    }
+
+    // Names and parameters are plain identifiers, no escaping needed
+    void Suite::writeJson(std::FILE *out) const
+    {
+        std::fprintf(out, "{\n");
+        std::fprintf(out, "  \"timestamp\": %lld,\n", static_cast<long long>(std::time(nullptr)));
+        std::fprintf(out, "  \"cache_misses_available\": %s,\n", m_CacheMisses.available() ? "true" : "false");
+        std::fprintf(out, "  \"results\": [");
+
+        for (size i = 0; i < m_Results.size(); ++i)
+        {
+            const Result &result = m_Results[i];
+            std::fprintf(out, "%s\n    { \"name\": \"%s\", \"params\": {", i == 0 ? "" : ",", result.name.c_str());
+            for (size j = 0; j < result.params.size(); ++j)
+            {
+                std::fprintf(out, "%s\"%s\": %llu", j == 0 ? " " : ", ", result.params[j].name,
+                    static_cast<unsigned long long>(result.params[j].value));
+            }
+            std::fprintf(out, "%s}, \"ops\": %llu, \"rounds\": %u, \"ns_per_op\": ", result.params.empty() ? "" : " ",
+                static_cast<unsigned long long>(result.ops), result.rounds);
+            writeDouble(out, result.nsPerOp);
+            std::fprintf(out, ", \"allocs_per_op\": ");
+            writeDouble(out, result.allocsPerOp);
+            std::fprintf(out, ", \"cache_misses_per_op\": ");
+            if (result.cacheMissesPerOp)
+                writeDouble(out, *result.cacheMissesPerOp);
+            else
+                std::fprintf(out, "null");
+            std::fprintf(out, " }");
+        }
+
+        std::fprintf(out, "\n  ]\n}\n");
+    }
+} // namespace my_redis::microbench
@@ -0,0 +1,162 @@
+// Compares the key hash (seeded wyhash) against the former 32 bit FNV.
+//   hash_bench [keys]
+// Throughput: hashes of keys of various lengths.
+// Collisions: full hash collisions and the longest chain in 2^20 buckets, for
+// sequential keys, and for keys crafted to collide under FNV.
+
+#include "hash.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+    using Clock = std::chrono::steady_clock;
+
+    // Keeps the hashed results observable
+    volatile u64 g_sink = 0;
+
+    struct Fnv
+    {
+        static constexpr const char *K_NAME = "fnv-32";
+        static u64 hash(const u8 *data, size len) noexcept { return hash::fnv(data, len); }
+    };
+
+    struct Wy
+    {
+        static constexpr const char *K_NAME = "wyhash-64";
+        static u64 hash(const u8 *data, size len) noexcept { return hash::strHash(data, len); }
+    };
+
+    template <typename Hash>
+    void throughput(size len)
+    {
+        std::vector<u8> data(len + 64);
+        for (size i = 0; i < data.size(); ++i)
+            data[i] = static_cast<u8>(i * 31 + 7);
+
+        // Vary the start offset so that the calls cannot be folded together
+        size rounds = std::max<size>(1'000'000, (256u << 20) / std::max<size>(len, 1) / 4);
+        u64 sink = 0;
+        auto start = Clock::now();
+        for (size i = 0; i < rounds; ++i)
+            sink += Hash::hash(data.data() + (i & 63), len);
+        auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        g_sink = sink;
+
+        std::printf("%-10s %8zu %10.2f %10.2f\n", Hash::K_NAME, len,
+                    elapsed * 1e9 / rounds, static_cast<double>(len) * rounds / elapsed / (1 << 30));
+    }
+
+    template <typename Hash>
+    void collisions(const char *label, const std::vector<std::string> &keys)
+    {
+        constexpr size K_BUCKETS = 1 << 20;
+
+        std::unordered_set<u64> seen;
+        std::vector<u32> buckets(K_BUCKETS);
+        size full = 0;
+        for (const auto &key : keys)
+        {
+            u64 h = Hash::hash(reinterpret_cast<const u8 *>(key.data()), key.size());
+            full += !seen.insert(h).second;
+            buckets[h & (K_BUCKETS - 1)]++;
+        }
+
+        std::printf("%-10s %-12s %10zu %12zu %12u\n", Hash::K_NAME, label, keys.size(), full,
+                    *std::max_element(buckets.begin(), buckets.end()));
+    }
+
+    // Two different 4 byte blocks taking FNV from `state` to the same state.
+    // The last byte only touches the low 8 bits, so a birthday search over
+    // the top 24 bits of the 3 byte prefixes finds a pair after ~2^12 tries.
+    std::pair<std::string, std::string> collidingBlocks(u32 state)
+    {
+        auto block = [state](u32 prefix, u32 &h)
+        {
+            std::string bytes;
+            h = state;
+            for (size i = 0; i < 3; ++i)
+            {
+                auto c = static_cast<u8>(prefix >> (8 * i));
+                h = (h * hash::FNV_PRIME) ^ c;
+                bytes.push_back(static_cast<char>(c));
+            }
+            h *= hash::FNV_PRIME;
+            bytes.push_back(static_cast<char>(h & 0xFF));  // Clears the low 8 bits
+            return bytes;
+        };
+
+        std::unordered_map<u32, u32> seen;
+        for (u32 prefix = 0;; ++prefix)
+        {
+            u32 h = 0;
+            block(prefix, h);
+            auto [it, inserted] = seen.emplace(h >> 8, prefix);
+            if (!inserted)
+                return { block(it->second, h), block(prefix, h) };
+        }
+    }
+
+    // `n` keys sharing one FNV hash: every key picks one block of each colliding pair
+    std::vector<std::string> fnvFlood(size n)
+    {
+        std::vector<std::pair<std::string, std::string>> pairs;
+        u32 state = hash::FNV_OFFSET_BASIS;
+        for (size keys = 1; keys < n; keys *= 2)
+        {
+            pairs.push_back(collidingBlocks(state));
+            for (char c : pairs.back().first)
+                state = (state * hash::FNV_PRIME) ^ static_cast<u8>(c);
+        }
+
+        std::vector<std::string> keys;
+        for (size i = 0; i < n; ++i)
+        {
+            std::string key;
+            for (size bit = 0; bit < pairs.size(); ++bit)
+                key += (i >> bit) & 1 ? pairs[bit].second : pairs[bit].first;
+            keys.push_back(std::move(key));
+        }
+        return keys;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    if (n == 0)
+    {
+        std::fprintf(stderr, "Usage: %s [keys]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-10s %8s %10s %10s\n", "hash", "key len", "ns/hash", "GiB/s");
+    for (size len : { 8, 16, 32, 64, 256, 1024, 4096 })
+    {
+        throughput<Fnv>(len);
+        throughput<Wy>(len);
+    }
+
+    std::vector<std::string> sequential;
+    for (size i = 0; i < n; ++i)
+        sequential.push_back("key:" + std::to_string(i));
+    std::vector<std::string> flood = fnvFlood(n);
+
+    std::printf("\n%-10s %-12s %10s %12s %12s\n", "hash", "keys", "count", "collisions", "max bucket");
+    collisions<Fnv>("sequential", sequential);
+    collisions<Wy>("sequential", sequential);
+    collisions<Fnv>("fnv-flood", flood);
+    collisions<Wy>("fnv-flood", flood);
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Compares the keyspace indexes: chained `hashmap::HashMap` against the open addressing `swisstable::SwissTable`.
+//   keyspace_bench [keys]
+
+#include "entry.hpp"
+#include "hash.hpp"
+#include "hashtable.hpp"
+#include "slab.hpp"
+#include "swisstable.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+    using Clock = std::chrono::steady_clock;
+
+    struct Chained
+    {
+        static constexpr const char *K_NAME = "chained";
+        hashmap::HashMap map;
+
+        hashtable::HashNode *lookup(u64 hash, std::string_view key) { return hashmap::lookup(&map, hash, key, entry::keyEquals); }
+        void insert(hashtable::HashNode *node) { hashmap::insert(&map, node); }
+        hashtable::HashNode *remove(u64 hash, std::string_view key) { return hashmap::remove(&map, hash, key, entry::keyEquals); }
+    };
+
+    struct Swiss
+    {
+        static constexpr const char *K_NAME = "swiss";
+        swisstable::SwissTable table;
+
+        hashtable::HashNode *lookup(u64 hash, std::string_view key) { return swisstable::lookup(&table, hash, key, entry::keyEquals); }
+        void insert(hashtable::HashNode *node) { swisstable::insert(&table, node); }
+        hashtable::HashNode *remove(u64 hash, std::string_view key) { return swisstable::remove(&table, hash, key, entry::keyEquals); }
+    };
+
+    struct Keys
+    {
+        std::vector<std::string> present;
+        std::vector<std::string> missing;
+        std::vector<u64> presentHashes;
+        std::vector<u64> missingHashes;
+        std::vector<size> order;        // Shuffled lookup order
+    };
+
+    double nsPerOp(Clock::duration elapsed, size ops)
+    {
+        return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(ops);
+    }
+
+    template <typename Index>
+    void run(const Keys &keys)
+    {
+        slab::Allocator allocator;
+        Index index;
+        size n = keys.present.size();
+
+        std::vector<entry::Entry *> entries(n);
+        for (size i = 0; i < n; ++i)
+            entries[i] = entry::create(allocator, keys.presentHashes[i], keys.present[i], "value");
+
+        // Insert, also tracking the slowest insert to expose resizing pauses
+        Clock::duration slowest{};
+        auto start = Clock::now();
+        for (size i = 0; i < n; ++i)
+        {
+            auto before = Clock::now();
+            index.insert(&entries[i]->node);
+            slowest = std::max(slowest, Clock::now() - before);
+        }
+        auto insertTime = Clock::now() - start;
+
+        size found = 0;
+        start = Clock::now();
+        for (size i : keys.order)
+            found += index.lookup(keys.presentHashes[i], keys.present[i]) != nullptr;
+        auto hitTime = Clock::now() - start;
+
+        start = Clock::now();
+        for (size i : keys.order)
+            found += index.lookup(keys.missingHashes[i], keys.missing[i]) != nullptr;
+        auto missTime = Clock::now() - start;
+
+        start = Clock::now();
+        for (size i : keys.order)
+            entry::destroy(allocator, entry::fromNode(index.remove(keys.presentHashes[i], keys.present[i])));
+        auto removeTime = Clock::now() - start;
+
+        if (found != n)
+            std::fprintf(stderr, "> %s: found %zu keys out of %zu!\n", Index::K_NAME, found, n);
+
+        std::printf("%-10s %10zu %10.1f %10.1f %10.1f %10.1f %14.1f\n",
+                    Index::K_NAME, n,
+                    nsPerOp(insertTime, n), nsPerOp(hitTime, n), nsPerOp(missTime, n), nsPerOp(removeTime, n),
+                    std::chrono::duration<double, std::micro>(slowest).count());
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    if (n == 0)
+    {
+        std::fprintf(stderr, "Usage: %s [keys]\n", argv[0]);
+        return 1;
+    }
+
+    Keys keys;
+    keys.present.reserve(n);
+    keys.missing.reserve(n);
+    for (size i = 0; i < n; ++i)
+    {
+        keys.present.push_back("key:" + std::to_string(i));
+        keys.missing.push_back("missing:" + std::to_string(i));
+        keys.presentHashes.push_back(hash::strHash(keys.present.back()));
+        keys.missingHashes.push_back(hash::strHash(keys.missing.back()));
+        keys.order.push_back(i);
+    }
+    std::shuffle(keys.order.begin(), keys.order.end(), std::mt19937_64{ 42 });
+
+    std::printf("%-10s %10s %10s %10s %10s %10s %14s\n",
+                "index", "keys", "insert ns", "hit ns", "miss ns", "remove ns", "max insert us");
+    run<Chained>(keys);
+    run<Swiss>(keys);
+    return 0;
+}
@@ -0,0 +1,342 @@
+// Hot path microbenchmarks, for tracking regressions over time.
+//   microbench [--filter <substring>] [--max-keys <n>] [--min-time-ms <ms>] > results.json
+// hashmap:  insert (incremental rehashes included), lookup hits and misses, batched
+//           lookup hits prefetched like MGET, lookups while a rehash is migrating,
+//           remove; from 1K keys up to --max-keys (default 10M, up to 100M with
+//           enough memory: about 60 bytes per key)
+// protocol: parseRequest on requests with 1 to 1024 arguments
+// buffer:   append and consume of pipelined chunks
+// hash:     strHash on keys of various lengths
+// Every result has ns/op, heap allocations/op and, where perf counters are
+// available, hardware cache misses/op. The JSON document goes to stdout, a
+// readable line per result to stderr.
+
+#include "buffer.hpp"
+#include "harness.hpp"
+#include "hash.hpp"
+#include "hashtable.hpp"
+#include "protocol.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+    using microbench::Suite;
+
+    // Keeps the measured results observable
+    volatile u64 g_sink = 0;
+
+    // Odd and prime, so `i * K_STRIDE % n` visits every index of [0, n) for the
+    // powers of ten used as sizes
+    constexpr u64 K_STRIDE = 2654435761;
+
+    // Lookups per round, independent of the map size
+    constexpr u64 K_LOOKUPS = 1'000'000;
+
+    struct Node
+    {
+        hashtable::HashNode node;
+        u64 key;
+    };
+
+    std::string_view keyOf(const u64 &key) noexcept
+    {
+        return { reinterpret_cast<const char *>(&key), sizeof(key) };
+    }
+
+    bool keyEquals(hashtable::HashNode *node, std::string_view key) noexcept
+    {
+        auto *entry = reinterpret_cast<Node *>(node);
+        return key.size() == sizeof(entry->key) && std::memcmp(&entry->key, key.data(), sizeof(entry->key)) == 0;
+    }
+
+    u64 xorshift(u64 &state) noexcept
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Uniform in [0, n) without a division
+    u64 below(u64 &state, u64 n) noexcept
+    {
+        return static_cast<u64>((static_cast<unsigned __int128>(xorshift(state)) * n) >> 64);
+    }
+
+    // Nodes with keys [0, n), hashed up front
+    std::vector<Node> makeNodes(u64 n)
+    {
+        std::vector<Node> nodes(n);
+        for (u64 i = 0; i < n; ++i)
+        {
+            nodes[i].key = i;
+            nodes[i].node.hash = hash::strHash(keyOf(nodes[i].key));
+        }
+        return nodes;
+    }
+
+    void fill(hashmap::HashMap &map, std::vector<Node> &nodes, u64 n)
+    {
+        for (u64 i = 0; i < n; ++i)
+            hashmap::insert(&map, &nodes[i].node);
+    }
+
+    // Lookups migrate the rest of a pending rehash
+    void settle(hashmap::HashMap &map)
+    {
+        u64 key = 0;
+        while (map.older.table != nullptr)
+            hashmap::lookup(&map, hash::strHash(keyOf(key)), keyOf(key), keyEquals);
+    }
+
+    // Lookups hash their key, as the server does
+    u64 lookups(hashmap::HashMap &map, u64 count, u64 offset, u64 range)
+    {
+        u64 rng = 0x9E3779B97F4A7C15;
+        u64 found = 0;
+        for (u64 i = 0; i < count; ++i)
+        {
+            u64 key = offset + below(rng, range);
+            found += hashmap::lookup(&map, hash::strHash(keyOf(key)), keyOf(key), keyEquals) != nullptr;
+        }
+        return found;
+    }
+
+    // Keys of a batch, as many as an MGET of a page render
+    constexpr u64 K_BATCH = 100;
+    // Same pipeline as `db::prefetchAhead()`
+    constexpr u64 K_PREFETCH_DISTANCE = 8;
+
+    // Hash a batch up front, then probe key i while the node of key i + D and the bucket
+    // of key i + 2D are prefetched
+    u64 batchedLookups(hashmap::HashMap &map, u64 count, u64 range)
+    {
+        u64 rng = 0x9E3779B97F4A7C15;
+        u64 found = 0;
+        u64 keys[K_BATCH];
+        u64 hashes[K_BATCH];
+        for (u64 done = 0; done < count; done += K_BATCH)
+        {
+            for (u64 i = 0; i < K_BATCH; ++i)
+            {
+                keys[i] = below(rng, range);
+                hashes[i] = hash::strHash(keyOf(keys[i]));
+            }
+
+            for (u64 i = 0; i < 2 * K_PREFETCH_DISTANCE; ++i)
+                hashmap::prefetchBucket(&map, hashes[i]);
+            for (u64 i = 0; i < K_PREFETCH_DISTANCE; ++i)
+                hashmap::prefetchNode(&map, hashes[i]);
+
+            for (u64 i = 0; i < K_BATCH; ++i)
+            {
+                if (i + 2 * K_PREFETCH_DISTANCE < K_BATCH)
+                    hashmap::prefetchBucket(&map, hashes[i + 2 * K_PREFETCH_DISTANCE]);
+                if (i + K_PREFETCH_DISTANCE < K_BATCH)
+                    hashmap::prefetchNode(&map, hashes[i + K_PREFETCH_DISTANCE]);
+                found += hashmap::lookup(&map, hashes[i], keyOf(keys[i]), keyEquals) != nullptr;
+            }
+        }
+        return found;
+    }
+
+    void benchHashmap(Suite &suite)
+    {
+        for (u64 keys = 1000; keys <= suite.maxKeys(); keys *= 10)
+        {
+            // Enough spare nodes past `keys` to reach the next rehash
+            std::vector<Node> nodes = makeNodes(keys * 2);
+            hashmap::HashMap map{};
+
+            suite.run("hashmap/insert", { { "keys", keys } }, keys,
+                [&] { hashmap::clear(&map); map = {}; },
+                [&] { fill(map, nodes, keys); });
+
+            hashmap::clear(&map);
+            map = {};
+            fill(map, nodes, keys);
+            settle(map);
+
+            suite.run("hashmap/lookup_hit", { { "keys", keys } }, K_LOOKUPS,
+                [] {},
+                [&] { g_sink = lookups(map, K_LOOKUPS, 0, keys); });
+
+            suite.run("hashmap/lookup_miss", { { "keys", keys } }, K_LOOKUPS,
+                [] {},
+                [&] { g_sink = lookups(map, K_LOOKUPS, keys * 2, keys); });
+
+            suite.run("hashmap/lookup_batch", { { "keys", keys }, { "batch", K_BATCH } }, K_LOOKUPS,
+                [] {},
+                [&] { g_sink = batchedLookups(map, K_LOOKUPS, keys); });
+
+            // Insert until the next rehash starts, then look up while it migrates: each
+            // operation moves a bounded batch of nodes into the new table
+            u64 filled = 0;
+            suite.run("hashmap/lookup_rehashing", { { "keys", keys } }, 0,
+                [&]
+                {
+                    hashmap::clear(&map);
+                    map = {};
+                    for (filled = 0; filled < keys || map.older.table == nullptr; ++filled)
+                        hashmap::insert(&map, &nodes[filled].node);
+                },
+                [&]
+                {
+                    u64 rng = 0x9E3779B97F4A7C15;
+                    u64 found = 0;
+                    u64 performed = 0;
+                    while (map.older.table != nullptr)
+                    {
+                        u64 key = below(rng, filled);
+                        found += hashmap::lookup(&map, hash::strHash(keyOf(key)), keyOf(key), keyEquals) != nullptr;
+                        performed++;
+                    }
+                    g_sink = found;
+                    return performed;
+                });
+
+            suite.run("hashmap/remove", { { "keys", keys } }, keys,
+                [&]
+                {
+                    hashmap::clear(&map);
+                    map = {};
+                    fill(map, nodes, keys);
+                    settle(map);
+                },
+                [&]
+                {
+                    for (u64 i = 0; i < keys; ++i)
+                    {
+                        u64 key = i * K_STRIDE % keys;
+                        g_sink = reinterpret_cast<std::uintptr_t>(
+                            hashmap::remove(&map, hash::strHash(keyOf(key)), keyOf(key), keyEquals));
+                    }
+                });
+
+            hashmap::clear(&map);
+        }
+    }
+
+    // A request of `count` arguments of 16 bytes each, "SET"-like
+    std::vector<u8> makeRequest(u32 count)
+    {
+        constexpr u32 K_ARG_LEN = 16;
+        std::vector<u8> request(4 + static_cast<size>(count) * (4 + K_ARG_LEN));
+        u8 *curr = request.data();
+        std::memcpy(curr, &count, 4);
+        curr += 4;
+        for (u32 i = 0; i < count; ++i)
+        {
+            std::memcpy(curr, &K_ARG_LEN, 4);
+            std::memset(curr + 4, 'a' + static_cast<int>(i % 26), K_ARG_LEN);
+            curr += 4 + K_ARG_LEN;
+        }
+        return request;
+    }
+
+    void benchProtocol(Suite &suite)
+    {
+        // 8 arguments still fit inline, 9 spill to the heap
+        for (u32 count : { 1u, 3u, 8u, 9u, 64u, 1024u })
+        {
+            std::vector<u8> request = makeRequest(count);
+            constexpr u64 K_PARSES = 100'000;
+
+            // A fresh Args per request, as a connection parsing one request at a time sees
+            suite.run("protocol/parseRequest", { { "args", count } }, K_PARSES,
+                [] {},
+                [&]
+                {
+                    for (u64 i = 0; i < K_PARSES; ++i)
+                    {
+                        protocol::Args args;
+                        g_sink = protocol::parseRequest(request.data(), request.size(), args) ? args.size() : 0;
+                    }
+                });
+        }
+    }
+
+    void benchBuffer(Suite &suite)
+    {
+        // A pipelined batch: every chunk appended, then consumed one by one
+        constexpr u64 K_BATCH = 64;
+        constexpr u64 K_BATCHES = 10'000;
+
+        for (u64 chunk : { 16u, 256u, 4096u, 65536u })
+        {
+            std::vector<u8> data(chunk, 'x');
+            buffer::Buffer buf;
+
+            suite.run("buffer/append_consume", { { "bytes", chunk } }, K_BATCH * K_BATCHES,
+                [&] { buf = buffer::Buffer{}; },
+                [&]
+                {
+                    for (u64 b = 0; b < K_BATCHES; ++b)
+                    {
+                        for (u64 i = 0; i < K_BATCH; ++i)
+                            buf.append(data.data(), chunk);
+                        for (u64 i = 0; i < K_BATCH; ++i)
+                        {
+                            g_sink = buf.data()[0];
+                            buf.consume(chunk);
+                        }
+                    }
+                });
+        }
+    }
+
+    void benchHash(Suite &suite)
+    {
+        constexpr u64 K_HASHES = 1'000'000;
+
+        for (u64 len : { 8u, 16u, 32u, 64u, 256u, 1024u })
+        {
+            std::string key(len, 'k');
+
+            suite.run("hash/strHash", { { "bytes", len } }, K_HASHES,
+                [] {},
+                [&]
+                {
+                    u64 acc = 0;
+                    for (u64 i = 0; i < K_HASHES; ++i)
+                    {
+                        key[0] = static_cast<char>(i);
+                        acc += hash::strHash(key);
+                    }
+                    g_sink = acc;
+                });
+        }
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    auto suite = Suite::fromArgs(argc, argv);
+    if (!suite)
+    {
+        std::fprintf(stderr, "Usage:\n"
+                             "  %s [options] > results.json\n"
+                             "Options:\n"
+                             "  --filter <substring>   Only run benchmarks whose name contains it\n"
+                             "  --max-keys <n>         Largest hashmap size, from 1000 (default: 10000000)\n"
+                             "  --min-time-ms <ms>     Minimum measured time per benchmark (default: 200)\n", argv[0]);
+        return 1;
+    }
+
+    benchHash(*suite);
+    benchProtocol(*suite);
+    benchBuffer(*suite);
+    benchHashmap(*suite);
+
+    suite->writeJson(stdout);
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Shows that ZRANGE/ZRANGEBYSCORE LIMIT with a large offset stays logarithmic:
+// the rank seek descends the order-statistic tree, where a plain ordered index
+// would walk `offset` nodes.
+//   zset_bench [members]
+
+#include "zset.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr i64 K_PAGE = 10;              // Members returned per query
+    constexpr size K_LINEAR_BUDGET = 1 << 26;   // Nodes walked at most per linear measurement
+
+    volatile double g_sink = 0;
+
+    // ZRANGE key offset offset+K_PAGE-1
+    double rangeByRank(zset::ZSet *zset, i64 offset, size rounds)
+    {
+        auto start = Clock::now();
+        for (size r = 0; r < rounds; ++r)
+        {
+            zset::ZNode *node = zset::byRank(zset, offset);
+            for (i64 i = 0; node && i < K_PAGE; ++i, node = zset::offset(node, 1))
+                g_sink = g_sink + node->score;
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    }
+
+    // ZRANGEBYSCORE key -inf +inf LIMIT offset K_PAGE
+    double rangeByScore(zset::ZSet *zset, i64 offset, size rounds)
+    {
+        auto start = Clock::now();
+        for (size r = 0; r < rounds; ++r)
+        {
+            zset::ZNode *node = zset::offset(zset::seekGe(zset, -1.0, {}), offset);
+            for (i64 i = 0; node && i < K_PAGE; ++i, node = zset::offset(node, 1))
+                g_sink = g_sink + node->score;
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    }
+
+    // The same query by walking from the first member, as without subtree sizes
+    double rangeLinear(zset::ZSet *zset, i64 offset, size rounds)
+    {
+        auto start = Clock::now();
+        for (size r = 0; r < rounds; ++r)
+        {
+            zset::ZNode *node = zset::seekGe(zset, -1.0, {});
+            for (i64 i = 0; node && i < offset + K_PAGE; ++i, node = zset::offset(node, 1))
+                if (i >= offset)
+                    g_sink = g_sink + node->score;
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    i64 n = argc > 1 ? std::strtoll(argv[1], nullptr, 10) : 1'000'000;
+    if (n <= K_PAGE)
+    {
+        std::fprintf(stderr, "Usage: %s [members > %lld]\n", argv[0], static_cast<long long>(K_PAGE));
+        return 1;
+    }
+
+    zset::ZSet zset;
+    for (i64 i = 0; i < n; ++i)
+        zset::insert(&zset, "member:" + std::to_string(i), static_cast<double>(i));
+
+    std::printf("%-12s %14s %14s %14s\n", "offset", "by rank ns", "by score ns", "linear ns");
+    // Powers of 10, then the last page
+    for (i64 offset = 1;; offset *= 10)
+    {
+        i64 at = std::min(offset, n - K_PAGE);
+        size rounds = 100'000;
+        double rank = rangeByRank(&zset, at, rounds);
+        double score = rangeByScore(&zset, at, rounds);
+
+        size linearRounds = std::max<size>(1, std::min<size>(1000, K_LINEAR_BUDGET / static_cast<size>(at + K_PAGE)));
+        double linear = rangeLinear(&zset, at, linearRounds);
+
+        std::printf("%-12lld %14.1f %14.1f %14.1f\n", static_cast<long long>(at), rank, score, linear);
+        if (at == n - K_PAGE)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "command.hpp"
+#include "protocol.hpp"
+#include "types.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace my_redis::shard
+{
+    struct Shard;
+}
+
+namespace my_redis::aof
+{
+    /*
+        * Append-only log of the write commands, in the request format clients send:
+        * | length u32 | nstr u32 | len1 u32 | str1 | ... |, one request after the other.
+        *
+        * Each shard collects the commands of an event loop iteration in `Shard::aofPending`,
+        * and the loop writes them with a single write(2) at the start of its next iteration.
+        * Relative TTLs are logged as the absolute time the command set, so that replaying
+        * the log later expires keys at the same time.
+        *
+        * fsync policies:
+        *   always:   the loop flushes and fdatasync(2)s the log before sending the replies
+        *             acknowledging the commands, blocking on the disk by design
+        *   everysec: a background thread fdatasync(2)s the log once a second when it changed
+        *   no:       the kernel decides when the log reaches the disk
+    */
+    enum class FsyncPolicy
+    {
+        ALWAYS,
+        EVERYSEC,
+        NO
+    };
+
+    std::optional<FsyncPolicy> parseFsyncPolicy(std::string_view name) noexcept;
+    std::string_view policyName(FsyncPolicy policy) noexcept;
+
+    // Whether a log exists at `path`
+    bool exists(const std::string &path);
+
+    // Execute every command of the log at `path` on the shards, before any event loop
+    // starts. A command cut short by a crash at the end is dropped and the file truncated
+    // after the last complete one. Returns false when the file cannot be read or is corrupted.
+    bool replay(const std::string &path);
+
+    // Start logging to `path`, before any event loop starts. A missing log is first
+    // written from the current content of the shards. Returns false on I/O errors.
+    bool start(std::string path, FsyncPolicy policy);
+
+    // Stop the fsync thread, after every event loop exited
+    void stop();
+
+    bool enabled() noexcept;
+
+    // Called after a write command changed the keyspace of `shard`
+    void feed(shard::Shard &shard, const command::Command &command, const protocol::Args &args, types::u64 keyHash);
+
+    // Called by every loop once per iteration: writes the commands of the previous
+    // iteration. The loop of shard 0 also completes a finished background rewrite.
+    void flush(shard::Shard &shard);
+
+    // Called by the loop before sending replies: under the `always` policy, the commands
+    // they acknowledge must be on disk first
+    void beforeReply(shard::Shard &shard);
+
+    enum class Result
+    {
+        OK,
+        BUSY,       // Another rewrite is running
+        DISABLED,
+        FAILED
+    };
+
+    // Fork a child writing the smallest log rebuilding the current keyspace to a
+    // temporary file. Commands executed meanwhile are kept aside, appended to it once
+    // the child is done, and the new log then replaces the current one.
+    Result rewriteInBackground(shard::Shard &caller);
+
+    struct Status
+    {
+        bool enabled;
+        FsyncPolicy policy;
+        bool rewriteInProgress;
+        bool lastWriteOk;
+        bool lastRewriteOk;
+        types::u64 size;            // Bytes in the log
+    };
+
+    Status status();
+
+} // namespace my_redis::aof
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace my_redis::avl
+{
+    // Intrusive AVL tree node, augmented with the size of its subtree so that
+    // rank and offset queries are O(log n). Ordering is left to the caller.
+    struct AvlNode
+    {
+        AvlNode *parent = nullptr;
+        AvlNode *left = nullptr;
+        AvlNode *right = nullptr;
+        types::u32 height = 1;
+        types::u32 count = 1;       // Nodes in this subtree, itself included
+    };
+
+    inline types::u32 height(const AvlNode *node) noexcept { return node ? node->height : 0; }
+    inline types::u32 count(const AvlNode *node) noexcept { return node ? node->count : 0; }
+
+    // Restore the invariants from a freshly linked or unlinked position up to
+    // the root, and return the new root.
+    AvlNode *fix(AvlNode *node) noexcept;
+
+    // Unlink a node, and return the new root
+    AvlNode *remove(AvlNode *node) noexcept;
+
+    // Node `offset` positions after (or before, if negative) `node`, nullptr past either end
+    AvlNode *offset(AvlNode *node, types::i64 offset) noexcept;
+
+    // Zero-based position of the node in the in-order traversal
+    types::i64 rank(const AvlNode *node) noexcept;
+
+} // namespace my_redis::avl
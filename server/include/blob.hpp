@@ -0,0 +1,95 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <string_view>
+#include <utility>
+
+namespace my_redis::blob
+{
+    // String values from this size on are stored as blobs
+    constexpr types::size K_MIN_SIZE = 16 * 1024;
+
+    /*
+        * Immutable bytes with an atomic reference count, shared between the keyspace and
+        * the connections sending them: GET queues a reference to a large value instead of
+        * copying it into the output buffer. Overwriting the key creates a new blob, and
+        * the old one is freed by whichever thread drops its last reference.
+        *
+        * | refs u32 | length u32 | bytes .. |
+    */
+    struct Blob
+    {
+        std::atomic<types::u32> refs;
+        types::u32 length;
+
+        const char *data() const noexcept { return reinterpret_cast<const char *>(this + 1); }
+        char *data() noexcept { return reinterpret_cast<char *>(this + 1); }
+        std::string_view view() const noexcept { return { data(), length }; }
+    };
+
+    // A blob holding a copy of `bytes`, with one reference
+    Blob *create(std::string_view bytes);
+
+    // A blob of `length` bytes with one reference, filled in by the caller before sharing it
+    Blob *allocate(types::u32 length);
+
+    // Resize a blob the caller holds the only reference to, keeping its first bytes. The
+    // blob may move. Throws `std::bad_alloc`, leaving the blob untouched.
+    Blob *resize(Blob *blob, types::u32 length);
+
+    inline void retain(Blob *blob) noexcept
+    {
+        blob->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release(Blob *blob) noexcept;
+
+    // Bytes of every live blob, for memory accounting
+    types::size allocatedBytes() noexcept;
+
+    // An owned reference
+    class Ref
+    {
+    public:
+        struct Adopt {};
+
+        Ref() = default;
+        // Takes a new reference
+        explicit Ref(Blob *blob) noexcept : m_Blob(blob) { retain(blob); }
+        // Takes over a reference the caller owns
+        Ref(Blob *blob, Adopt) noexcept : m_Blob(blob) {}
+        ~Ref() { reset(); }
+
+        Ref(Ref &&other) noexcept : m_Blob(std::exchange(other.m_Blob, nullptr)) {}
+        Ref &operator=(Ref &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                m_Blob = std::exchange(other.m_Blob, nullptr);
+            }
+            return *this;
+        }
+
+        Ref(const Ref &)            = delete;
+        Ref &operator=(const Ref &) = delete;
+
+    public:
+        Blob *get() const noexcept { return m_Blob; }
+        // Give up the reference without releasing it
+        Blob *detach() noexcept { return std::exchange(m_Blob, nullptr); }
+        const Blob *operator->() const noexcept { return m_Blob; }
+
+        void reset() noexcept
+        {
+            if (m_Blob)
+                release(std::exchange(m_Blob, nullptr));
+        }
+
+    private:
+        Blob *m_Blob{ nullptr };
+    };
+
+} // namespace my_redis::blob
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "output.hpp"
+#include "protocol.hpp"
+#include "stats.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <span>
+#include <string_view>
+
+namespace my_redis::shard
+{
+    struct Shard;
+}
+
+namespace my_redis::command
+{
+    enum Flags : types::u32
+    {
+        CMD_READONLY    = 1 << 0,   // Never modifies the keyspace
+        CMD_WRITE       = 1 << 1,   // May modify the keyspace
+        CMD_FAST        = 1 << 2,   // Constant or logarithmic time
+        CMD_DENYOOM     = 1 << 3,   // May grow memory, refused over the memory limit
+        CMD_CURSOR      = 1 << 4,   // Keyless, but runs on the shard encoded in its cursor, args[1]
+    };
+
+    // Everything a handler needs to execute a command
+    struct Context
+    {
+        shard::Shard &shard;
+        const protocol::Args &args;
+        types::u64 keyHash;         // Hash of args[firstKey], 0 for commands without key
+        output::Queue &out;         // The response is appended here
+        std::span<const types::u64> keyHashes{};    // Multi-key commands: the hash of every key, in order
+        blob::Blob *argBlob = nullptr;              // A large argument received straight into a blob views it
+    };
+
+    using Handler = void (*)(Context &ctx);
+
+    struct Command
+    {
+        std::string_view name;      // Lower case
+        types::i32 arity;           // Number of arguments including the name, -N means at least N
+        types::u32 flags;
+        types::i32 firstKey;        // Index of the key used to route the command, 0 if none
+        types::i32 keyStep;         // Multi-key commands: a key every `keyStep` arguments from `firstKey` on, 0 otherwise
+        Handler handler;
+    };
+
+    constexpr types::size K_MAX_COMMANDS = 64;
+
+    // Per-shard counters, only written by the thread owning the shard.
+    // The count of a latency histogram is the number of calls.
+    struct Stats
+    {
+        std::array<stats::Histogram, K_MAX_COMMANDS> latency;     // Nanoseconds spent in the handler
+    };
+
+    // Case-insensitive lookup in O(1). Returns nullptr for unknown commands.
+    const Command *lookup(std::string_view name) noexcept;
+
+    // Also checks that the arguments of a multi-key command come in whole groups
+    bool checkArity(const Command &command, types::size argc) noexcept;
+
+    // Number of keys of a multi-key command
+    inline types::size keyCount(const Command &command, types::size argc) noexcept
+    {
+        return (argc - static_cast<types::size>(command.firstKey)) / static_cast<types::size>(command.keyStep);
+    }
+
+    // Case-insensitive match of an argument against a lower case option name
+    bool argEquals(std::string_view arg, std::string_view option) noexcept;
+
+    // Position of the command in the registry, used to address per-command counters
+    types::size indexOf(const Command &command) noexcept;
+
+    // Every registered command
+    std::span<const Command> all() noexcept;
+
+    // Run the handler, recording the call and its latency
+    void execute(const Command &command, Context &ctx);
+
+} // namespace my_redis::command
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "command.hpp"
+
+// Handlers of the commands registered in command.cpp, grouped by source file
+namespace my_redis::command
+{
+    // commands/string_commands.cpp
+    void cmdGet(Context &ctx);
+    void cmdSet(Context &ctx);
+    void cmdDel(Context &ctx);
+    void cmdUnlink(Context &ctx);
+    void cmdMGet(Context &ctx);
+    void cmdMSet(Context &ctx);
+
+    // commands/keyspace_commands.cpp
+    void cmdScan(Context &ctx);
+
+    // commands/expire_commands.cpp
+    void cmdExpire(Context &ctx);
+    void cmdPexpire(Context &ctx);
+    void cmdPexpireAt(Context &ctx);
+    void cmdTtl(Context &ctx);
+    void cmdPttl(Context &ctx);
+    void cmdPersist(Context &ctx);
+
+    // commands/zset_commands.cpp
+    void cmdZAdd(Context &ctx);
+    void cmdZRem(Context &ctx);
+    void cmdZScore(Context &ctx);
+    void cmdZRank(Context &ctx);
+    void cmdZRange(Context &ctx);
+    void cmdZRangeByScore(Context &ctx);
+    void cmdZCount(Context &ctx);
+
+    // commands/server_commands.cpp
+    void cmdInfo(Context &ctx);
+    void cmdSave(Context &ctx);
+    void cmdBgSave(Context &ctx);
+    void cmdBgRewriteAof(Context &ctx);
+
+} // namespace my_redis::command
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "aof.hpp"
+#include "event/event_loop.hpp"
+#include "event/event_poller.hpp"
+#include "evict.hpp"
+#include "log.hpp"
+#include "request.hpp"
+#include "socket.hpp"
+
+#include <optional>
+#include <string>
+
+namespace my_redis::config
+{
+    // Server settings, filled from the command line
+    struct Config
+    {
+        sockets::Endpoint endpoint{ "127.0.0.1", 9999 };   // TCP listener, none when the port is 0
+        std::string unixSocket;                             // Unix domain socket listener, none when empty
+        sockets::ListenOptions listenOptions;               // Of every listener, the TCP ones of the TCP listener only
+        event::EventLoop::Engine engine = event::EventLoop::Engine::POLLER;
+        event::EventPoller::Backend poller = event::EventPoller::Backend::EPOLL;
+        types::u32 threads = 1;     // Event loop threads, each owning one shard of the keyspace
+        log::Level logLevel = log::Level::INFO;
+        std::string snapshotPath = "dump.snap";     // Written by SAVE/BGSAVE, loaded at startup
+        std::string aofPath;                        // Append-only log, disabled when empty
+        aof::FsyncPolicy aofFsync = aof::FsyncPolicy::EVERYSEC;
+        types::size bufferLimit = K_DEFAULT_BUFFER_LIMIT;   // Per connection, see request.hpp
+        types::size maxValueSize = K_DEFAULT_MAX_VALUE_SIZE;    // Of a streamed argument, see request.hpp
+        types::size maxMemory = 0;                  // Keys are evicted above it, no limit when 0
+        evict::Policy maxMemoryPolicy = evict::Policy::NOEVICTION;
+        bool lazyFree = true;                       // Free costly values of DEL, overwrites, expiry and eviction in the background
+    };
+
+    // Parse command line arguments. Returns std::nullopt on invalid arguments.
+    std::optional<Config> parseArgs(int argc, char *argv[]);
+
+    // Print command line usage to stderr
+    void printUsage(const char *program);
+
+} // namespace my_redis::config
@@ -1,10 +1,49 @@
 #pragma once
 
+#include "blob.hpp"
 #include "buffer.hpp"
+#include "output.hpp"
 #include "socket.hpp"
+#include "types.hpp"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace my_redis
 {
+    // A multi-key request whose keys are owned by several shards. Each shard executes its
+    // part and the replies are merged in key order once the last one came back.
+    struct Batch
+    {
+        std::vector<types::u32> owners;         // Shard owning each key, in argument order
+        std::vector<output::Queue> replies;     // Indexed by shard, empty for shards without keys
+        types::u32 pending{ 0 };                // Parts not replied yet
+    };
+
+    // The reply of a request held back until the replies of the requests before it are
+    // sent. Once a request was forwarded, the replies of the next ones queue up behind it.
+    struct ReplySlot
+    {
+        output::Queue reply;
+        std::unique_ptr<Batch> batch;           // The forwarded request is split, see `Batch`
+        bool forwarded{ false };                // Waiting for the reply of another shard
+    };
+
+    // A request whose large argument is received straight into the blob it ends up in,
+    // instead of buffering the whole request first. The arguments before it are copied
+    // out of the incoming buffer, the ones after it are parsed once they all arrived.
+    struct StreamedRequest
+    {
+        std::vector<std::string> head;          // Arguments before the blob
+        blob::Ref blob;                         // Grows up to `length` as the bytes arrive
+        types::u32 length{ 0 };                 // Of the argument
+        types::u32 filled{ 0 };                 // Bytes of the blob received so far
+        types::u32 tailArgs{ 0 };               // Arguments after the blob
+        types::u32 tailLen{ 0 };                // Bytes of the request after the blob
+    };
+
     struct Connection
     {
         explicit Connection(sockets::Socket socket) noexcept : socket(std::move(socket)) {}
@@ -20,10 +59,16 @@ namespace my_redis
         bool isValid() const noexcept { return socket.isValid(); }
 
         sockets::Socket socket;
-        buffer::buffer_t incomingBuffer;
-        buffer::buffer_t outgoingBuffer;
+        types::u64 id{ 0 };                 // Unique per event loop, fds get reused
+        buffer::Buffer incomingBuffer;
+        output::Queue outgoingBuffer;
         bool wantRead{ false };
         bool wantWrite{ false };
         bool wantClose{ false };
+        bool readPending{ false };          // Edge-triggered: input left in the socket while reading was paused
+        std::deque<ReplySlot> replySlots;   // Replies behind a forwarded request, in request order
+        types::u64 firstSlot{ 0 };          // Sequence number of `replySlots.front()`
+        types::size heldBytes{ 0 };         // Bytes of the replies held in `replySlots`
+        std::unique_ptr<StreamedRequest> streaming;     // The request being received, if streamed
     };
 } // namespace my_redis::event
\ No newline at end of file
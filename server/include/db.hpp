@@ -0,0 +1,88 @@
+#pragma once
+
+#include "entry.hpp"
+#include "types.hpp"
+
+#include <chrono>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace my_redis::shard
+{
+    struct Shard;
+}
+
+namespace my_redis::db
+{
+    // Operations on the keyspace of a shard that keep its index, allocator
+    // and expiry heap consistent. Keys past their TTL are never returned:
+    // they are deleted lazily when accessed, and actively by `activeExpire()`.
+
+    // Unix time in milliseconds, the clock of `Expiry::expireAt`
+    types::u64 nowMs() noexcept;
+
+    // Returns nullptr when the key is missing or expired
+    entry::Entry *lookup(shard::Shard &shard, types::u64 hash, std::string_view key);
+
+    // Multi-key commands probe key i while the node of key i + K_PREFETCH_DISTANCE and the
+    // bucket of key i + 2 * K_PREFETCH_DISTANCE are on their way, overlapping the cache
+    // misses of the batch. Call before probing `hashes[i]`, for every i in order.
+    constexpr types::size K_PREFETCH_DISTANCE = 8;
+    void prefetchAhead(const shard::Shard &shard, std::span<const types::u64> hashes, types::size i) noexcept;
+
+    // Reply sent when a command meets a key of another type
+    constexpr std::string_view K_WRONGTYPE = "WRONGTYPE Operation against a key holding the wrong kind of value";
+
+    // Create or overwrite a key. `expireAt` of 0 means no TTL, any previous TTL is dropped.
+    // A value received into a blob passes it as `shared`, to be stored without a copy.
+    void set(shard::Shard &shard, types::u64 hash, std::string_view key, std::string_view value, types::u64 expireAt = 0,
+             blob::Blob *shared = nullptr);
+
+    // Add a key owning an object of a non-string type. The key must not exist yet.
+    entry::Entry *insertObject(shard::Shard &shard, types::u64 hash, std::string_view key, entry::Type type, void *object);
+
+    // Add a key read back from a snapshot, without looking it up first: the key must not
+    // exist yet. Non-string types pass the pointer to their object as `value`.
+    entry::Entry *restore(shard::Shard &shard, types::u64 hash, std::string_view key, entry::Type type,
+                          std::string_view value, types::u64 expireAt);
+
+    // Returns whether the key existed. Costly values are freed in the background when
+    // the lazy free policy is enabled, see lazyfree.hpp.
+    bool erase(shard::Shard &shard, types::u64 hash, std::string_view key);
+    void erase(shard::Shard &shard, entry::Entry *entry) noexcept;
+    // Erase with costly values always freed in the background
+    bool unlink(shard::Shard &shard, types::u64 hash, std::string_view key);
+
+    // Set the TTL of a key returned by `lookup()`. A time in the past deletes it.
+    void expireAt(shard::Shard &shard, entry::Entry *entry, types::u64 expireAt);
+    // Returns whether the key had a TTL
+    bool persist(shard::Shard &shard, entry::Entry *entry);
+
+    // SCAN cursors: | shard (8 bits) | cursor of its index (56 bits) |, see `keyspace::scan()`.
+    // A scan walks the shards in order and starts and ends with cursor 0.
+    constexpr types::u32 K_CURSOR_SHARD_SHIFT = 56;
+    std::optional<types::u64> parseCursor(std::string_view arg) noexcept;
+
+    constexpr types::u32 cursorShard(types::u64 cursor) noexcept
+    {
+        return static_cast<types::u32>(cursor >> K_CURSOR_SHARD_SHIFT);
+    }
+
+    // Append to `out` the live entries of the buckets from `cursor`, a cursor of `shard`, on.
+    // Stops after `count` entries or `10 * count` buckets, so that a sparse table bounds the
+    // work too. Returns the cursor to continue from.
+    types::u64 scan(shard::Shard &shard, types::u64 cursor, types::size count, std::vector<entry::Entry *> &out);
+
+    // Delete expired keys, in expiration order, until none is left or `budget` ran out.
+    // Called once per event loop iteration, so the budget bounds the added latency.
+    // Returns the number of deleted keys.
+    constexpr std::chrono::microseconds K_ACTIVE_EXPIRE_BUDGET{ 1000 };
+    types::size activeExpire(shard::Shard &shard, std::chrono::microseconds budget = K_ACTIVE_EXPIRE_BUDGET);
+
+    // Poll timeout until the next key expires: -1 without TTLs, at most `K_MAX_EXPIRE_WAIT_MS`
+    constexpr types::i32 K_MAX_EXPIRE_WAIT_MS = 100;
+    types::i32 expireTimeout(const shard::Shard &shard) noexcept;
+
+} // namespace my_redis::db
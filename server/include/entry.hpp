@@ -0,0 +1,118 @@
+#pragma once
+
+#include "blob.hpp"
+#include "hashtable.hpp"
+#include "slab.hpp"
+#include "types.hpp"
+
+#include <cstring>
+#include <string_view>
+
+namespace my_redis::entry
+{
+    enum class Type : types::u8
+    {
+        STRING,
+        ZSET        // The value holds a `zset::ZSet *`
+    };
+
+    enum Flags : types::u8
+    {
+        ENTRY_EXPIRES = 1 << 0,     // An `Expiry` follows the header
+        ENTRY_BLOB    = 1 << 1,     // The value bytes hold a `blob::Blob *`, see blob.hpp
+    };
+
+    // Only entries with a TTL pay for it
+    struct Expiry
+    {
+        types::u64 expireAt;        // Unix time in milliseconds
+        types::size heapIndex;      // Position in the shard's `expiry::Heap`
+    };
+
+    /*
+        * A key and its value in a single variable-sized allocation:
+        *
+        * | node | keyLen | valueLen | valueCap | type | flags | access | [Expiry] | key bytes | value bytes .. |
+        * |<-------------------- 32 bytes -------------------------->|<- 16 ->-|<-keyLen->-|<-valueCap----->|
+        *
+        * `valueCap` covers the slack left by the allocator's size class, so small
+        * updates rewrite the value in place. String values of at least `blob::K_MIN_SIZE`
+        * bytes live in a shared blob instead, which `value()` returns: the inline bytes
+        * never reach 64 KiB, and their lengths take 16 bits each.
+    */
+    struct Entry
+    {
+        hashtable::HashNode node;
+        types::u32 keyLen = 0;
+        types::u16 valueLen = 0;
+        types::u16 valueCap = 0;
+        Type type = Type::STRING;
+        types::u8 flags = 0;
+        types::u32 access = 0;          // LRU clock or LFU counter of the eviction policy, see evict.hpp
+
+        Expiry *expiry() noexcept { return flags & ENTRY_EXPIRES ? reinterpret_cast<Expiry *>(this + 1) : nullptr; }
+        const Expiry *expiry() const noexcept { return const_cast<Entry *>(this)->expiry(); }
+
+        char *keyData() noexcept { return reinterpret_cast<char *>(this + 1) + extraSize(flags); }
+        const char *keyData() const noexcept { return const_cast<Entry *>(this)->keyData(); }
+        char *valueData() noexcept { return keyData() + keyLen; }
+        const char *valueData() const noexcept { return keyData() + keyLen; }
+
+        std::string_view key() const noexcept { return { keyData(), keyLen }; }
+        std::string_view value() const noexcept
+        {
+            return flags & ENTRY_BLOB ? object<blob::Blob>()->view() : std::string_view{ valueData(), valueLen };
+        }
+
+        blob::Blob *blob() const noexcept { return flags & ENTRY_BLOB ? object<blob::Blob>() : nullptr; }
+
+        // Types other than STRING own an object, the value bytes hold the pointer
+        template <typename T>
+        T *object() const noexcept
+        {
+            T *object = nullptr;
+            std::memcpy(&object, valueData(), sizeof(object));
+            return object;
+        }
+
+        // Bytes taken from the allocator
+        types::size allocSize() const noexcept { return sizeof(Entry) + extraSize(flags) + keyLen + valueCap; }
+
+        // Optional sections between the header and the key
+        static constexpr types::size extraSize(types::u8 flags) noexcept
+        {
+            return flags & ENTRY_EXPIRES ? sizeof(Expiry) : 0;
+        }
+    };
+
+    static_assert(sizeof(Entry) == 32);
+    static_assert(blob::K_MIN_SIZE <= 0xFFFF && slab::Allocator::K_MAX_SMALL <= 0xFFFF, "Inline values are sized in 16 bits");
+
+    inline Entry *fromNode(hashtable::HashNode *node) noexcept
+    {
+        return reinterpret_cast<Entry *>(reinterpret_cast<char *>(node) - offsetof(Entry, node));
+    }
+
+    // `hashtable::KeyCompareFn` for entries
+    bool keyEquals(hashtable::HashNode *node, std::string_view key) noexcept;
+
+    // `ENTRY_BLOB` is set from the size of the value, whatever `flags` say.
+    // A large value viewing `shared` references that blob instead of copying it.
+    Entry *create(slab::Allocator &allocator, types::u64 hash, std::string_view key, std::string_view value, types::u8 flags = 0,
+                  blob::Blob *shared = nullptr);
+    // Releases the blob of the value, if any
+    void destroy(slab::Allocator &allocator, Entry *entry) noexcept;
+
+    // Replace the value and flags, in place when the value fits and the flags do not
+    // change the layout. Otherwise a new entry is returned, which the caller links in
+    // place of the old one before destroying it. Optional sections present in both are copied.
+    // `shared` is the blob `value` views, if any, as for `create()`.
+    Entry *setValue(slab::Allocator &allocator, Entry *entry, std::string_view value, types::u8 flags,
+                    blob::Blob *shared = nullptr);
+
+    inline Entry *setValue(slab::Allocator &allocator, Entry *entry, std::string_view value)
+    {
+        return setValue(allocator, entry, value, entry->flags);
+    }
+
+} // namespace my_redis::entry
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "event/event_poller.hpp"
+
+#include <sys/epoll.h>
+
+namespace my_redis::event
+{
+    // epoll(7) backend with a persistent interest set.
+    // File descriptors are registered once in `addConnection()`, and the interest
+    // mask is only modified when `wantRead`/`wantWrite` of a connection changes.
+    class EpollPoller final : public EventPoller
+    {
+    public:
+        explicit EpollPoller(bool edgeTriggered);
+        ~EpollPoller() override;
+
+        EpollPoller(const EpollPoller &)            = delete;
+        EpollPoller &operator=(const EpollPoller &) = delete;
+
+    public:
+        bool poll(types::i32 timeoutMs) override;
+        void updateInterest(const Connection &connection) override;
+        bool edgeTriggered() const noexcept override { return m_EdgeTriggered; }
+
+    protected:
+        void watch(const ConnectionInfo &connectionInfo) override;
+        void unwatch(types::i32 fd) override;
+
+    private:
+        types::u32 interestOf(const Connection &connection) const noexcept;
+
+    private:
+        static constexpr types::size K_MAX_EVENTS = 1024;
+
+        types::i32 m_EpollFd{ -1 };
+        bool m_EdgeTriggered{ false };
+        std::vector<epoll_event> m_Events;
+        std::vector<types::u32> m_Interest; // registered mask, indexed by fd
+    };
+} // namespace my_redis::event
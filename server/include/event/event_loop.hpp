@@ -2,9 +2,14 @@
 
 #include "connection.hpp"
 #include "event/event_poller.hpp"
+#include "event/uring_engine.hpp"
+#include "shard.hpp"
 
 #include "socket.hpp"
-#include <sys/poll.h>
+
+#include <optional>
+#include <string_view>
+#include <vector>
 
 namespace my_redis
 {
@@ -15,25 +20,35 @@ namespace my_redis
         class EventLoop
         {
         public:
-            explicit EventLoop(sockets::ServerSocket &&listener)
+            enum class Engine
             {
-                m_EventPoller.addConnection({
-                    .type       = EventPoller::ConnectionInfo::Type::LISTENING,
-                    .connection = std::make_unique<Connection>(std::move(listener)),
-                });
-            }
+                POLLER,     // Readiness based, read/write syscalls per event
+                IO_URING    // Completion based, batched submissions
+            };
+
+            static std::optional<Engine> parseEngine(std::string_view name) noexcept;
+
+            // Serves the clients of `listeners` and owns `shard`.
+            // Falls back to the poller engine when io_uring is not supported.
+            EventLoop(std::vector<sockets::ServerSocket> &&listeners, Engine engine, EventPoller::Backend backend, shard::Shard &shard);
 
             void run();
 
         private:
-            void dispatch(const pollfd &pfd);
+            void dispatch(const Event &event);
             bool handleAccept(const Connection &connection);
             bool handleRead(Connection &connection);
             bool handleWrite(Connection &connection);
+            bool processIncoming(Connection &connection);
+            void resumeRead(Connection &connection);
+            void drainMailbox();
 
         private:
-            EventPoller m_EventPoller;
+            shard::Shard &m_Shard;
+            types::u64 m_NextConnectionId{ 1 };
+            std::unique_ptr<EventPoller> m_EventPoller;
+            std::unique_ptr<UringEngine> m_UringEngine;
         };
 
     } // namespace event
-} // namespace my_redis
\ No newline at end of file
+} // namespace my_redis
@@ -1,11 +1,30 @@
 #pragma once
 
 #include "connection.hpp"
+#include "types.hpp"
+
 #include <memory>
-#include <ranges>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
 
 namespace my_redis::event
 {
+    // Readiness flags reported for a file descriptor
+    enum EventFlags : types::u32
+    {
+        EVENT_READ  = 1 << 0,
+        EVENT_WRITE = 1 << 1,
+        EVENT_ERROR = 1 << 2,
+    };
+
+    struct Event
+    {
+        types::i32 fd;
+        types::u32 flags;
+    };
+
     class EventPoller
     {
     public:
@@ -14,32 +33,53 @@ namespace my_redis::event
             enum class Type
             {
                 LISTENING,
-                CLIENT
+                CLIENT,
+                MAILBOX     // Wake-up eventfd of the shard's mailbox
             } type;
             std::unique_ptr<Connection> connection;
         };
 
+        enum class Backend
+        {
+            POLL,       // poll(2), rebuilds the interest set on every call
+            EPOLL,      // epoll(7), level-triggered
+            EPOLL_ET    // epoll(7), edge-triggered
+        };
+
+        static std::unique_ptr<EventPoller> create(Backend backend);
+        static std::optional<Backend> parseBackend(std::string_view name) noexcept;
+
+        virtual ~EventPoller() = default;
+
     public:
-        bool poll();
+        // Wait up to `timeoutMs` (-1: forever) for events. On success, `ready()`
+        // holds the events to dispatch, none when the timeout expired.
+        virtual bool poll(types::i32 timeoutMs) = 0;
+
+        // Called after a connection has been handled so that the backend can
+        // sync its interest set with `wantRead`/`wantWrite`.
+        virtual void updateInterest(const Connection &connection) { (void)connection; }
+
+        // Edge-triggered backends only report transitions, so handlers must
+        // drain the socket (read/accept until EAGAIN) before returning.
+        virtual bool edgeTriggered() const noexcept { return false; }
+
         void addConnection(ConnectionInfo &&connectionInfo);
+        void closeConnection(types::i32 fd);
 
     public:
-        // Returns a view of the connections that are ready for reading or writing.
-        constexpr auto ready() const noexcept
-        {
-            return m_Pfds 
-                | std::views::filter([](const pollfd &pfd) { return pfd.revents; });
-        }
+        // Returns the events that are ready for dispatching.
+        std::span<const Event> ready() const noexcept { return m_Ready; }
 
         constexpr auto &connections() noexcept { return m_Connections; }
 
-        void closeConnection(types::i32 fd)
-        {
-            m_Connections.at(fd).connection.reset(nullptr);
-        }
+    protected:
+        // Register/unregister the fd with the backend
+        virtual void watch(const ConnectionInfo &connectionInfo) { (void)connectionInfo; }
+        virtual void unwatch(types::i32 fd) { (void)fd; }
 
-    private:
-        std::vector<pollfd> m_Pfds;
+    protected:
+        std::vector<Event> m_Ready;
         std::vector<ConnectionInfo> m_Connections;
     };
-} // namespace my_redis::event
\ No newline at end of file
+} // namespace my_redis::event
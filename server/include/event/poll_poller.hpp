@@ -0,0 +1,18 @@
+#pragma once
+
+#include "event/event_poller.hpp"
+
+#include <sys/poll.h>
+
+namespace my_redis::event
+{
+    // Portable fallback backend built on poll(2).
+    class PollPoller final : public EventPoller
+    {
+    public:
+        bool poll(types::i32 timeoutMs) override;
+
+    private:
+        std::vector<pollfd> m_Pfds;
+    };
+} // namespace my_redis::event
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <vector>
+
+namespace my_redis::event::uring
+{
+    // Minimal wrapper around the raw io_uring syscalls and ring mappings.
+    // Throws `exception::errno_exception` when the kernel does not support io_uring.
+    class Ring
+    {
+    public:
+        explicit Ring(types::u32 entries);
+        ~Ring();
+
+        Ring(const Ring &)              = delete;
+        Ring &operator=(const Ring &)   = delete;
+
+    public:
+        // Returns a zeroed SQE, or nullptr when the submission queue is full.
+        io_uring_sqe *getSqe() noexcept;
+
+        // Submit all queued SQEs and wait for at least `waitNr` completions.
+        // Returns the number of submitted SQEs, or -errno.
+        types::i32 submitAndWait(types::u32 waitNr) noexcept;
+
+        // Call `fn(const io_uring_cqe &)` for every available CQE and mark them as seen.
+        template <typename Fn>
+        types::u32 forEachCqe(Fn &&fn)
+        {
+            types::u32 head = *m_CqHead;
+            types::u32 tail = std::atomic_ref{ *m_CqTail }.load(std::memory_order_acquire);
+            types::u32 n = 0;
+            for (; head != tail; ++head, ++n)
+            {
+                fn(m_Cqes[head & *m_CqMask]);
+                // Release the slot as soon as it is handled, the callback may submit more work
+                std::atomic_ref{ *m_CqHead }.store(head + 1, std::memory_order_release);
+            }
+            return n;
+        }
+
+        constexpr types::i32 fd() const noexcept { return m_Fd; }
+        constexpr types::u32 features() const noexcept { return m_Features; }
+
+    private:
+        types::i32 m_Fd{ -1 };
+        types::u32 m_Features{ 0 };
+
+        void *m_SqMap{ nullptr };
+        types::size m_SqMapLen{ 0 };
+        void *m_CqMap{ nullptr };
+        types::size m_CqMapLen{ 0 };
+        io_uring_sqe *m_Sqes{ nullptr };
+        types::size m_SqesLen{ 0 };
+
+        // Submission queue
+        types::u32 *m_SqHead{ nullptr };
+        types::u32 *m_SqTail{ nullptr };
+        types::u32 *m_SqMask{ nullptr };
+        types::u32 *m_SqArray{ nullptr };
+        types::u32 m_SqLocalTail{ 0 };
+        types::u32 m_SqEntries{ 0 };
+
+        // Completion queue
+        types::u32 *m_CqHead{ nullptr };
+        types::u32 *m_CqTail{ nullptr };
+        types::u32 *m_CqMask{ nullptr };
+        io_uring_cqe *m_Cqes{ nullptr };
+    };
+
+    // Kernel-managed pool of fixed size receive buffers (IORING_REGISTER_PBUF_RING).
+    // Recv SQEs flagged with IOSQE_BUFFER_SELECT pick a buffer from the group,
+    // and the buffer is handed back with `recycle()` once its data is consumed.
+    class BufferRing
+    {
+    public:
+        BufferRing(Ring &ring, types::u16 groupId, types::u16 count, types::u32 bufferSize);
+        ~BufferRing();
+
+        BufferRing(const BufferRing &)              = delete;
+        BufferRing &operator=(const BufferRing &)   = delete;
+
+    public:
+        const types::u8 *buffer(types::u16 bufferId) const noexcept
+        {
+            return m_Storage.data() + static_cast<types::size>(bufferId) * m_BufferSize;
+        }
+
+        // Return a buffer to the kernel
+        void recycle(types::u16 bufferId) noexcept;
+
+        constexpr types::u16 groupId() const noexcept { return m_GroupId; }
+
+    private:
+        Ring &m_Ring;
+        types::u16 m_GroupId;
+        types::u16 m_Count;
+        types::u32 m_BufferSize;
+        io_uring_buf_ring *m_BufRing{ nullptr };
+        types::size m_BufRingLen{ 0 };
+        std::vector<types::u8> m_Storage;
+    };
+
+} // namespace my_redis::event::uring
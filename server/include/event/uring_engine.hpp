@@ -0,0 +1,101 @@
+#pragma once
+
+#include "connection.hpp"
+#include "event/uring.hpp"
+#include "shard.hpp"
+
+#include "socket.hpp"
+
+#include <sys/socket.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace my_redis::event
+{
+    // Completion-based I/O engine built on io_uring.
+    // Listeners are served by multishot accepts, clients by multishot recv into
+    // a kernel-provided buffer ring, and responses are sent straight from the
+    // connection's output. All SQEs produced while handling a batch of completions
+    // are flushed together by a single io_uring_enter().
+    class UringEngine
+    {
+    public:
+        // Returns nullptr when the kernel lacks io_uring or one of the required features
+        static std::unique_ptr<UringEngine> create(shard::Shard &shard);
+
+        UringEngine(const UringEngine &)            = delete;
+        UringEngine &operator=(const UringEngine &) = delete;
+
+    public:
+        void addListener(sockets::ServerSocket &&listener);
+        void run();
+
+    private:
+        explicit UringEngine(shard::Shard &shard);
+
+        enum class Op : types::u8
+        {
+            ACCEPT,
+            RECV,
+            SEND,
+            WAKEUP,
+            CANCEL,     // Cancels the multishot recv of a connection whose reading is paused
+            TIMEOUT     // Wakes the loop up for the active expiry cycle
+        };
+
+        struct UringConnection
+        {
+            std::unique_ptr<Connection> connection;
+            output::Queue sending;          // Bytes referenced by the in-flight send
+            std::array<iovec, output::Queue::K_MAX_IOV> iov{};     // Pieces of `sending`, when it references blobs
+            msghdr message{};
+            types::u32 inFlight{ 0 };       // Number of armed operations referencing this connection
+            bool recvArmed{ false };
+            bool recvPaused{ false };       // See `readPaused()`, no recv is re-armed meanwhile
+            bool sendInFlight{ false };
+            bool closing{ false };
+        };
+
+        static constexpr types::u64 userData(types::i32 fd, Op op) noexcept
+        {
+            return (static_cast<types::u64>(fd) << 8) | static_cast<types::u8>(op);
+        }
+
+        io_uring_sqe *getSqe();
+        void armAccept(types::i32 fd);
+        void armWakeup();
+        void armTimeout(types::i32 timeoutMs);
+        void armRecv(UringConnection &uc);
+        void updateRecv(UringConnection &uc);
+        void flushOutput(UringConnection &uc);
+        void startClose(UringConnection &uc);
+
+        void handleCompletion(const io_uring_cqe &cqe);
+        void handleAccept(types::i32 listenerFd, const io_uring_cqe &cqe);
+        void handleRecv(UringConnection &uc, const io_uring_cqe &cqe);
+        void handleSend(UringConnection &uc, const io_uring_cqe &cqe);
+        void drainMailbox();
+
+    private:
+        static constexpr types::u32 K_RING_ENTRIES  = 4096;
+        static constexpr types::u16 K_BUFFER_GROUP  = 0;
+        static constexpr types::u16 K_BUFFER_COUNT  = 512;
+        static constexpr types::u32 K_BUFFER_SIZE   = 16 * 1024;
+
+        shard::Shard &m_Shard;
+        types::u64 m_NextConnectionId{ 1 };
+        types::u64 m_WakeupCount{ 0 };      // Target of the read on the mailbox eventfd
+        __kernel_timespec m_Timeout{};
+        bool m_TimeoutArmed{ false };
+
+        uring::Ring m_Ring;
+        uring::BufferRing m_BufferRing;
+        bool m_MultishotAccept{ true };
+        bool m_MultishotRecv{ true };
+
+        std::vector<sockets::ServerSocket> m_Listeners;
+        std::vector<std::unique_ptr<UringConnection>> m_Connections; // indexed by fd
+    };
+} // namespace my_redis::event
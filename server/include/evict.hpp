@@ -0,0 +1,91 @@
+#pragma once
+
+#include "entry.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace my_redis::shard
+{
+    struct Shard;
+}
+
+namespace my_redis::evict
+{
+    /*
+        * Memory limit of the process, and the eviction of keys to stay under it.
+        *
+        * Memory is accounted rather than measured: every shard publishes the bytes of its
+        * entries, index, expiry heap and sorted sets, while blobs and I/O buffers are
+        * counted process-wide. Write commands evict keys of their own shard while the
+        * total exceeds `maxmemory`, a bounded number per command, so that the loop never
+        * stalls on a large backlog: the next writes carry on.
+        *
+        * Keys are picked by sampling, as Redis does: a few keys next to a random position
+        * are scored, and the best candidates are kept in a small pool across evictions.
+        * The 32 `Entry::access` bits hold what the policy scores:
+        *  - allkeys-lru: the coarse clock in seconds at the last access
+        *  - allkeys-lfu: | minutes at the last decay (24 bits) | logarithmic access counter (8 bits) |
+        * Both clocks take decades to wrap, an idle key never looks recently accessed.
+        * volatile-ttl needs no sampling, it evicts the key expiring first off the expiry heap.
+    */
+    enum class Policy
+    {
+        NOEVICTION,     // Refuse the writes that may grow memory instead
+        ALLKEYS_LRU,
+        ALLKEYS_LFU,
+        VOLATILE_TTL,
+    };
+
+    std::optional<Policy> parsePolicy(std::string_view name) noexcept;
+    std::string_view policyName(Policy policy) noexcept;
+
+    // Eviction candidates of a shard, sorted by score: the best one is last
+    struct Pool
+    {
+        static constexpr types::size K_SIZE = 16;
+
+        struct Candidate
+        {
+            types::u64 score = 0;       // The higher, the sooner evicted
+            types::u64 hash = 0;
+            std::string key;            // Entries may be freed or moved before their turn comes
+        };
+
+        std::array<Candidate, K_SIZE> candidates;
+        types::size count = 0;
+        types::u64 random = 0x9E3779B97F4A7C15;     // Sampling position, xorshift state
+    };
+
+    // Called once at startup, after the keyspace was loaded and before the loops start.
+    // A `maxMemory` of 0 means no limit. The loaded keys count as just accessed.
+    void configure(types::size maxMemory, Policy policy);
+
+    // Reset the access bits of a new entry, or record an access to an existing one
+    void init(entry::Entry *entry) noexcept;
+    void touch(entry::Entry *entry) noexcept;
+
+    // Publish the bytes used by `shard`. Called by its owner after changing the keyspace.
+    void account(shard::Shard &shard) noexcept;
+
+    // Called before a write command: evict keys of `shard` while the process is over
+    // `maxmemory`, up to `K_MAX_EVICTIONS`. Returns false when over the limit without
+    // anything left to evict, commands that may grow memory are then refused.
+    constexpr types::size K_MAX_EVICTIONS = 32;
+    constexpr std::string_view K_OOM = "OOM command not allowed when used memory > 'maxmemory'";
+    bool beforeWrite(shard::Shard &shard);
+
+    struct Status
+    {
+        types::size usedMemory;
+        types::size maxMemory;
+        Policy policy;
+        types::u64 evictedKeys;
+    };
+
+    Status status() noexcept;
+
+} // namespace my_redis::evict
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "entry.hpp"
+#include "types.hpp"
+
+#include <vector>
+
+namespace my_redis::expiry
+{
+    // Min-heap of the entries with a TTL, ordered by expiration time.
+    // Each entry records its position in `Expiry::heapIndex`, so it can be
+    // removed or rescheduled in O(log n) when it is deleted or updated.
+    class Heap
+    {
+    public:
+        void push(entry::Entry *entry);
+        void remove(entry::Entry *entry) noexcept;
+
+        // Restore the order after `expireAt` of a queued entry changed
+        void update(entry::Entry *entry) noexcept;
+
+        entry::Entry *top() const noexcept { return m_Nodes.front().entry; }
+        types::u64 topExpireAt() const noexcept { return m_Nodes.front().expireAt; }
+
+        bool empty() const noexcept { return m_Nodes.empty(); }
+        types::size size() const noexcept { return m_Nodes.size(); }
+        types::size memoryBytes() const noexcept { return m_Nodes.capacity() * sizeof(Node); }
+
+    private:
+        // The expiration time is cached next to the pointer, so that
+        // comparisons do not dereference the entries
+        struct Node
+        {
+            types::u64 expireAt;
+            entry::Entry *entry;
+        };
+
+        void place(types::size i, const Node &node) noexcept;
+        void siftUp(types::size i) noexcept;
+        void siftDown(types::size i) noexcept;
+
+    private:
+        std::vector<Node> m_Nodes;
+    };
+} // namespace my_redis::expiry
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstring>
+#include <string_view>
+
+namespace my_redis::hash
+{
+    // FNV, 32 bits. Former key hash, kept as the baseline of the hash microbenchmark.
+    constexpr types::u32 FNV_OFFSET_BASIS  = 0x811C9DC5;
+    constexpr types::u32 FNV_PRIME         = 0x01000193;
+    inline types::u32 fnv(const types::u8 *data, types::size len) noexcept
+    {
+        types::u32 h = FNV_OFFSET_BASIS;
+        for (types::size i = 0; i < len; i++)
+            h = (h * FNV_PRIME) ^ data[i];
+        return h;
+    }
+
+    // wyhash (final version 4.2, public domain): 64 bits, reads 8-16 bytes per step,
+    // mixing with 64x64->128 bit multiplications. Assumes a little-endian target.
+    namespace wy
+    {
+        constexpr types::u64 K_SECRET[4] = {
+            0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+        };
+
+        inline void mum(types::u64 *a, types::u64 *b) noexcept
+        {
+            __uint128_t r = static_cast<__uint128_t>(*a) * *b;
+            *a = static_cast<types::u64>(r);
+            *b = static_cast<types::u64>(r >> 64);
+        }
+
+        inline types::u64 mix(types::u64 a, types::u64 b) noexcept
+        {
+            mum(&a, &b);
+            return a ^ b;
+        }
+
+        inline types::u64 read8(const types::u8 *p) noexcept
+        {
+            types::u64 v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline types::u64 read4(const types::u8 *p) noexcept
+        {
+            types::u32 v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        // 1 to 3 bytes
+        inline types::u64 read3(const types::u8 *p, types::size k) noexcept
+        {
+            return (static_cast<types::u64>(p[0]) << 16) | (static_cast<types::u64>(p[k >> 1]) << 8) | p[k - 1];
+        }
+    } // namespace wy
+
+    inline types::u64 wyhash(const types::u8 *p, types::size len, types::u64 seed) noexcept
+    {
+        using namespace wy;
+
+        seed ^= mix(seed ^ K_SECRET[0], K_SECRET[1]);
+        types::u64 a = 0, b = 0;
+        if (len <= 16)
+        {
+            if (len >= 4)
+            {
+                a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+                b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+            }
+            else if (len > 0)
+                a = read3(p, len);
+        }
+        else
+        {
+            types::size i = len;
+            if (i > 48)
+            {
+                // Three independent lanes keep the multipliers busy on long keys
+                types::u64 see1 = seed, see2 = seed;
+                do
+                {
+                    seed = mix(read8(p) ^ K_SECRET[1], read8(p + 8) ^ seed);
+                    see1 = mix(read8(p + 16) ^ K_SECRET[2], read8(p + 24) ^ see1);
+                    see2 = mix(read8(p + 32) ^ K_SECRET[3], read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16)
+            {
+                seed = mix(read8(p) ^ K_SECRET[1], read8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+
+        a ^= K_SECRET[1];
+        b ^= seed;
+        mum(&a, &b);
+        return mix(a ^ K_SECRET[0] ^ len, b ^ K_SECRET[1]);
+    }
+
+    // Random seed drawn once per process, before `main()`, so that clients
+    // cannot precompute colliding keys. Read-only afterwards.
+    extern const types::u64 g_seed;
+
+    // Hash of keys, stored in `HashNode::hash`
+    inline types::u64 strHash(const types::u8 *data, types::size len) noexcept
+    {
+        return wyhash(data, len, g_seed);
+    }
+
+    inline types::u64 strHash(std::string_view str) noexcept
+    {
+        return strHash(reinterpret_cast<const types::u8 *>(str.data()), str.size());
+    }
+
+} // namespace my_redis::hash
@@ -5,6 +5,10 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
 namespace my_redis
 {
     namespace hashtable
@@ -29,7 +33,63 @@ namespace my_redis
 
         using CompareFn = bool (*)(HashNode *lhs, HashNode *rhs) noexcept;
         HashNode **lookup(HashTable *tbl, HashNode *key, CompareFn cmp) noexcept;
+
+        // Lookup by a key view and its precomputed hash, without building a key node
+        using KeyCompareFn = bool (*)(HashNode *node, std::string_view key) noexcept;
+        HashNode **lookup(HashTable *tbl, types::u64 hash, std::string_view key, KeyCompareFn cmp) noexcept;
         HashNode *detach(HashTable *tbl, HashNode **from) noexcept;
+
+        // Prefetch the bucket head a lookup of `hash` starts from
+        inline void prefetchBucket(const HashTable *tbl, types::u64 hash) noexcept
+        {
+            if (tbl->table)
+                __builtin_prefetch(&tbl->table[hash & tbl->mask]);
+        }
+
+        // Prefetch the first node chained in the bucket of `hash`. Reads the bucket head,
+        // so it should run once `prefetchBucket()` had time to bring it in.
+        inline void prefetchNode(const HashTable *tbl, types::u64 hash) noexcept
+        {
+            if (tbl->table)
+            {
+                if (const HashNode *node = tbl->table[hash & tbl->mask])
+                    __builtin_prefetch(node);
+            }
+        }
+
+        /*
+            * Cursor iteration over a table of 2^n buckets that may double between two calls.
+            * The cursor is a bucket index incremented from its high bits down: the buckets a
+            * bucket splits into when the table doubles are then all visited after it, so a
+            * resize never makes a scan skip a bucket, at worst revisit some.
+            * While a table is migrating into a larger one, the bucket of the smaller table
+            * and every bucket of the larger one it expands to are visited together.
+        */
+        constexpr types::u64 reverseBits(types::u64 v) noexcept
+        {
+            v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+            v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+            v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+            return __builtin_bswap64(v);
+        }
+
+        // Calls `visit(large, bucket)` for the buckets at `cursor`, returns the next cursor,
+        // 0 once the scan is complete. `smallMask` <= `largeMask`, equal without migration.
+        template <typename Visit>
+        types::u64 scanBuckets(types::u64 cursor, types::size smallMask, types::size largeMask, Visit &&visit)
+        {
+            visit(false, cursor & smallMask);
+            if (smallMask != largeMask)
+            {
+                do
+                {
+                    visit(true, cursor & largeMask);
+                    cursor = reverseBits(reverseBits(cursor | ~largeMask) + 1);
+                } while (cursor & (smallMask ^ largeMask));
+                return cursor;
+            }
+            return reverseBits(reverseBits(cursor | ~smallMask) + 1);
+        }
     } // namespace hashtable
 
     namespace hashmap
@@ -44,5 +104,61 @@ namespace my_redis
         hashtable::HashNode *lookup(HashMap *map, hashtable::HashNode *key, hashtable::CompareFn cmp) noexcept;
         void insert(HashMap *map, hashtable::HashNode *node) noexcept;
         hashtable::HashNode *remove(HashMap *map, hashtable::HashNode *key, hashtable::CompareFn cmp) noexcept;
+
+        hashtable::HashNode *lookup(HashMap *map, types::u64 hash, std::string_view key, hashtable::KeyCompareFn cmp) noexcept;
+        hashtable::HashNode *remove(HashMap *map, types::u64 hash, std::string_view key, hashtable::KeyCompareFn cmp) noexcept;
+
+        // Free the tables. The nodes are owned by the caller.
+        void clear(HashMap *map) noexcept;
+
+        // Size an empty map for `n` nodes, so that inserting them never rehashes
+        void reserve(HashMap *map, types::size n) noexcept;
+
+        // Call `fn(node)` for every node. `fn` must not modify the map.
+        template <typename Fn>
+        void forEach(const HashMap *map, Fn &&fn)
+        {
+            for (const hashtable::HashTable *tbl : { &map->newer, &map->older })
+            {
+                if (!tbl->table)
+                    continue;
+                for (types::size pos = 0; pos < tbl->bucketCount(); ++pos)
+                {
+                    for (hashtable::HashNode *node = tbl->table[pos]; node; node = node->next)
+                        fn(node);
+                }
+            }
+        }
+
+        // Append to `out` the nodes of the buckets at `cursor`, see `hashtable::scanBuckets()`.
+        // Returns the next cursor, 0 once every node present for the whole scan was returned.
+        types::u64 scan(const HashMap *map, types::u64 cursor, std::vector<hashtable::HashNode *> &out);
+
+        // Swap a linked node for another one with the same hash, e.g. after reallocating it
+        void replace(HashMap *map, hashtable::HashNode *from, hashtable::HashNode *to) noexcept;
+
+        // Bytes of the bucket arrays, the nodes are owned by the caller
+        inline types::size tableBytes(const HashMap *map) noexcept
+        {
+            types::size buckets = (map->newer.table ? map->newer.bucketCount() : 0) + (map->older.table ? map->older.bucketCount() : 0);
+            return buckets * sizeof(hashtable::HashNode *);
+        }
+
+        // Up to `n` nodes, chained from consecutive buckets starting at a random one.
+        // Runs of empty buckets are only walked so far. Returns how many were stored in `out`.
+        types::size sample(const HashMap *map, types::u64 random, hashtable::HashNode **out, types::size n) noexcept;
+
+        // Both tables are prefetched while rehashing, the key may still be in either
+        inline void prefetchBucket(const HashMap *map, types::u64 hash) noexcept
+        {
+            hashtable::prefetchBucket(&map->newer, hash);
+            hashtable::prefetchBucket(&map->older, hash);
+        }
+
+        inline void prefetchNode(const HashMap *map, types::u64 hash) noexcept
+        {
+            hashtable::prefetchNode(&map->newer, hash);
+            hashtable::prefetchNode(&map->older, hash);
+        }
     } // namespace hashmap
 }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "entry.hpp"
+#include "hashtable.hpp"
+#include "swisstable.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+namespace my_redis::keyspace
+{
+    // Index of the entries of a shard, selected at build time by the MY_REDIS_KEYSPACE
+    // CMake option: the chained `hashmap` (default) or the open addressing `swisstable`.
+#if defined(MY_REDIS_KEYSPACE_SWISS)
+    using Index = swisstable::SwissTable;
+    namespace impl = swisstable;
+#else
+    using Index = hashmap::HashMap;
+    namespace impl = hashmap;
+#endif
+
+    inline entry::Entry *lookup(Index &index, types::u64 hash, std::string_view key) noexcept
+    {
+        hashtable::HashNode *node = impl::lookup(&index, hash, key, entry::keyEquals);
+        return node ? entry::fromNode(node) : nullptr;
+    }
+
+    // The key must not be present yet
+    inline void insert(Index &index, entry::Entry *entry)
+    {
+        impl::insert(&index, &entry->node);
+    }
+
+    // Unlink the entry, the caller owns it afterwards
+    inline entry::Entry *remove(Index &index, types::u64 hash, std::string_view key) noexcept
+    {
+        hashtable::HashNode *node = impl::remove(&index, hash, key, entry::keyEquals);
+        return node ? entry::fromNode(node) : nullptr;
+    }
+
+    inline void replace(Index &index, entry::Entry *from, entry::Entry *to) noexcept
+    {
+        impl::replace(&index, &from->node, &to->node);
+    }
+
+    // Size an empty index for `n` entries, skipping the incremental growth while they are inserted
+    inline void reserve(Index &index, types::size n)
+    {
+        impl::reserve(&index, n);
+    }
+
+    // Two-stage prefetch of a lookup: the bucket (or control group) first, then the node
+    // it points at. Issued for upcoming keys of a batch, it overlaps their cache misses.
+    inline void prefetchBucket(const Index &index, types::u64 hash) noexcept
+    {
+        impl::prefetchBucket(&index, hash);
+    }
+
+    inline void prefetchNode(const Index &index, types::u64 hash) noexcept
+    {
+        impl::prefetchNode(&index, hash);
+    }
+
+    // Number of entries, expired ones included
+    inline types::size size(const Index &index) noexcept
+    {
+        return index.newer.size + index.older.size;
+    }
+
+    // Bytes of the index itself, the entries excluded
+    inline types::size tableBytes(const Index &index) noexcept
+    {
+        return impl::tableBytes(&index);
+    }
+
+    // Up to `n` entries close to a random position, see `hashmap::sample()`
+    inline types::size sample(const Index &index, types::u64 random, entry::Entry **out, types::size n) noexcept
+    {
+        hashtable::HashNode *nodes[64];
+        types::size count = impl::sample(&index, random, nodes, std::min<types::size>(n, std::size(nodes)));
+        for (types::size i = 0; i < count; ++i)
+            out[i] = entry::fromNode(nodes[i]);
+        return count;
+    }
+
+    // Append the entries of the buckets at `cursor` to `out`, and return the next cursor,
+    // 0 once every entry present for the whole scan was returned at least once
+    inline types::u64 scan(const Index &index, types::u64 cursor, std::vector<entry::Entry *> &out)
+    {
+        thread_local std::vector<hashtable::HashNode *> nodes;    // Reused across calls
+        nodes.clear();
+        cursor = impl::scan(&index, cursor, nodes);
+        for (hashtable::HashNode *node : nodes)
+            out.push_back(entry::fromNode(node));
+        return cursor;
+    }
+
+    // Call `fn(entry)` for every entry, expired ones included. `fn` must not modify the index.
+    template <typename Fn>
+    void forEach(const Index &index, Fn &&fn)
+    {
+        impl::forEach(&index, [&fn](hashtable::HashNode *node) { fn(entry::fromNode(node)); });
+    }
+} // namespace my_redis::keyspace
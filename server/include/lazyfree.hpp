@@ -0,0 +1,60 @@
+#pragma once
+
+#include "blob.hpp"
+#include "types.hpp"
+
+namespace my_redis::zset
+{
+    struct ZSet;
+}
+
+namespace my_redis::lazyfree
+{
+    /*
+        * Background reclamation of the values too costly to free on an event loop.
+        *
+        * A deleted or overwritten key is unlinked from the keyspace right away, and only its
+        * value is handed over: a sorted set with many members, or the reference of the
+        * keyspace to a large blob. Entries stay on the loop, they belong to the slab
+        * allocator of their shard. Loops push to a lock-free MPSC queue, drained by a
+        * single thread sleeping on the count of pending values.
+        *
+        * UNLINK always frees in the background, DEL, overwrites, expiry and eviction do
+        * when the policy is enabled.
+    */
+
+    // Values cheaper than this are freed in place, the hand-off would cost more
+    constexpr types::size K_MIN_ZSET_MEMBERS = 64;
+    constexpr types::size K_MIN_BLOB_BYTES = 1 << 20;
+
+    // Start the thread, before any event loop starts. `enabled` sets the policy of the
+    // implicit frees.
+    void start(bool enabled);
+
+    // Free what is still pending and stop the thread, after every event loop exited
+    void stop();
+
+    // Whether DEL, overwrites, expiry and eviction free in the background
+    bool enabled() noexcept;
+
+    // Whether freeing the value is worth a hand-off
+    bool worthIt(const zset::ZSet *set) noexcept;
+    bool worthIt(const blob::Blob *blob) noexcept;
+
+    // Hand over an unlinked sorted set, or a reference to a blob, from any thread
+    void free(zset::ZSet *set);
+    void release(blob::Blob *blob);
+
+    // Bytes of the blobs handed over and not released yet, still counted by
+    // `blob::allocatedBytes()`. A sorted set leaves the accounting of its shard when unlinked.
+    types::size pendingBytes() noexcept;
+
+    struct Status
+    {
+        types::u64 pending;     // Handed over, not freed yet
+        types::u64 freed;
+    };
+
+    Status status() noexcept;
+
+} // namespace my_redis::lazyfree
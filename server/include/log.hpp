@@ -0,0 +1,99 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <optional>
+#include <string_view>
+
+// Lowest level compiled in: 0 debug, 1 info, 2 warn, 3 error.
+// Calls below it are removed entirely, arguments included.
+#ifndef MY_REDIS_LOG_MIN_LEVEL
+#define MY_REDIS_LOG_MIN_LEVEL 0
+#endif
+
+namespace my_redis::log
+{
+    enum class Level : types::u8
+    {
+        DEBUG,
+        INFO,
+        WARN,
+        ERROR,
+        OFF
+    };
+
+    constexpr Level K_MIN_LEVEL = static_cast<Level>(MY_REDIS_LOG_MIN_LEVEL);
+
+    std::optional<Level> parseLevel(std::string_view name) noexcept;
+
+    namespace detail
+    {
+        extern std::atomic<Level> g_level;
+    }
+
+    // Checked before the arguments of a message are evaluated. For a level below
+    // `K_MIN_LEVEL` this folds to false at compile time.
+    inline bool enabled(Level level) noexcept
+    {
+        return level >= K_MIN_LEVEL && level >= detail::g_level.load(std::memory_order_relaxed);
+    }
+
+    // Runtime level, may be changed at any time
+    void setLevel(Level level) noexcept;
+
+    // Start the thread writing the buffered messages to stderr.
+    // Until then, and after `stop()`, messages are written synchronously.
+    void start();
+
+    // Flush the buffered messages and stop the thread
+    void stop();
+
+    // Lets a call site through at most `K_BURST` times per second, and counts the
+    // messages suppressed meanwhile. Used as a per-thread static by the macros.
+    class RateLimit
+    {
+    public:
+        static constexpr types::u32 K_BURST = 10;
+
+        // On success `suppressed` receives the messages dropped since the last one let through
+        bool allow(types::u32 &suppressed) noexcept;
+
+    private:
+        types::i64 m_Window{ -1 };      // Second the counts refer to
+        types::u32 m_Count{ 0 };
+        types::u32 m_Suppressed{ 0 };
+    };
+
+    // Format a message into the calling thread's ring. Never blocks: when the
+    // ring is full the message is dropped and counted.
+    void write(Level level, types::u32 suppressed, const char *format, ...) noexcept
+        __attribute__((format(printf, 3, 4)));
+
+} // namespace my_redis::log
+
+#define MY_REDIS_LOG(level, ...)                                        \
+    do                                                                  \
+    {                                                                   \
+        if (::my_redis::log::enabled(level))                            \
+            ::my_redis::log::write(level, 0, __VA_ARGS__);              \
+    } while (false)
+
+#define MY_REDIS_LOG_LIMITED(level, ...)                                \
+    do                                                                  \
+    {                                                                   \
+        if (::my_redis::log::enabled(level))                            \
+        {                                                               \
+            static thread_local ::my_redis::log::RateLimit limit_;      \
+            ::my_redis::types::u32 suppressed_ = 0;                     \
+            if (limit_.allow(suppressed_))                              \
+                ::my_redis::log::write(level, suppressed_, __VA_ARGS__);\
+        }                                                               \
+    } while (false)
+
+// printf-style. Warnings and errors are rate limited per call site, as a
+// failing peer or a full disk repeats them on every request.
+#define LOG_DEBUG(...)  MY_REDIS_LOG(::my_redis::log::Level::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)   MY_REDIS_LOG(::my_redis::log::Level::INFO, __VA_ARGS__)
+#define LOG_WARN(...)   MY_REDIS_LOG_LIMITED(::my_redis::log::Level::WARN, __VA_ARGS__)
+#define LOG_ERROR(...)  MY_REDIS_LOG_LIMITED(::my_redis::log::Level::ERROR, __VA_ARGS__)
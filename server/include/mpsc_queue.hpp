@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+namespace my_redis::mpsc
+{
+    // Intrusive link, embed it in the queued type
+    struct Node
+    {
+        std::atomic<Node *> next{ nullptr };
+    };
+
+    // Lock-free intrusive multi-producer single-consumer queue (Vyukov).
+    // `push()` is wait-free and may be called from any thread, `pop()` must only
+    // be called from the consumer thread.
+    class Queue
+    {
+    public:
+        Queue() noexcept : m_Head(&m_Stub), m_Tail(&m_Stub) {}
+
+        Queue(const Queue &)            = delete;
+        Queue &operator=(const Queue &) = delete;
+
+    public:
+        void push(Node *node) noexcept;
+
+        // Returns nullptr when the queue is empty
+        Node *pop() noexcept;
+
+    private:
+        // Wait until a producer, preempted between its two steps, links `node->next`
+        static Node *waitNext(Node *node) noexcept;
+
+    private:
+        std::atomic<Node *> m_Head; // Last pushed node, shared by producers
+        Node *m_Tail;               // Next node to pop, owned by the consumer
+        Node m_Stub;
+    };
+} // namespace my_redis::mpsc
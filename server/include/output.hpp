@@ -0,0 +1,77 @@
+#pragma once
+
+#include "blob.hpp"
+#include "buffer.hpp"
+#include "types.hpp"
+
+#include <sys/uio.h>
+
+#include <deque>
+
+namespace my_redis::output
+{
+    /*
+        * Responses waiting to be sent on a connection. Small responses are copied into a
+        * contiguous buffer, large values are queued by reference and spliced in between
+        * when the queue is gathered into iovecs for writev(2)/sendmsg(2):
+        *
+        * bytes: | resp | resp | hdr |       | resp | hdr |        |
+        * refs:                      ^ blob A             ^ blob B
+        *
+        * Refs record the absolute byte offset they are sent at, so consuming never
+        * has to update them.
+    */
+    class Queue
+    {
+    public:
+        // Upper bound of the iovecs worth gathering at once
+        static constexpr types::size K_MAX_IOV = 64;
+
+        Queue() = default;
+
+        Queue(Queue &&) noexcept            = default;
+        Queue &operator=(Queue &&) noexcept = default;
+
+        Queue(const Queue &)            = delete;
+        Queue &operator=(const Queue &) = delete;
+
+    public:
+        // Responses are serialized straight into the contiguous bytes
+        operator buffer::Buffer &() noexcept { return m_Bytes; }
+
+        // Queue `blob` after the bytes appended so far
+        void append(blob::Ref blob);
+
+        // Move everything queued in `other` to the end of this queue
+        void append(Queue &other);
+
+        bool empty() const noexcept { return m_Bytes.empty() && m_Refs.empty(); }
+
+        // Bytes left to send
+        types::size size() const noexcept { return m_Bytes.size() + m_RefBytes; }
+
+        // Point `iov` at the first pieces to send, in order. Returns how many were filled.
+        types::size gather(iovec *iov, types::size max) const noexcept;
+
+        // Drop the first `n` bytes, once sent
+        void consume(types::size n) noexcept;
+
+        void swap(Queue &other) noexcept;
+
+    private:
+        struct Ref
+        {
+            types::u64 at;          // Offset in the bytes ever appended where the blob is sent
+            types::u32 sent;        // Bytes of the blob already sent
+            blob::Ref blob;
+        };
+
+        types::u64 endOffset() const noexcept { return m_Consumed + m_Bytes.size(); }
+
+        buffer::Buffer m_Bytes;
+        std::deque<Ref> m_Refs;
+        types::u64 m_Consumed{ 0 };     // Bytes consumed from `m_Bytes` so far
+        types::size m_RefBytes{ 0 };    // Bytes of the queued blobs not sent yet
+    };
+
+} // namespace my_redis::output
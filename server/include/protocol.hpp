@@ -0,0 +1,119 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "response.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace my_redis::protocol
+{
+    constexpr types::size K_MAX_ARGS = 200 * 1000;
+
+    // Arguments of a parsed request. The views point into the bytes the request
+    // was parsed from, so they are only valid until those bytes are consumed.
+    // The first `K_INLINE_ARGS` views are stored inline, which covers every
+    // fixed-arity command without touching the heap.
+    class Args
+    {
+    public:
+        static constexpr types::size K_INLINE_ARGS = 8;
+
+        Args() = default;
+
+        Args(const Args &)              = delete;
+        Args &operator=(const Args &)   = delete;
+
+    public:
+        void push_back(std::string_view arg)
+        {
+            if (m_Size < K_INLINE_ARGS)
+            {
+                m_Inline[m_Size++] = arg;
+                return;
+            }
+
+            if (m_Overflow.empty())
+                m_Overflow.assign(m_Inline.begin(), m_Inline.end());
+            m_Overflow.push_back(arg);
+            m_Size++;
+        }
+
+        void clear() noexcept
+        {
+            m_Size = 0;
+            m_Overflow.clear();
+        }
+
+        std::span<const std::string_view> span() const noexcept
+        {
+            return m_Size <= K_INLINE_ARGS ? std::span<const std::string_view>{ m_Inline.data(), m_Size }
+                                           : std::span<const std::string_view>{ m_Overflow };
+        }
+
+        types::size size() const noexcept { return m_Size; }
+        bool empty() const noexcept { return m_Size == 0; }
+        std::string_view operator[](types::size i) const noexcept { return span()[i]; }
+
+        auto begin() const noexcept { return span().begin(); }
+        auto end() const noexcept { return span().end(); }
+
+    private:
+        std::array<std::string_view, K_INLINE_ARGS> m_Inline{};
+        std::vector<std::string_view> m_Overflow;
+        types::size m_Size{ 0 };
+    };
+
+    // Parse the message of a request into `out`, without copying the arguments.
+    // Request format: "nstr(count of strings) | len1     str1         | len2 str2 | ... | lenN strN"
+    //                  ^ 4Bytes                 ^ 4Bytes ^ len1 Bytes
+    bool parseRequest(const types::u8 *data, types::size size, Args &out);
+
+    // Append the `count` arguments, each `| len | str |`, that make up exactly `size` bytes to `out`
+    bool parseArgs(const types::u8 *data, types::size size, types::size count, Args &out);
+
+    // Append a request to `out` as a client sends it: | length of the rest (4 bytes) | nstr | len1 | str1 | ...
+    void appendRequest(buffer::Buffer &out, std::span<const std::string_view> args);
+
+    // Append a response to `out`.
+    // Response format: | length of the rest (4 bytes) | status (4 bytes) | data |
+    void appendResponse(buffer::Buffer &out, Response::Status status, std::string_view data = {});
+
+    // Only the header of a response whose `length` bytes of data are queued separately
+    void appendResponseHeader(buffer::Buffer &out, Response::Status status, types::size length);
+
+    // Integers travel as decimal text, in arguments as well as in RES_OK responses
+    void appendInteger(buffer::Buffer &out, types::i64 value);
+    std::optional<types::i64> parseInteger(std::string_view arg) noexcept;
+
+    // Doubles use the shortest text that parses back to the same value, and "inf"/"-inf"
+    void appendDouble(buffer::Buffer &out, double value);
+    std::optional<double> parseDouble(std::string_view arg) noexcept;
+
+    // Writes a RES_ARR response item by item, the header is patched by `finish()`
+    class ArrayWriter
+    {
+    public:
+        explicit ArrayWriter(buffer::Buffer &out);
+
+        ArrayWriter(const ArrayWriter &)            = delete;
+        ArrayWriter &operator=(const ArrayWriter &) = delete;
+
+    public:
+        void add(std::string_view item);
+        void add(double value);
+        // A missing item, see `Response::K_NIL_LEN`
+        void addNil();
+        void finish() noexcept;
+
+    private:
+        buffer::Buffer &m_Out;
+        types::size m_Start;        // Offset of the response in `m_Out`
+        types::u32 m_Count{ 0 };
+    };
+
+} // namespace my_redis::protocol
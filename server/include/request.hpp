@@ -0,0 +1,42 @@
+#pragma once
+
+#include "connection.hpp"
+#include "shard.hpp"
+
+namespace my_redis
+{
+    // Bytes a connection may buffer, both ways. A client whose unparsed requests exceed it
+    // is disconnected, large arguments streamed into their blob excepted. Parsing pauses
+    // while the replies waiting to be sent exceed it.
+    constexpr types::size K_DEFAULT_BUFFER_LIMIT = 64 << 20;
+
+    // Largest argument streamed into a blob, a larger one closes the connection. The blob
+    // grows as the bytes arrive, a header alone does not commit its whole length.
+    constexpr types::size K_DEFAULT_MAX_VALUE_SIZE = 512 << 20;
+
+    // Called once at startup
+    void setBufferLimit(types::size bytes) noexcept;
+    void setMaxValueSize(types::size bytes) noexcept;
+
+    // Try to parse and execute one complete request from `incomingBuffer`,
+    // appending the response to `outgoingBuffer`. Requests for keys owned by
+    // another shard are forwarded to it, and parsing goes on: the replies of the
+    // next requests are held back until its own was delivered with `deliverReply()`.
+    // Keyless commands wait for the forwarded requests. A request with a large argument
+    // still arriving is streamed: the argument's bytes are moved into a blob as
+    // they come in, and the request runs once its last byte did.
+    // Returns false when no complete request is available or the connection must be closed.
+    bool tryParseRequest(Connection &connection, shard::Shard &shard);
+
+    // Whether parsing waits for replies to be sent or delivered, or is behind the input
+    // over the buffer limit: more input would only be buffered. The engines stop reading
+    // meanwhile, so that TCP pushes back on the client.
+    bool readPaused(const Connection &connection) noexcept;
+
+    // Execute a request forwarded by another shard and send the reply back to it
+    void executeForwarded(shard::Shard &shard, shard::Message &message);
+
+    // Fill the reply slot of a forwarded request, and queue the replies no longer held back
+    void deliverReply(Connection &connection, shard::Message &message);
+
+} // namespace my_redis
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "command.hpp"
+#include "evict.hpp"
+#include "expiry.hpp"
+#include "keyspace.hpp"
+#include "mpsc_queue.hpp"
+#include "output.hpp"
+#include "slab.hpp"
+#include "stats.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace my_redis::shard
+{
+    // A request forwarded to the shard owning its key, and sent back with the response
+    struct Message
+    {
+        mpsc::Node node;
+
+        enum class Kind
+        {
+            REQUEST,
+            REPLY
+        } kind = Kind::REQUEST;
+
+        types::u32 origin = 0;          // Shard of the thread holding the client connection
+        types::u32 owner = 0;           // Shard executing the request
+        types::i32 fd = -1;             // Client connection on the origin thread
+        types::u64 connectionId = 0;    // Guards against the fd having been reused
+        types::u64 slot = 0;            // Sequence number of the reply slot on the connection
+        const command::Command *command = nullptr;
+        types::u64 keyHash = 0;
+        std::vector<types::u64> keyHashes;  // Multi-key commands: the keys of `args` owned by `owner`
+        std::vector<std::string> args;
+        blob::Ref argBlob;              // A streamed argument, its slot in `args` stays empty
+        types::size argBlobIndex = 0;
+        output::Queue reply;            // Serialized response
+    };
+
+    // Inbox of a shard: a lock-free MPSC queue plus an eventfd to wake up the owning loop.
+    class Mailbox
+    {
+    public:
+        Mailbox();
+        ~Mailbox();
+
+        Mailbox(const Mailbox &)            = delete;
+        Mailbox &operator=(const Mailbox &) = delete;
+
+    public:
+        // Called from any thread
+        void push(Message *message) noexcept;
+
+        // Wake up the owning loop without a message, from any thread
+        void wake() noexcept;
+
+        // Called by the owning loop once woken up, before draining the queue with `pop()`
+        void acknowledge() noexcept;
+        Message *pop() noexcept;
+
+        constexpr types::i32 fd() const noexcept { return m_WakeFd; }
+
+    private:
+        mpsc::Queue m_Queue;
+        std::atomic<bool> m_Notified{ false };
+        types::i32 m_WakeFd{ -1 };
+    };
+
+    // A partition of the keyspace, owned by exactly one event loop thread
+    struct Shard
+    {
+        types::u32 id = 0;
+        slab::Allocator allocator;      // Backs the entries of `db`, declared first to outlive it
+        keyspace::Index db;
+        expiry::Heap expires;           // Entries of `db` with a TTL
+        Mailbox mailbox;
+        command::Stats commandStats;
+        stats::LoopStats loopStats;
+        std::atomic<bool> statsResetPending{ false };   // Set by any thread, applied by the owner
+        types::u64 dirty = 0;           // Changes made to `db`, commands that made none are not logged
+        buffer::Buffer aofPending;      // Write commands of the current iteration, see aof.hpp
+        buffer::Buffer aofRewriteDiff;  // Write commands logged while the log is being rewritten
+        std::vector<types::u64> keyHashes;  // Scratch for the key hashes of multi-key commands
+        std::atomic<types::size> memoryUsed{ 0 };   // Published by the owner, see evict.hpp
+        types::size objectBytes = 0;    // Sorted sets owned by entries of `db`
+        evict::Pool evictionPool;
+        stats::Counter evictedKeys;
+    };
+
+    // Create `count` shards. Must be called before any event loop starts.
+    void init(types::u32 count);
+
+    types::u32 count() noexcept;
+    Shard &at(types::u32 id) noexcept;
+
+    // Shard owning a key with the given hash
+    types::u32 ownerOf(types::u64 hash) noexcept;
+
+    // Ask every shard to clear its statistics. The counters are only written by their
+    // owner, so each loop clears its own at the start of its next iteration, and
+    // readers treat a shard with a pending reset as empty meanwhile.
+    void requestStatsReset() noexcept;
+
+    // Called by the owning loop
+    void applyStatsReset(Shard &shard) noexcept;
+
+    // Run `action` from a command handler or the loop of `caller` while every other loop is parked
+    // between two iterations, so that it can read or copy all the shards. Returns false,
+    // without running it, when another thread is already doing so.
+    bool stopTheWorld(Shard &caller, const std::function<void()> &action);
+
+    // Called by the owning loop at the start of every iteration: waits for the end of a
+    // pending `stopTheWorld()`
+    void parkIfStopped(Shard &shard);
+
+} // namespace my_redis::shard
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <array>
+
+namespace my_redis::slab
+{
+    /*
+        * Size-class slab allocator for small, variable-sized objects.
+        * Requests up to K_MAX_SMALL bytes are rounded up to one of the size classes
+        * (16 byte steps up to 128, then 4 classes per power of 2), so internal waste
+        * stays under 25%. Each class carves chunks out of K_SLAB_SIZE aligned slabs,
+        * freed chunks are reused by the same class, and a slab is handed back to the
+        * system once it is empty, which bounds external fragmentation.
+        * Larger requests go to malloc.
+        * Not thread-safe: every shard owns its allocator.
+    */
+    class Allocator
+    {
+    public:
+        static constexpr types::size K_SLAB_SIZE = 64 * 1024;
+        static constexpr types::size K_MAX_SMALL = 4096;
+
+        Allocator() = default;
+        ~Allocator();
+
+        Allocator(const Allocator &)            = delete;
+        Allocator &operator=(const Allocator &) = delete;
+
+    public:
+        // Size actually reserved for a request of `n` bytes. Callers may use all of it.
+        static types::size usableSize(types::size n) noexcept;
+
+        void *allocate(types::size n);
+        // `n` must be the requested size or the usable size of the allocation
+        void deallocate(void *ptr, types::size n) noexcept;
+
+        // Bytes handed out to callers (rounded to size classes) and held in slabs
+        constexpr types::size allocatedBytes() const noexcept { return m_AllocatedBytes; }
+        constexpr types::size slabBytes() const noexcept { return m_SlabCount * K_SLAB_SIZE; }
+
+    private:
+        struct FreeChunk
+        {
+            FreeChunk *next;
+        };
+
+        struct Slab
+        {
+            Slab *prev;
+            Slab *next;
+            FreeChunk *freeList;    // Chunks released by `deallocate()`
+            types::u8 *bump;        // Chunks never handed out start here
+            types::u32 used;
+            types::u32 capacity;
+        };
+
+        struct SizeClass
+        {
+            Slab *partial = nullptr;    // Slabs with at least one free chunk
+            Slab *full = nullptr;
+            types::size slabCount = 0;
+        };
+
+        static constexpr types::size K_CLASS_COUNT = 28;
+
+        static types::size classOf(types::size n) noexcept;
+        static types::size classSize(types::size index) noexcept;
+
+        Slab *newSlab(types::size index);
+        static void unlink(Slab *&list, Slab *slab) noexcept;
+        static void pushFront(Slab *&list, Slab *slab) noexcept;
+
+    private:
+        std::array<SizeClass, K_CLASS_COUNT> m_Classes{};
+        types::size m_AllocatedBytes{ 0 };
+        types::size m_SlabCount{ 0 };
+    };
+} // namespace my_redis::slab
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <string>
+
+namespace my_redis::shard
+{
+    struct Shard;
+}
+
+namespace my_redis::snapshot
+{
+    /*
+        * Point-in-time copy of every shard in a single file, in host byte order:
+        *
+        * | "MYRSNAP\0" | version u32 | reserved u32 | createdAt u64 | records .. | keys u64 | checksum u64 |
+        * |<------------------------- 24 bytes ------------------------>|            |<----- 16 bytes ---->|
+        *
+        * record: | type u8 | flags u8 | keyLen u32 | valueLen u32 | [expireAt u64] | key | value |
+        * ZSET value: | count u32 | score f64 | len u32 | name | .. count times, in set order |
+        *
+        * The checksum chains wyhash over `K_CHUNK_SIZE` pieces of everything before it,
+        * so that it is computed while the file streams through, on both ends.
+        * Keys are hashed again on load: the hash seed is chosen per process.
+    */
+    constexpr types::u32 K_VERSION = 1;
+    constexpr types::size K_CHUNK_SIZE = 1 << 20;
+
+    // Path written by SAVE and BGSAVE, and loaded at startup
+    void init(std::string path);
+    const std::string &path() noexcept;
+
+    // Load the snapshot into the shards, before any event loop starts. Every shard index
+    // is sized for its share of the keys up front, so loading never rehashes.
+    // A missing file leaves the shards empty. Returns false when the file cannot be
+    // read or is corrupted.
+    bool load();
+
+    enum class Result
+    {
+        OK,
+        BUSY,       // Another save is running
+        FAILED
+    };
+
+    // Write the snapshot from a command handler of `caller`, every loop stopped meanwhile
+    Result save(shard::Shard &caller);
+
+    // Fork a child writing the snapshot from its copy-on-write image of the shards.
+    // The loops are only stopped for the duration of fork(2).
+    Result saveInBackground(shard::Shard &caller);
+
+    // Called by every loop once per iteration: the loop of shard 0 reaps a finished
+    // background save
+    void poll(const shard::Shard &shard);
+
+    struct Status
+    {
+        bool inProgress;            // A background save is running
+        bool lastSaveOk;
+        types::u64 lastSaveAt;      // Unix time in milliseconds of the last successful save, 0 if none
+    };
+
+    Status status();
+
+} // namespace my_redis::snapshot
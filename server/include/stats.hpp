@@ -0,0 +1,87 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <array>
+#include <atomic>
+
+namespace my_redis::stats
+{
+    // Counters and histograms are only written by the thread owning them, so an
+    // update is a relaxed load/store pair: no lock prefix, no allocation. Any
+    // thread may read them.
+
+    class Counter
+    {
+    public:
+        void add(types::u64 n) noexcept
+        {
+            m_Value.store(m_Value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        types::u64 value() const noexcept { return m_Value.load(std::memory_order_relaxed); }
+        void reset() noexcept { m_Value.store(0, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<types::u64> m_Value{ 0 };
+    };
+
+    // Log-linear histogram in the spirit of HdrHistogram: every power of 2 is split
+    // into `K_SUB_BUCKETS` linear buckets, so a recorded value is known within
+    // 1/16 (6.25%) of itself. Values under 16 are exact, values are clamped to 2^36.
+    class Histogram
+    {
+    public:
+        static constexpr types::u32 K_SUB_BITS      = 4;
+        static constexpr types::u32 K_SUB_BUCKETS   = 1 << K_SUB_BITS;
+        static constexpr types::u32 K_MAX_BITS      = 36;
+        static constexpr types::size K_BUCKETS      = (K_MAX_BITS - K_SUB_BITS + 1) * K_SUB_BUCKETS;
+
+        void record(types::u64 value) noexcept;
+        void reset() noexcept;
+
+        // Bucket holding `value`, and the highest value of a bucket
+        static types::size bucketOf(types::u64 value) noexcept;
+        static types::u64 bucketMax(types::size bucket) noexcept;
+
+    private:
+        friend struct Summary;
+
+        static void bump(std::atomic<types::u64> &counter, types::u64 n) noexcept
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<types::u64>, K_BUCKETS> m_Buckets{};
+        std::atomic<types::u64> m_Count{ 0 };
+        std::atomic<types::u64> m_Sum{ 0 };
+        std::atomic<types::u64> m_Max{ 0 };
+    };
+
+    // Plain copy of one or more histograms, e.g. the same command on every shard
+    struct Summary
+    {
+        std::array<types::u64, Histogram::K_BUCKETS> buckets{};
+        types::u64 count = 0;
+        types::u64 sum = 0;
+        types::u64 max = 0;
+
+        void add(const Histogram &histogram) noexcept;
+
+        // Highest value of the bucket reaching quantile `q` in [0, 1], 0 when empty
+        types::u64 percentile(double q) const noexcept;
+        double mean() const noexcept { return count ? static_cast<double>(sum) / count : 0.0; }
+    };
+
+    // Activity of one event loop
+    struct LoopStats
+    {
+        Counter wakeups;            // Returns from poll/io_uring_enter with work to do
+        Counter bytesIn;
+        Counter bytesOut;
+        Histogram readyPerWakeup;   // Events or completions handled per wakeup
+        Histogram pipelineDepth;    // Requests parsed from a single read
+
+        void reset() noexcept;
+    };
+} // namespace my_redis::stats
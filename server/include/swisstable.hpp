@@ -0,0 +1,86 @@
+#pragma once
+
+#include "hashtable.hpp"
+#include "types.hpp"
+
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+namespace my_redis::swisstable
+{
+    /*
+        * Open addressing table of `HashNode` pointers, in the style of Abseil's Swiss tables.
+        * Every slot has a control byte: EMPTY, DELETED, or the low 7 bits of the hash (H2).
+        * Lookups probe 16 control bytes at a time, compare them against H2 with SSE2, and
+        * only touch the nodes whose tag matches.
+        * Like `hashmap::HashMap`, growing is incremental: a bounded number of nodes moves
+        * from `older` to `newer` on every operation.
+    */
+    struct RawTable
+    {
+        types::i8 *ctrl = nullptr;                  // capacity + K_GROUP_WIDTH - 1 bytes, the tail mirrors the head
+        hashtable::HashNode **slots = nullptr;
+        types::size mask = 0;                       // capacity - 1, capacity is a power of 2
+        types::size size = 0;                       // number of nodes
+        types::size tombstones = 0;                 // DELETED control bytes
+
+        constexpr types::size capacity() const noexcept { return ctrl ? mask + 1 : 0; }
+    };
+
+    struct SwissTable
+    {
+        RawTable newer;
+        RawTable older;
+        types::size migratePos = 0;
+
+        SwissTable() = default;
+        ~SwissTable();
+
+        SwissTable(const SwissTable &)              = delete;
+        SwissTable &operator=(const SwissTable &)   = delete;
+    };
+
+    hashtable::HashNode *lookup(SwissTable *table, types::u64 hash, std::string_view key, hashtable::KeyCompareFn cmp) noexcept;
+    // The key must not be present yet
+    void insert(SwissTable *table, hashtable::HashNode *node);
+    hashtable::HashNode *remove(SwissTable *table, types::u64 hash, std::string_view key, hashtable::KeyCompareFn cmp) noexcept;
+
+    // Swap a stored node for another one with the same hash
+    void replace(SwissTable *table, hashtable::HashNode *from, hashtable::HashNode *to) noexcept;
+
+    // Size an empty table for `n` nodes, so that inserting them never resizes
+    void reserve(SwissTable *table, types::size n);
+
+    // Bytes of the slot and control arrays, the nodes are owned by the caller
+    types::size tableBytes(const SwissTable *table) noexcept;
+
+    // Up to `n` nodes from consecutive slots starting at a random one.
+    // Returns how many were stored in `out`.
+    types::size sample(const SwissTable *table, types::u64 random, hashtable::HashNode **out, types::size n) noexcept;
+
+    // Append to `out` the nodes whose probe sequence starts at the slot of `cursor`, see
+    // `hashtable::scanBuckets()`. Returns the next cursor, 0 once the scan is complete.
+    types::u64 scan(const SwissTable *table, types::u64 cursor, std::vector<hashtable::HashNode *> &out);
+
+    // Prefetch the first control group and slots a lookup of `hash` probes
+    void prefetchBucket(const SwissTable *table, types::u64 hash) noexcept;
+    // Prefetch the node of the first slot whose tag matches `hash`. Reads the control
+    // bytes, so it should run once `prefetchBucket()` had time to bring them in.
+    void prefetchNode(const SwissTable *table, types::u64 hash) noexcept;
+
+    // Call `fn(node)` for every node. `fn` must not modify the table.
+    template <typename Fn>
+    void forEach(const SwissTable *table, Fn &&fn)
+    {
+        for (const RawTable *raw : { &table->newer, &table->older })
+        {
+            for (types::size i = 0; i < raw->capacity(); ++i)
+            {
+                // Full slots have the high bit of their control byte clear
+                if (raw->ctrl[i] >= 0)
+                    fn(raw->slots[i]);
+            }
+        }
+    }
+} // namespace my_redis::swisstable
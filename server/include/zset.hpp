@@ -0,0 +1,77 @@
+#pragma once
+
+#include "avl.hpp"
+#include "hashtable.hpp"
+#include "types.hpp"
+
+#include <string_view>
+
+namespace my_redis::zset
+{
+    // A member and its score in one allocation, linked in both indexes of its set
+    struct ZNode
+    {
+        hashtable::HashNode hmap;   // By name
+        avl::AvlNode tree;          // By (score, name)
+        double score = 0;
+        types::u32 len = 0;
+
+        std::string_view name() const noexcept { return { reinterpret_cast<const char *>(this + 1), len }; }
+    };
+
+    /*
+        * Sorted set: a hash map for O(1) member lookup, plus an AVL tree ordered
+        * by (score, name) and augmented with subtree sizes, so that rank and offset
+        * queries are O(log n).
+    */
+    struct ZSet
+    {
+        avl::AvlNode *root = nullptr;
+        hashmap::HashMap members;
+        types::size nodeBytes = 0;      // Allocated for the members
+
+        ZSet() = default;
+        ~ZSet();
+
+        ZSet(const ZSet &)              = delete;
+        ZSet &operator=(const ZSet &)   = delete;
+    };
+
+    inline ZNode *fromTree(avl::AvlNode *node) noexcept
+    {
+        return node ? reinterpret_cast<ZNode *>(reinterpret_cast<char *>(node) - offsetof(ZNode, tree)) : nullptr;
+    }
+
+    inline types::size length(const ZSet *zset) noexcept
+    {
+        return avl::count(zset->root);
+    }
+
+    // Memory held by the set, its tables included
+    inline types::size memoryBytes(const ZSet *zset) noexcept
+    {
+        return sizeof(ZSet) + zset->nodeBytes + hashmap::tableBytes(&zset->members);
+    }
+
+    ZNode *lookup(ZSet *zset, std::string_view name) noexcept;
+
+    // Add a member or update its score. Returns true when the member was added.
+    bool insert(ZSet *zset, std::string_view name, double score);
+
+    // Returns true when the member existed
+    bool remove(ZSet *zset, std::string_view name) noexcept;
+
+    // First node ordered at or after (score, name), nullptr if none
+    ZNode *seekGe(ZSet *zset, double score, std::string_view name) noexcept;
+    // First node with a score strictly greater than `score`, nullptr if none
+    ZNode *seekGt(ZSet *zset, double score) noexcept;
+
+    // Node at a zero-based rank, nullptr when out of range
+    ZNode *byRank(ZSet *zset, types::i64 rank) noexcept;
+
+    // Node `offset` positions away from `node` in the order of the set
+    ZNode *offset(ZNode *node, types::i64 offset) noexcept;
+
+    types::i64 rank(const ZNode *node) noexcept;
+
+} // namespace my_redis::zset
@@ -0,0 +1,652 @@
+#include "aof.hpp"
+
+#include "db.hpp"
+#include "entry.hpp"
+#include "exception.hpp"
+#include "hash.hpp"
+#include "keyspace.hpp"
+#include "log.hpp"
+#include "payload.hpp"
+#include "shard.hpp"
+#include "zset.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace my_redis::aof
+{
+    using namespace my_redis::types;
+    using entry::Entry;
+
+    namespace
+    {
+        // Rewrites buffer this much before writing it out
+        constexpr size K_WRITE_CHUNK = 1 << 20;
+        // Members per ZADD of a rewritten sorted set
+        constexpr size K_ZADD_BATCH = 128;
+
+        constexpr auto K_SYNC_INTERVAL = std::chrono::seconds{ 1 };
+        // How often the background thread checks on a running rewrite
+        constexpr auto K_REWRITE_POLL_INTERVAL = std::chrono::milliseconds{ 100 };
+
+        std::string g_path;
+        FsyncPolicy g_policy = FsyncPolicy::EVERYSEC;
+        bool g_enabled = false;                 // Set before the loops start
+
+        // Only replaced while every loop is stopped, the fsync thread reads it under `g_fdMutex`
+        i32 g_fd = -1;
+        std::mutex g_fdMutex;
+
+        // Serializes the writes of the loops, so that a short write can be rolled back
+        // before anything follows it
+        std::mutex g_writeMutex;
+        std::atomic<u64> g_size{ 0 };           // Written under `g_writeMutex`
+
+        std::atomic<bool> g_dirty{ false };     // Written since the last fdatasync(2)
+        std::atomic<bool> g_lastWriteOk{ true };
+
+        std::atomic<bool> g_rewriting{ false }; // From the fork until the new log replaced the old one
+        std::atomic<i32> g_child{ 0 };          // Pid of the rewriting child, 0 once reaped
+        std::atomic<bool> g_childOk{ false };
+        std::atomic<bool> g_lastRewriteOk{ true };
+
+        std::jthread g_thread;
+        std::mutex g_threadMutex;
+        std::condition_variable_any g_threadWake;
+
+        double msSince(std::chrono::steady_clock::time_point start) noexcept
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        std::string tmpPath()
+        {
+            return g_path + ".tmp";
+        }
+
+        // Returns how many bytes were written before an error, `n` on success
+        size writeSome(i32 fd, const u8 *data, size n) noexcept
+        {
+            size written = 0;
+            while (written < n)
+            {
+                auto count = ::write(fd, data + written, n - written);
+                if (count < 0 && errno == EINTR)
+                    continue;
+                if (count < 0)
+                    break;
+                written += static_cast<size>(count);
+            }
+            return written;
+        }
+
+        void writeOut(i32 fd, buffer::Buffer &out)
+        {
+            if (writeSome(fd, out.data(), out.size()) != out.size())
+                throw exception::errno_exception{ "aof::writeOut() -> write()" };
+            out.clear();
+        }
+
+        // Write the pending commands of `shard` to the log. Returns false when some are
+        // left for the next attempt.
+        bool writePending(shard::Shard &shard)
+        {
+            buffer::Buffer &pending = shard.aofPending;
+            if (pending.empty())
+                return true;
+
+            size written = 0;
+            int error = 0;
+            {
+                std::lock_guard lock{ g_writeMutex };
+                written = writeSome(g_fd, pending.data(), pending.size());
+                error = errno;
+                // Never leave part of a command behind, the next write would follow it.
+                // When that fails too, the rest of the command must come next instead.
+                if (written < pending.size() && written > 0 && 0 == ::ftruncate(g_fd, static_cast<off_t>(g_size.load())))
+                    written = 0;
+                g_size.fetch_add(written, std::memory_order_relaxed);
+            }
+
+            if (g_rewriting.load(std::memory_order_relaxed))
+                shard.aofRewriteDiff.append(pending.data(), written);
+            bool complete = written == pending.size();
+            pending.consume(written);
+
+            g_dirty.store(true, std::memory_order_release);
+            g_lastWriteOk.store(complete, std::memory_order_relaxed);
+            if (!complete)
+                LOG_ERROR("Cannot write to the append-only log %s: %s, retrying", g_path.c_str(), util::strerror(error).c_str());
+            return complete;
+        }
+
+        void sync(i32 fd)
+        {
+            if (-1 == ::fdatasync(fd))
+            {
+                g_lastWriteOk.store(false, std::memory_order_relaxed);
+                LOG_ERROR("Cannot sync the append-only log %s: %s", g_path.c_str(), util::strerror(errno).c_str());
+            }
+        }
+
+        void appendZSet(buffer::Buffer &out, std::string_view key, zset::ZSet *set)
+        {
+            std::vector<std::string_view> args;
+            std::vector<std::array<char, 32>> scores(K_ZADD_BATCH);
+            zset::ZNode *node = zset::byRank(set, 0);
+            while (node)
+            {
+                args.assign({ "zadd", key });
+                for (size i = 0; node && i < K_ZADD_BATCH; ++i, node = zset::offset(node, 1))
+                {
+                    auto [end, ec] = std::to_chars(scores[i].data(), scores[i].data() + scores[i].size(), node->score);
+                    args.emplace_back(scores[i].data(), static_cast<size>(end - scores[i].data()));
+                    args.push_back(node->name());
+                }
+                protocol::appendRequest(out, args);
+            }
+        }
+
+        // Write the commands rebuilding every live key of every shard to `fd`.
+        // The shards must not change meanwhile.
+        void writeKeyspace(i32 fd)
+        {
+            buffer::Buffer out;
+            u64 now = db::nowMs();
+            for (u32 id = 0; id < shard::count(); ++id)
+            {
+                keyspace::forEach(shard::at(id).db, [&](const Entry *entry) {
+                    const entry::Expiry *expiry = entry->expiry();
+                    if (expiry && expiry->expireAt <= now)
+                        return;
+
+                    char digits[24];
+                    std::string_view expireAt;
+                    if (expiry)
+                    {
+                        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), expiry->expireAt);
+                        expireAt = { digits, static_cast<size>(end - digits) };
+                    }
+
+                    if (entry->type == entry::Type::STRING)
+                    {
+                        if (expiry)
+                            protocol::appendRequest(out, std::array<std::string_view, 5>{ "set", entry->key(), entry->value(), "pxat", expireAt });
+                        else
+                            protocol::appendRequest(out, std::array<std::string_view, 3>{ "set", entry->key(), entry->value() });
+                    }
+                    else
+                    {
+                        appendZSet(out, entry->key(), entry->object<zset::ZSet>());
+                        if (expiry)
+                            protocol::appendRequest(out, std::array<std::string_view, 3>{ "pexpireat", entry->key(), expireAt });
+                    }
+
+                    if (out.size() >= K_WRITE_CHUNK)
+                        writeOut(fd, out);
+                });
+            }
+            writeOut(fd, out);
+        }
+
+        // Write the rewritten log to `path`, synced to disk. Removes it on failure.
+        void writeRewrite(const std::string &path)
+        {
+            i32 fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (-1 == fd)
+                throw exception::errno_exception{ "aof::writeRewrite() -> open()" };
+
+            try
+            {
+                writeKeyspace(fd);
+                if (-1 == ::fsync(fd))
+                    throw exception::errno_exception{ "aof::writeRewrite() -> fsync()" };
+            }
+            catch (...)
+            {
+                ::close(fd);
+                ::unlink(path.c_str());
+                throw;
+            }
+            ::close(fd);
+        }
+
+        i32 openLog(const std::string &path, u64 &size)
+        {
+            i32 fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (-1 == fd)
+                throw exception::errno_exception{ "aof::openLog() -> open()" };
+
+            struct stat info{};
+            if (-1 == ::fstat(fd, &info))
+            {
+                ::close(fd);
+                throw exception::errno_exception{ "aof::openLog() -> fstat()" };
+            }
+            size = static_cast<u64>(info.st_size);
+            return fd;
+        }
+
+        // Background thread: fdatasync(2) once a second under the `everysec` policy,
+        // and reap the rewriting child, waking up the loop of shard 0 to finish the rewrite
+        void backgroundLoop(std::stop_token stop)
+        {
+            auto lastSync = std::chrono::steady_clock::now();
+            std::unique_lock lock{ g_threadMutex };
+            while (!stop.stop_requested())
+            {
+                i32 pid = g_child.load(std::memory_order_acquire);
+                // Woken up early when a rewrite starts
+                g_threadWake.wait_for(lock, stop, pid > 0 ? K_REWRITE_POLL_INTERVAL : K_SYNC_INTERVAL,
+                                      [pid] { return g_child.load(std::memory_order_acquire) != pid; });
+
+                auto now = std::chrono::steady_clock::now();
+                if (g_policy == FsyncPolicy::EVERYSEC && now - lastSync >= K_SYNC_INTERVAL)
+                {
+                    lastSync = now;
+                    if (g_dirty.exchange(false, std::memory_order_acquire))
+                    {
+                        std::lock_guard fdLock{ g_fdMutex };
+                        sync(g_fd);
+                    }
+                }
+
+                pid = g_child.load(std::memory_order_acquire);
+                int status = 0;
+                if (pid > 0 && ::waitpid(pid, &status, WNOHANG) == pid)
+                {
+                    g_childOk.store(WIFEXITED(status) && WEXITSTATUS(status) == 0, std::memory_order_relaxed);
+                    if (!g_childOk.load(std::memory_order_relaxed))
+                        LOG_ERROR("Background rewrite of %s failed (status %d)", g_path.c_str(), status);
+                    g_child.store(0, std::memory_order_release);
+                    shard::at(0).mailbox.wake();
+                }
+            }
+        }
+
+        // Append the commands logged during the rewrite to the new log, and replace the
+        // current log with it. Runs while every loop is stopped.
+        void completeRewrite()
+        {
+            bool ok = g_childOk.load(std::memory_order_relaxed);
+            std::string path = tmpPath();
+
+            i32 fd = -1;
+            if (ok)
+            {
+                try
+                {
+                    // Commands of the current iteration of every loop, into both logs
+                    for (u32 id = 0; id < shard::count(); ++id)
+                        writePending(shard::at(id));
+
+                    fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+                    if (-1 == fd)
+                        throw exception::errno_exception{ "aof::completeRewrite() -> open()" };
+                    for (u32 id = 0; id < shard::count(); ++id)
+                        writeOut(fd, shard::at(id).aofRewriteDiff);
+                    struct stat info{};
+                    if (-1 == ::fdatasync(fd) || -1 == ::fstat(fd, &info))
+                        throw exception::errno_exception{ "aof::completeRewrite() -> fdatasync()" };
+                    if (-1 == ::rename(path.c_str(), g_path.c_str()))
+                        throw exception::errno_exception{ "aof::completeRewrite() -> rename()" };
+
+                    i32 old = -1;
+                    {
+                        std::scoped_lock lock{ g_fdMutex, g_writeMutex };
+                        old = std::exchange(g_fd, fd);
+                        g_size.store(static_cast<u64>(info.st_size), std::memory_order_relaxed);
+                    }
+                    ::close(old);
+                    LOG_INFO("Rewrote the append-only log %s, %llu bytes", g_path.c_str(), static_cast<unsigned long long>(info.st_size));
+                }
+                catch (const std::exception &e)
+                {
+                    ok = false;
+                    if (fd != -1)
+                        ::close(fd);
+                    LOG_ERROR("Background rewrite of %s failed: %s", g_path.c_str(), e.what());
+                }
+            }
+
+            if (!ok)
+                ::unlink(path.c_str());
+
+            for (u32 id = 0; id < shard::count(); ++id)
+                shard::at(id).aofRewriteDiff = buffer::Buffer{};
+            g_lastRewriteOk.store(ok, std::memory_order_relaxed);
+            g_rewriting.store(false, std::memory_order_relaxed);
+        }
+
+        // Run a logged command on the shard owning its key, discarding the reply
+        void replayCommand(const command::Command &command, const protocol::Args &args, output::Queue &replies)
+        {
+            u64 hash = hash::strHash(args[command.firstKey]);
+            command::Context ctx{
+                .shard      = shard::at(shard::ownerOf(hash)),
+                .args       = args,
+                .keyHash    = hash,
+                .out        = replies,
+                .keyHashes  = { &hash, command.keyStep > 0 ? 1u : 0u },
+            };
+            command.handler(ctx);
+            replies.consume(replies.size());
+        }
+    } // namespace
+
+    std::optional<FsyncPolicy> parseFsyncPolicy(std::string_view name) noexcept
+    {
+        if (name == "always")
+            return FsyncPolicy::ALWAYS;
+        if (name == "everysec")
+            return FsyncPolicy::EVERYSEC;
+        if (name == "no")
+            return FsyncPolicy::NO;
+        return std::nullopt;
+    }
+
+    std::string_view policyName(FsyncPolicy policy) noexcept
+    {
+        switch (policy)
+        {
+            case FsyncPolicy::ALWAYS:
+                return "always";
+            case FsyncPolicy::EVERYSEC:
+                return "everysec";
+            case FsyncPolicy::NO:
+                return "no";
+        }
+        return "unknown";
+    }
+
+    bool exists(const std::string &path)
+    {
+        return 0 == ::access(path.c_str(), F_OK);
+    }
+
+    bool replay(const std::string &path)
+    {
+        i32 fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        struct stat info{};
+        if (-1 == fd || -1 == ::fstat(fd, &info))
+        {
+            LOG_ERROR("Cannot open append-only log %s: %s", path.c_str(), util::strerror(errno).c_str());
+            if (fd != -1)
+                ::close(fd);
+            return false;
+        }
+
+        auto fileSize = static_cast<size>(info.st_size);
+        if (fileSize == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void *mapped = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            LOG_ERROR("Cannot map append-only log %s: %s", path.c_str(), util::strerror(errno).c_str());
+            ::close(fd);
+            return false;
+        }
+        ::madvise(mapped, fileSize, MADV_SEQUENTIAL);
+
+        auto start = std::chrono::steady_clock::now();
+        const auto *data = static_cast<const u8 *>(mapped);
+        size pos = 0;
+        u64 commands = 0;
+        bool corrupted = false;
+        protocol::Args args;
+        protocol::Args single;      // One key group of a multi-key command
+        output::Queue replies;      // Discarded
+
+        while (fileSize - pos >= payload::HEADER_LEN)
+        {
+            u32 len = 0;
+            std::memcpy(&len, data + pos, payload::HEADER_LEN);
+            if (len > fileSize - pos - payload::HEADER_LEN)
+                break;
+
+            const command::Command *command = nullptr;
+            if (!protocol::parseRequest(data + pos + payload::HEADER_LEN, len, args) ||
+                args.empty() || !(command = command::lookup(args[0])) || !(command->flags & command::CMD_WRITE) ||
+                command->firstKey <= 0 || !command::checkArity(*command, args.size()))
+            {
+                corrupted = true;
+                break;
+            }
+
+            if (command->keyStep == 0)
+                replayCommand(*command, args, replies);
+            else
+            {
+                // The keys may be owned by different shards now: replay one key at a time
+                for (size i = static_cast<size>(command->firstKey); i < args.size(); i += static_cast<size>(command->keyStep))
+                {
+                    single.clear();
+                    single.push_back(args[0]);
+                    for (size k = 0; k < static_cast<size>(command->keyStep); ++k)
+                        single.push_back(args[i + k]);
+                    replayCommand(*command, single, replies);
+                }
+            }
+
+            pos += payload::HEADER_LEN + len;
+            commands++;
+        }
+        ::munmap(mapped, fileSize);
+
+        if (corrupted)
+        {
+            ::close(fd);
+            LOG_ERROR("Append-only log %s is corrupted at offset %zu", path.c_str(), pos);
+            return false;
+        }
+
+        // A crash in the middle of a write leaves part of the last command behind
+        if (pos < fileSize)
+        {
+            LOG_WARN("Append-only log %s ends with a truncated command, dropping its last %zu bytes", path.c_str(), fileSize - pos);
+            if (-1 == ::ftruncate(fd, static_cast<off_t>(pos)))
+            {
+                LOG_ERROR("Cannot truncate append-only log %s: %s", path.c_str(), util::strerror(errno).c_str());
+                ::close(fd);
+                return false;
+            }
+        }
+        ::close(fd);
+
+        LOG_INFO("Replayed %llu commands from %s in %.1f ms", static_cast<unsigned long long>(commands), path.c_str(), msSince(start));
+        return true;
+    }
+
+    bool start(std::string path, FsyncPolicy policy)
+    {
+        g_path = std::move(path);
+        g_policy = policy;
+
+        try
+        {
+            if (!exists(g_path))
+            {
+                auto begin = std::chrono::steady_clock::now();
+                writeRewrite(tmpPath());
+                if (-1 == ::rename(tmpPath().c_str(), g_path.c_str()))
+                    throw exception::errno_exception{ "aof::start() -> rename()" };
+                LOG_INFO("Created append-only log %s from the keyspace in %.1f ms", g_path.c_str(), msSince(begin));
+            }
+            u64 existing = 0;
+            g_fd = openLog(g_path, existing);
+            g_size.store(existing, std::memory_order_relaxed);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Cannot open append-only log %s: %s", g_path.c_str(), e.what());
+            return false;
+        }
+
+        g_enabled = true;
+        g_thread = std::jthread{ backgroundLoop };
+        LOG_INFO("Logging write commands to %s, fsync %s", g_path.c_str(), policyName(policy).data());
+        return true;
+    }
+
+    void stop()
+    {
+        if (!g_enabled)
+            return;
+
+        g_thread.request_stop();
+        g_threadWake.notify_all();
+        g_thread.join();
+
+        for (u32 id = 0; id < shard::count(); ++id)
+            writePending(shard::at(id));
+        sync(g_fd);
+        ::close(g_fd);
+        g_fd = -1;
+        g_enabled = false;
+    }
+
+    bool enabled() noexcept
+    {
+        return g_enabled;
+    }
+
+    void feed(shard::Shard &shard, const command::Command &command, const protocol::Args &args, u64 keyHash)
+    {
+        buffer::Buffer &out = shard.aofPending;
+
+        bool relativeTtl = command.name == "expire" || command.name == "pexpire" ||
+                           (command.name == "set" && args.size() == 5 && !command::argEquals(args[3], "pxat"));
+        if (!relativeTtl)
+        {
+            protocol::appendRequest(out, args.span());
+            return;
+        }
+
+        // Replaying a relative TTL would restart it: log the absolute time the handler set
+        const Entry *entry = keyspace::lookup(shard.db, keyHash, args[1]);
+        const entry::Expiry *expiry = entry ? entry->expiry() : nullptr;
+        if (!expiry)
+        {
+            // A TTL in the past deleted the key
+            protocol::appendRequest(out, std::array<std::string_view, 2>{ "del", args[1] });
+            return;
+        }
+
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), expiry->expireAt);
+        std::string_view expireAt{ digits, static_cast<size>(end - digits) };
+        if (command.name == "set")
+            protocol::appendRequest(out, std::array<std::string_view, 5>{ "set", args[1], args[2], "pxat", expireAt });
+        else
+            protocol::appendRequest(out, std::array<std::string_view, 3>{ "pexpireat", args[1], expireAt });
+    }
+
+    void flush(shard::Shard &shard)
+    {
+        if (!g_enabled)
+            return;
+
+        // The child was reaped, merge while no loop logs anything. Another thread may be
+        // stopping the world already: try again at the next iteration.
+        if (shard.id == 0 && g_rewriting.load(std::memory_order_relaxed) && g_child.load(std::memory_order_acquire) == 0)
+        {
+            if (!shard::stopTheWorld(shard, completeRewrite))
+                shard.mailbox.wake();
+        }
+
+        if (shard.aofPending.empty())
+            return;
+        if (writePending(shard) && g_policy == FsyncPolicy::ALWAYS)
+            sync(g_fd);
+    }
+
+    void beforeReply(shard::Shard &shard)
+    {
+        if (g_policy != FsyncPolicy::ALWAYS || shard.aofPending.empty())
+            return;
+
+        // Group commit: one write and one sync for every command of the batch
+        if (writePending(shard))
+            sync(g_fd);
+    }
+
+    Result rewriteInBackground(shard::Shard &caller)
+    {
+        if (!g_enabled)
+            return Result::DISABLED;
+
+        Result result = Result::BUSY;
+        shard::stopTheWorld(caller, [&result] {
+            if (g_rewriting.load(std::memory_order_relaxed))
+                return;
+
+            // The child sees every command logged so far. Commands left pending by a
+            // failed write are logged again later: every logged command is idempotent.
+            for (u32 id = 0; id < shard::count(); ++id)
+                writePending(shard::at(id));
+
+            auto start = std::chrono::steady_clock::now();
+            i32 pid = ::fork();
+            if (pid == 0)
+            {
+                // Only this thread exists in the child, which must neither log nor return
+                ::close_range(STDERR_FILENO + 1, ~0U, 0);
+                try
+                {
+                    writeRewrite(tmpPath());
+                    ::_exit(0);
+                }
+                catch (...)
+                {
+                    ::_exit(1);
+                }
+            }
+
+            if (pid < 0)
+            {
+                g_lastRewriteOk.store(false, std::memory_order_relaxed);
+                LOG_ERROR("Background rewrite failed: fork() -> %s", util::strerror(errno).c_str());
+                result = Result::FAILED;
+                return;
+            }
+
+            g_rewriting.store(true, std::memory_order_relaxed);
+            g_child.store(pid, std::memory_order_release);
+            g_threadWake.notify_all();
+            LOG_INFO("Background rewrite of %s started by pid %d, fork took %.1f ms", g_path.c_str(), pid, msSince(start));
+            result = Result::OK;
+        });
+        return result;
+    }
+
+    Status status()
+    {
+        return {
+            .enabled = g_enabled,
+            .policy = g_policy,
+            .rewriteInProgress = g_rewriting.load(std::memory_order_relaxed),
+            .lastWriteOk = g_lastWriteOk.load(std::memory_order_relaxed),
+            .lastRewriteOk = g_lastRewriteOk.load(std::memory_order_relaxed),
+            .size = g_size.load(std::memory_order_relaxed),
+        };
+    }
+} // namespace my_redis::aof
@@ -0,0 +1,179 @@
+#include "avl.hpp"
+
+#include <algorithm>
+
+namespace my_redis::avl
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        void update(AvlNode *node) noexcept
+        {
+            node->height = 1 + std::max(height(node->left), height(node->right));
+            node->count = 1 + count(node->left) + count(node->right);
+        }
+
+        // Returns the node taking the place of `node`
+        AvlNode *rotateLeft(AvlNode *node) noexcept
+        {
+            AvlNode *parent = node->parent;
+            AvlNode *pivot = node->right;
+            AvlNode *inner = pivot->left;
+
+            node->right = inner;
+            if (inner)
+                inner->parent = node;
+
+            pivot->left = node;
+            pivot->parent = parent;
+            node->parent = pivot;
+
+            update(node);
+            update(pivot);
+            return pivot;
+        }
+
+        AvlNode *rotateRight(AvlNode *node) noexcept
+        {
+            AvlNode *parent = node->parent;
+            AvlNode *pivot = node->left;
+            AvlNode *inner = pivot->right;
+
+            node->left = inner;
+            if (inner)
+                inner->parent = node;
+
+            pivot->right = node;
+            pivot->parent = parent;
+            node->parent = pivot;
+
+            update(node);
+            update(pivot);
+            return pivot;
+        }
+
+        // The left subtree is 2 levels taller
+        AvlNode *fixLeft(AvlNode *node) noexcept
+        {
+            if (height(node->left->left) < height(node->left->right))
+                node->left = rotateLeft(node->left);
+            return rotateRight(node);
+        }
+
+        // The right subtree is 2 levels taller
+        AvlNode *fixRight(AvlNode *node) noexcept
+        {
+            if (height(node->right->right) < height(node->right->left))
+                node->right = rotateRight(node->right);
+            return rotateLeft(node);
+        }
+    } // namespace
+
+    AvlNode *fix(AvlNode *node) noexcept
+    {
+        while (true)
+        {
+            // Where the (possibly rotated) subtree has to be attached
+            AvlNode **from = &node;
+            AvlNode *parent = node->parent;
+            if (parent)
+                from = parent->left == node ? &parent->left : &parent->right;
+
+            update(node);
+            u32 l = height(node->left);
+            u32 r = height(node->right);
+            if (l == r + 2)
+                *from = fixLeft(node);
+            else if (l + 2 == r)
+                *from = fixRight(node);
+
+            if (!parent)
+                return *from;
+            node = parent;
+        }
+    }
+
+    AvlNode *remove(AvlNode *node) noexcept
+    {
+        // At most one child: splice the node out
+        if (!node->left || !node->right)
+        {
+            AvlNode *child = node->left ? node->left : node->right;
+            AvlNode *parent = node->parent;
+            if (child)
+                child->parent = parent;
+
+            if (!parent)
+                return child;
+
+            AvlNode **from = parent->left == node ? &parent->left : &parent->right;
+            *from = child;
+            return fix(parent);
+        }
+
+        // Two children: detach the successor, then put it in place of the node
+        AvlNode *successor = node->right;
+        while (successor->left)
+            successor = successor->left;
+
+        AvlNode *root = remove(successor);
+        *successor = *node;
+        if (successor->left)
+            successor->left->parent = successor;
+        if (successor->right)
+            successor->right->parent = successor;
+
+        AvlNode **from = &root;
+        if (AvlNode *parent = node->parent)
+            from = parent->left == node ? &parent->left : &parent->right;
+        *from = successor;
+        return root;
+    }
+
+    AvlNode *offset(AvlNode *node, i64 offset) noexcept
+    {
+        // `pos` is the rank of `node` relative to the starting node
+        i64 pos = 0;
+        while (offset != pos)
+        {
+            if (pos < offset && pos + count(node->right) >= offset)
+            {
+                // The target is inside the right subtree
+                node = node->right;
+                pos += count(node->left) + 1;
+            }
+            else if (pos > offset && pos - count(node->left) <= offset)
+            {
+                // The target is inside the left subtree
+                node = node->left;
+                pos -= count(node->right) + 1;
+            }
+            else
+            {
+                // Go to the parent
+                AvlNode *parent = node->parent;
+                if (!parent)
+                    return nullptr;
+
+                if (parent->right == node)
+                    pos -= count(node->left) + 1;
+                else
+                    pos += count(node->right) + 1;
+                node = parent;
+            }
+        }
+        return node;
+    }
+
+    i64 rank(const AvlNode *node) noexcept
+    {
+        i64 r = count(node->left);
+        for (const AvlNode *parent = node->parent; parent; node = parent, parent = parent->parent)
+        {
+            if (parent->right == node)
+                r += count(parent->left) + 1;
+        }
+        return r;
+    }
+} // namespace my_redis::avl
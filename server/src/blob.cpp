@@ -0,0 +1,65 @@
+#include "blob.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace my_redis::blob
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        // Blobs are freed by whichever thread drops the last reference
+        std::atomic<size> g_allocatedBytes{ 0 };
+    } // namespace
+
+    Blob *allocate(u32 length)
+    {
+        void *mem = std::malloc(sizeof(Blob) + length);
+        if (!mem)
+            throw std::bad_alloc{};
+
+        auto *blob = new (mem) Blob{};
+        blob->refs.store(1, std::memory_order_relaxed);
+        blob->length = length;
+        g_allocatedBytes.fetch_add(sizeof(Blob) + length, std::memory_order_relaxed);
+        return blob;
+    }
+
+    Blob *resize(Blob *blob, u32 length)
+    {
+        u32 previous = blob->length;
+        void *mem = std::realloc(blob, sizeof(Blob) + length);
+        if (!mem)
+            throw std::bad_alloc{};
+
+        auto *resized = static_cast<Blob *>(mem);
+        resized->length = length;
+        g_allocatedBytes.fetch_add(length, std::memory_order_relaxed);
+        g_allocatedBytes.fetch_sub(previous, std::memory_order_relaxed);
+        return resized;
+    }
+
+    Blob *create(std::string_view bytes)
+    {
+        Blob *blob = allocate(static_cast<u32>(bytes.size()));
+        std::memcpy(blob->data(), bytes.data(), bytes.size());
+        return blob;
+    }
+
+    void release(Blob *blob) noexcept
+    {
+        // The last owner must see every access of the others before freeing
+        if (blob->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        g_allocatedBytes.fetch_sub(sizeof(Blob) + blob->length, std::memory_order_relaxed);
+        blob->~Blob();
+        std::free(blob);
+    }
+
+    size allocatedBytes() noexcept
+    {
+        return g_allocatedBytes.load(std::memory_order_relaxed);
+    }
+} // namespace my_redis::blob
@@ -0,0 +1,167 @@
+#include "command.hpp"
+#include "aof.hpp"
+#include "command_handlers.hpp"
+#include "evict.hpp"
+#include "shard.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    using namespace my_redis::types;
+    using namespace my_redis::command;
+
+    // The command registry, new commands plug in here
+    constexpr Command K_COMMANDS[] = {
+        { "get",    2,  CMD_READONLY | CMD_FAST,   1, 0, cmdGet },
+        { "set",    -3, CMD_WRITE | CMD_FAST | CMD_DENYOOM,    1, 0, cmdSet },
+        { "del",    -2, CMD_WRITE | CMD_FAST,      1, 1, cmdDel },
+        { "unlink", -2, CMD_WRITE | CMD_FAST,      1, 1, cmdUnlink },
+        { "mget",   -2, CMD_READONLY | CMD_FAST,   1, 1, cmdMGet },
+        { "mset",   -3, CMD_WRITE | CMD_FAST | CMD_DENYOOM,    1, 2, cmdMSet },
+        { "scan",   -2, CMD_READONLY | CMD_CURSOR,             0, 0, cmdScan },
+
+        { "expire",     3, CMD_WRITE | CMD_FAST,       1, 0, cmdExpire },
+        { "pexpire",    3, CMD_WRITE | CMD_FAST,       1, 0, cmdPexpire },
+        { "pexpireat",  3, CMD_WRITE | CMD_FAST,       1, 0, cmdPexpireAt },
+        { "ttl",        2, CMD_READONLY | CMD_FAST,    1, 0, cmdTtl },
+        { "pttl",       2, CMD_READONLY | CMD_FAST,    1, 0, cmdPttl },
+        { "persist",    2, CMD_WRITE | CMD_FAST,       1, 0, cmdPersist },
+
+        { "zadd",           -4, CMD_WRITE | CMD_FAST | CMD_DENYOOM, 1, 0, cmdZAdd },
+        { "zrem",           -3, CMD_WRITE | CMD_FAST,       1, 0, cmdZRem },
+        { "zscore",         3,  CMD_READONLY | CMD_FAST,    1, 0, cmdZScore },
+        { "zrank",          3,  CMD_READONLY | CMD_FAST,    1, 0, cmdZRank },
+        { "zrange",         -4, CMD_READONLY,               1, 0, cmdZRange },
+        { "zrangebyscore",  -4, CMD_READONLY,               1, 0, cmdZRangeByScore },
+        { "zcount",         4,  CMD_READONLY | CMD_FAST,    1, 0, cmdZCount },
+
+        { "info",           -1, CMD_READONLY, 0, 0, cmdInfo },
+        { "save",           1,  CMD_READONLY, 0, 0, cmdSave },
+        { "bgsave",         1,  CMD_READONLY, 0, 0, cmdBgSave },
+        { "bgrewriteaof",   1,  CMD_READONLY, 0, 0, cmdBgRewriteAof },
+    };
+    constexpr size K_COMMAND_COUNT = std::size(K_COMMANDS);
+    static_assert(K_COMMAND_COUNT <= K_MAX_COMMANDS, "Increase K_MAX_COMMANDS");
+
+    /*
+        * Perfect hash of the command names, built at compile time.
+        * Names are hashed case-insensitively with a seeded FNV-1a, and the first seed
+        * mapping every registered name to a distinct slot is searched by the compiler.
+    */
+    constexpr size K_SLOT_COUNT = 4 * K_MAX_COMMANDS;
+    static_assert((K_SLOT_COUNT & (K_SLOT_COUNT - 1)) == 0, "K_SLOT_COUNT must be a power of 2");
+
+    constexpr char fold(char c) noexcept
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    constexpr u32 nameHash(std::string_view name, u32 seed) noexcept
+    {
+        u32 h = 0x811C9DC5 ^ seed;
+        for (char c : name)
+            h = (h ^ static_cast<u8>(fold(c))) * 0x01000193;
+        return h ^ (h >> 15);
+    }
+
+    constexpr u32 findSeed() noexcept
+    {
+        for (u32 seed = 1; seed < 100000; ++seed)
+        {
+            bool used[K_SLOT_COUNT]{};
+            bool collision = false;
+            for (const Command &command : K_COMMANDS)
+            {
+                auto slot = nameHash(command.name, seed) & (K_SLOT_COUNT - 1);
+                collision |= used[slot];
+                used[slot] = true;
+            }
+            if (!collision)
+                return seed;
+        }
+        return 0;
+    }
+
+    constexpr u32 K_SEED = findSeed();
+    static_assert(K_SEED != 0, "No collision-free seed found, increase K_SLOT_COUNT");
+
+    // Slot -> index into K_COMMANDS, -1 for empty slots
+    constexpr auto K_SLOTS = [] {
+        std::array<i16, K_SLOT_COUNT> slots{};
+        slots.fill(-1);
+        for (size i = 0; i < K_COMMAND_COUNT; ++i)
+            slots[nameHash(K_COMMANDS[i].name, K_SEED) & (K_SLOT_COUNT - 1)] = static_cast<i16>(i);
+        return slots;
+    }();
+
+    constexpr size K_MAX_NAME_LEN = std::ranges::max(K_COMMANDS, {}, [](const Command &c) { return c.name.size(); }).name.size();
+}
+
+namespace my_redis::command
+{
+    const Command *lookup(std::string_view name) noexcept
+    {
+        if (name.size() > K_MAX_NAME_LEN)
+            return nullptr;
+
+        auto index = K_SLOTS[nameHash(name, K_SEED) & (K_SLOT_COUNT - 1)];
+        if (index < 0)
+            return nullptr;
+
+        // The slot only tells which command it can be, confirm the name
+        const Command &command = K_COMMANDS[index];
+        if (!std::ranges::equal(name, command.name, {}, fold))
+            return nullptr;
+
+        return &command;
+    }
+
+    bool checkArity(const Command &command, types::size argc) noexcept
+    {
+        bool counted = command.arity >= 0 ? argc == static_cast<size>(command.arity)
+                                          : argc >= static_cast<size>(-command.arity);
+        return counted && (command.keyStep == 0 || (argc - static_cast<size>(command.firstKey)) % static_cast<size>(command.keyStep) == 0);
+    }
+
+    bool argEquals(std::string_view arg, std::string_view option) noexcept
+    {
+        return std::ranges::equal(arg, option, {}, fold);
+    }
+
+    size indexOf(const Command &command) noexcept
+    {
+        return static_cast<size>(&command - K_COMMANDS);
+    }
+
+    std::span<const Command> all() noexcept
+    {
+        return K_COMMANDS;
+    }
+
+    void execute(const Command &command, Context &ctx)
+    {
+        // Make room before writing, commands that may grow memory are refused when none can be made
+        if ((command.flags & CMD_WRITE) && !evict::beforeWrite(ctx.shard) && (command.flags & CMD_DENYOOM))
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, evict::K_OOM);
+            return;
+        }
+
+        u64 dirty = ctx.shard.dirty;
+        auto start = std::chrono::steady_clock::now();
+        command.handler(ctx);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        ctx.shard.commandStats.latency[indexOf(command)].record(static_cast<u64>(elapsed.count()));
+
+        if (!(command.flags & CMD_WRITE) || ctx.shard.dirty == dirty)
+            return;
+
+        evict::account(ctx.shard);
+        // Only commands that changed the keyspace are logged
+        if (aof::enabled())
+            aof::feed(ctx.shard, command, ctx.args, ctx.keyHash);
+    }
+} // namespace my_redis::command
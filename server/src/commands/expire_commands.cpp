@@ -0,0 +1,99 @@
+#include "command_handlers.hpp"
+
+#include "db.hpp"
+#include "entry.hpp"
+#include "protocol.hpp"
+#include "response.hpp"
+#include "shard.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+
+    // Longest accepted TTL, keeps `now + ttl` far from overflowing
+    constexpr i64 K_MAX_TTL_MS = std::numeric_limits<i64>::max() / 4;
+
+    // EXPIRE/PEXPIRE key ttl, `scale` converts the ttl to milliseconds.
+    // PEXPIREAT key unix-time-milliseconds when not `relative`.
+    void expireGeneric(command::Context &ctx, i64 scale, bool relative = true)
+    {
+        std::optional<i64> ttl = protocol::parseInteger(ctx.args[2]);
+        if (!ttl || *ttl > K_MAX_TTL_MS / scale || *ttl < -K_MAX_TTL_MS / scale)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "value is not an integer or out of range");
+            return;
+        }
+
+        entry::Entry *found = db::lookup(ctx.shard, ctx.keyHash, ctx.args[1]);
+        if (!found)
+        {
+            protocol::appendInteger(ctx.out, 0);
+            return;
+        }
+
+        // A TTL that already elapsed deletes the key
+        i64 expireAt = (relative ? static_cast<i64>(db::nowMs()) : 0) + *ttl * scale;
+        db::expireAt(ctx.shard, found, static_cast<u64>(std::max<i64>(expireAt, 0)));
+        protocol::appendInteger(ctx.out, 1);
+    }
+
+    // TTL/PTTL key: -2 when the key does not exist, -1 when it has no TTL
+    void ttlGeneric(command::Context &ctx, i64 scale)
+    {
+        entry::Entry *found = db::lookup(ctx.shard, ctx.keyHash, ctx.args[1]);
+        if (!found)
+        {
+            protocol::appendInteger(ctx.out, -2);
+            return;
+        }
+
+        const entry::Expiry *expiry = found->expiry();
+        if (!expiry)
+        {
+            protocol::appendInteger(ctx.out, -1);
+            return;
+        }
+
+        // `lookup()` only returns keys that did not expire yet
+        auto remaining = std::max<i64>(static_cast<i64>(expiry->expireAt) - static_cast<i64>(db::nowMs()), 0);
+        protocol::appendInteger(ctx.out, (remaining + scale / 2) / scale);
+    }
+} // namespace
+
+namespace my_redis::command
+{
+    void cmdExpire(Context &ctx)
+    {
+        expireGeneric(ctx, 1000);
+    }
+
+    void cmdPexpire(Context &ctx)
+    {
+        expireGeneric(ctx, 1);
+    }
+
+    void cmdPexpireAt(Context &ctx)
+    {
+        expireGeneric(ctx, 1, false);
+    }
+
+    void cmdTtl(Context &ctx)
+    {
+        ttlGeneric(ctx, 1000);
+    }
+
+    void cmdPttl(Context &ctx)
+    {
+        ttlGeneric(ctx, 1);
+    }
+
+    void cmdPersist(Context &ctx)
+    {
+        entry::Entry *found = db::lookup(ctx.shard, ctx.keyHash, ctx.args[1]);
+        protocol::appendInteger(ctx.out, found && db::persist(ctx.shard, found) ? 1 : 0);
+    }
+} // namespace my_redis::command
@@ -0,0 +1,158 @@
+#include "command_handlers.hpp"
+
+#include "db.hpp"
+#include "entry.hpp"
+#include "protocol.hpp"
+#include "response.hpp"
+#include "shard.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+
+    constexpr size K_DEFAULT_SCAN_COUNT = 10;
+    // Bounds the reply and the work of a single call whatever the client asks for
+    constexpr i64 K_MAX_SCAN_COUNT = 100000;
+
+    // Glob-style matching: `*`, `?`, `[abc]`, `[^a-z]` and `\` to escape
+    bool matchPattern(std::string_view pattern, std::string_view text) noexcept
+    {
+        size p = 0;
+        size t = 0;
+        // Where to resume after the last `*` when the rest fails to match
+        size starP = std::string_view::npos;
+        size starT = 0;
+
+        while (t < text.size())
+        {
+            if (p < pattern.size() && pattern[p] == '*')
+            {
+                starP = ++p;
+                starT = t;
+                continue;
+            }
+
+            bool matched = false;
+            size next = p + 1;
+            if (p < pattern.size())
+            {
+                char c = pattern[p];
+                if (c == '?')
+                    matched = true;
+                else if (c == '[')
+                {
+                    size i = p + 1;
+                    bool negate = i < pattern.size() && pattern[i] == '^';
+                    if (negate)
+                        ++i;
+                    bool inSet = false;
+                    for (; i < pattern.size() && pattern[i] != ']'; ++i)
+                    {
+                        if (pattern[i] == '\\' && i + 1 < pattern.size())
+                            inSet |= pattern[++i] == text[t];
+                        else if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']')
+                        {
+                            inSet |= pattern[i] <= text[t] && text[t] <= pattern[i + 2];
+                            i += 2;
+                        }
+                        else
+                            inSet |= pattern[i] == text[t];
+                    }
+                    matched = inSet != negate;
+                    next = i < pattern.size() ? i + 1 : i;
+                }
+                else if (c == '\\' && p + 1 < pattern.size())
+                {
+                    matched = pattern[p + 1] == text[t];
+                    next = p + 2;
+                }
+                else
+                    matched = c == text[t];
+            }
+
+            if (matched)
+            {
+                p = next;
+                ++t;
+            }
+            else if (starP != std::string_view::npos)
+            {
+                p = starP;
+                t = ++starT;
+            }
+            else
+                return false;
+        }
+
+        while (p < pattern.size() && pattern[p] == '*')
+            ++p;
+        return p == pattern.size();
+    }
+} // namespace
+
+namespace my_redis::command
+{
+    // SCAN cursor [MATCH pattern] [COUNT count]: an array of the next cursor, then keys.
+    // Every key present for the whole scan is returned at least once, some may be returned
+    // more than once. Each call runs on the shard the cursor points to, see db::scan().
+    void cmdScan(Context &ctx)
+    {
+        std::optional<u64> cursor = db::parseCursor(ctx.args[1]);
+        if (!cursor || db::cursorShard(*cursor) != ctx.shard.id)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "invalid cursor");
+            return;
+        }
+
+        std::string_view pattern = "*";
+        size count = K_DEFAULT_SCAN_COUNT;
+        for (size i = 2; i < ctx.args.size(); i += 2)
+        {
+            if (i + 1 >= ctx.args.size())
+            {
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "syntax error");
+                return;
+            }
+            if (argEquals(ctx.args[i], "match"))
+                pattern = ctx.args[i + 1];
+            else if (argEquals(ctx.args[i], "count"))
+            {
+                std::optional<i64> n = protocol::parseInteger(ctx.args[i + 1]);
+                if (!n || *n < 1)
+                {
+                    protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "value is not an integer or out of range");
+                    return;
+                }
+                count = static_cast<size>(std::min(*n, K_MAX_SCAN_COUNT));
+            }
+            else
+            {
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "syntax error");
+                return;
+            }
+        }
+
+        std::vector<entry::Entry *> entries;
+        u64 next = db::scan(ctx.shard, *cursor, count, entries);
+
+        protocol::ArrayWriter array{ ctx.out };
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), next);
+        array.add(std::string_view{ digits, static_cast<size>(end - digits) });
+
+        bool matchAll = pattern == "*";
+        for (entry::Entry *entry : entries)
+        {
+            if (matchAll || matchPattern(pattern, entry->key()))
+                array.add(entry->key());
+        }
+        array.finish();
+    }
+} // namespace my_redis::command
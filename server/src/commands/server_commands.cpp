@@ -0,0 +1,215 @@
+#include "command_handlers.hpp"
+
+#include "aof.hpp"
+#include "evict.hpp"
+#include "lazyfree.hpp"
+#include "protocol.hpp"
+#include "response.hpp"
+#include "shard.hpp"
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+
+    void appendf(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    void appendf(std::string &out, const char *format, ...)
+    {
+        char line[512];
+        va_list args;
+        va_start(args, format);
+        auto n = std::vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        if (n > 0)
+            out.append(line, std::min(static_cast<size>(n), sizeof(line) - 1));
+    }
+
+    // Shards with a pending reset are reported as empty until their loop clears them
+    bool readable(const shard::Shard &shard) noexcept
+    {
+        return !shard.statsResetPending.load(std::memory_order_acquire);
+    }
+
+    void appendDistribution(std::string &out, const char *name, const stats::Summary &summary)
+    {
+        appendf(out, "%s:avg=%.2f,p50=%llu,p99=%llu,max=%llu\r\n", name, summary.mean(),
+                static_cast<unsigned long long>(summary.percentile(0.50)),
+                static_cast<unsigned long long>(summary.percentile(0.99)),
+                static_cast<unsigned long long>(summary.max));
+    }
+
+    void appendLoop(std::string &out)
+    {
+        u64 wakeups = 0, bytesIn = 0, bytesOut = 0;
+        stats::Summary ready, pipeline;
+        for (u32 id = 0; id < shard::count(); ++id)
+        {
+            const shard::Shard &shard = shard::at(id);
+            if (!readable(shard))
+                continue;
+
+            wakeups += shard.loopStats.wakeups.value();
+            bytesIn += shard.loopStats.bytesIn.value();
+            bytesOut += shard.loopStats.bytesOut.value();
+            ready.add(shard.loopStats.readyPerWakeup);
+            pipeline.add(shard.loopStats.pipelineDepth);
+        }
+
+        appendf(out, "# Loop\r\n");
+        appendf(out, "threads:%u\r\n", shard::count());
+        appendf(out, "wakeups:%llu\r\n", static_cast<unsigned long long>(wakeups));
+        appendDistribution(out, "ready_per_wakeup", ready);
+        appendDistribution(out, "pipeline_depth", pipeline);
+        appendf(out, "bytes_in:%llu\r\n", static_cast<unsigned long long>(bytesIn));
+        appendf(out, "bytes_out:%llu\r\n", static_cast<unsigned long long>(bytesOut));
+    }
+
+    void appendCommandStats(std::string &out)
+    {
+        appendf(out, "# Commandstats\r\n");
+        for (const command::Command &command : command::all())
+        {
+            stats::Summary latency;
+            for (u32 id = 0; id < shard::count(); ++id)
+            {
+                const shard::Shard &shard = shard::at(id);
+                if (readable(shard))
+                    latency.add(shard.commandStats.latency[command::indexOf(command)]);
+            }
+            if (latency.count == 0)
+                continue;
+
+            // Nanoseconds reported as microseconds
+            appendf(out, "cmdstat_%.*s:calls=%llu,usec_per_call=%.2f,p50_usec=%.2f,p99_usec=%.2f,p999_usec=%.2f,max_usec=%.2f\r\n",
+                    static_cast<int>(command.name.size()), command.name.data(),
+                    static_cast<unsigned long long>(latency.count), latency.mean() / 1000,
+                    latency.percentile(0.50) / 1000.0, latency.percentile(0.99) / 1000.0,
+                    latency.percentile(0.999) / 1000.0, latency.max / 1000.0);
+        }
+    }
+
+    void appendPersistence(std::string &out)
+    {
+        snapshot::Status status = snapshot::status();
+        appendf(out, "# Persistence\r\n");
+        appendf(out, "snapshot_path:%s\r\n", snapshot::path().c_str());
+        appendf(out, "bgsave_in_progress:%d\r\n", status.inProgress ? 1 : 0);
+        appendf(out, "last_save_status:%s\r\n", status.lastSaveOk ? "ok" : "err");
+        appendf(out, "last_save_time:%llu\r\n", static_cast<unsigned long long>(status.lastSaveAt / 1000));
+
+        aof::Status log = aof::status();
+        appendf(out, "aof_enabled:%d\r\n", log.enabled ? 1 : 0);
+        if (!log.enabled)
+            return;
+        std::string_view policy = aof::policyName(log.policy);
+        appendf(out, "aof_fsync:%.*s\r\n", static_cast<int>(policy.size()), policy.data());
+        appendf(out, "aof_size:%llu\r\n", static_cast<unsigned long long>(log.size));
+        appendf(out, "aof_rewrite_in_progress:%d\r\n", log.rewriteInProgress ? 1 : 0);
+        appendf(out, "aof_last_write_status:%s\r\n", log.lastWriteOk ? "ok" : "err");
+        appendf(out, "aof_last_rewrite_status:%s\r\n", log.lastRewriteOk ? "ok" : "err");
+    }
+
+    void appendMemory(std::string &out)
+    {
+        evict::Status status = evict::status();
+        std::string_view policy = evict::policyName(status.policy);
+        appendf(out, "# Memory\r\n");
+        appendf(out, "used_memory:%zu\r\n", status.usedMemory);
+        appendf(out, "maxmemory:%zu\r\n", status.maxMemory);
+        appendf(out, "maxmemory_policy:%.*s\r\n", static_cast<int>(policy.size()), policy.data());
+        appendf(out, "evicted_keys:%llu\r\n", static_cast<unsigned long long>(status.evictedKeys));
+
+        lazyfree::Status lazy = lazyfree::status();
+        appendf(out, "lazyfree_pending_objects:%llu\r\n", static_cast<unsigned long long>(lazy.pending));
+        appendf(out, "lazyfreed_objects:%llu\r\n", static_cast<unsigned long long>(lazy.freed));
+    }
+
+    void appendSaveResult(buffer::Buffer &out, snapshot::Result result, std::string_view done)
+    {
+        switch (result)
+        {
+            case snapshot::Result::OK:
+                protocol::appendResponse(out, Response::Status::RES_OK, done);
+                break;
+            case snapshot::Result::BUSY:
+                protocol::appendResponse(out, Response::Status::RES_ERR, "a save is already in progress");
+                break;
+            case snapshot::Result::FAILED:
+                protocol::appendResponse(out, Response::Status::RES_ERR, "save failed, see the server log");
+                break;
+        }
+    }
+} // namespace
+
+namespace my_redis::command
+{
+    // INFO [loop | commandstats | memory | persistence | reset]
+    void cmdInfo(Context &ctx)
+    {
+        std::string_view section = ctx.args.size() > 1 ? ctx.args[1] : std::string_view{ "all" };
+        bool all = argEquals(section, "all");
+
+        if (argEquals(section, "reset"))
+        {
+            shard::requestStatsReset();
+            protocol::appendResponse(ctx.out, Response::Status::RES_OK);
+            return;
+        }
+
+        std::string info;
+        if (all || argEquals(section, "loop"))
+            appendLoop(info);
+        if (all || argEquals(section, "commandstats"))
+            appendCommandStats(info);
+        if (all || argEquals(section, "memory"))
+            appendMemory(info);
+        if (all || argEquals(section, "persistence"))
+            appendPersistence(info);
+
+        if (info.empty())
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "unknown INFO section");
+            return;
+        }
+        protocol::appendResponse(ctx.out, Response::Status::RES_OK, info);
+    }
+
+    // SAVE: every loop waits until the snapshot is on disk
+    void cmdSave(Context &ctx)
+    {
+        appendSaveResult(ctx.out, snapshot::save(ctx.shard), {});
+    }
+
+    // BGSAVE: a forked child writes the snapshot, the loops only wait for the fork
+    void cmdBgSave(Context &ctx)
+    {
+        appendSaveResult(ctx.out, snapshot::saveInBackground(ctx.shard), "Background saving started");
+    }
+
+    // BGREWRITEAOF: a forked child compacts the append-only log from the keyspace
+    void cmdBgRewriteAof(Context &ctx)
+    {
+        switch (aof::rewriteInBackground(ctx.shard))
+        {
+            case aof::Result::OK:
+                protocol::appendResponse(ctx.out, Response::Status::RES_OK, "Background append only file rewriting started");
+                break;
+            case aof::Result::BUSY:
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "a rewrite is already in progress");
+                break;
+            case aof::Result::DISABLED:
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "the append-only log is disabled");
+                break;
+            case aof::Result::FAILED:
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "rewrite failed, see the server log");
+                break;
+        }
+    }
+} // namespace my_redis::command
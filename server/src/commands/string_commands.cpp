@@ -0,0 +1,126 @@
+#include "command_handlers.hpp"
+
+#include "db.hpp"
+#include "entry.hpp"
+#include "protocol.hpp"
+#include "response.hpp"
+#include "shard.hpp"
+
+#include <limits>
+#include <optional>
+
+namespace my_redis::command
+{
+    using namespace my_redis::types;
+
+    void cmdGet(Context &ctx)
+    {
+        // Lookup the entry in the keyspace
+        entry::Entry *found = db::lookup(ctx.shard, ctx.keyHash, ctx.args[1]);
+        // Not found
+        if (!found)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_NX);
+            return;
+        }
+        if (found->type != entry::Type::STRING)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+        // Found: large values are queued by reference instead of being copied
+        if (blob::Blob *shared = found->blob())
+        {
+            protocol::appendResponseHeader(ctx.out, Response::Status::RES_OK, shared->length);
+            ctx.out.append(blob::Ref{ shared });
+            return;
+        }
+        protocol::appendResponse(ctx.out, Response::Status::RES_OK, found->value());
+    }
+
+    // SET key value [EX seconds | PX milliseconds | PXAT unix-time-milliseconds]
+    void cmdSet(Context &ctx)
+    {
+        u64 expireAt = 0;
+        if (ctx.args.size() != 3)
+        {
+            bool seconds = argEquals(ctx.args[3], "ex");
+            bool absolute = argEquals(ctx.args[3], "pxat");
+            if (ctx.args.size() != 5 || (!seconds && !absolute && !argEquals(ctx.args[3], "px")))
+            {
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "syntax error");
+                return;
+            }
+
+            // Same bound as Redis: the TTL in seconds must fit in 32 bits.
+            // PXAT is what the append-only log records, it may already be in the past.
+            i64 scale = seconds ? 1000 : 1;
+            i64 limit = absolute ? std::numeric_limits<i64>::max() / 4 : std::numeric_limits<i32>::max() * 1000LL / scale;
+            std::optional<i64> ttl = protocol::parseInteger(ctx.args[4]);
+            if (!ttl || *ttl <= 0 || *ttl > limit)
+            {
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "invalid expire time in 'set' command");
+                return;
+            }
+            expireAt = absolute ? static_cast<u64>(*ttl) : db::nowMs() + static_cast<u64>(*ttl * scale);
+        }
+
+        // A value streamed into a blob is stored as is
+        blob::Blob *shared = ctx.argBlob && ctx.argBlob->data() == ctx.args[2].data() ? ctx.argBlob : nullptr;
+        db::set(ctx.shard, ctx.keyHash, ctx.args[1], ctx.args[2], expireAt, shared);
+        protocol::appendResponse(ctx.out, Response::Status::RES_OK);
+    }
+
+    // DEL key [key ...]: replies the number of keys that existed
+    void cmdDel(Context &ctx)
+    {
+        i64 deleted = 0;
+        for (size i = 0; i < ctx.keyHashes.size(); ++i)
+        {
+            db::prefetchAhead(ctx.shard, ctx.keyHashes, i);
+            deleted += db::erase(ctx.shard, ctx.keyHashes[i], ctx.args[1 + i]);
+        }
+        protocol::appendInteger(ctx.out, deleted);
+    }
+
+    // UNLINK key [key ...]: DEL, but the values costly to free are freed in the background
+    void cmdUnlink(Context &ctx)
+    {
+        i64 unlinked = 0;
+        for (size i = 0; i < ctx.keyHashes.size(); ++i)
+        {
+            db::prefetchAhead(ctx.shard, ctx.keyHashes, i);
+            unlinked += db::unlink(ctx.shard, ctx.keyHashes[i], ctx.args[1 + i]);
+        }
+        protocol::appendInteger(ctx.out, unlinked);
+    }
+
+    // MGET key [key ...]: an array with the value of every key, nil for missing keys and
+    // keys of another type. Values are copied even when shared as blobs, so that the
+    // parts of a batch spread over several shards can be merged.
+    void cmdMGet(Context &ctx)
+    {
+        protocol::ArrayWriter array{ ctx.out };
+        for (size i = 0; i < ctx.keyHashes.size(); ++i)
+        {
+            db::prefetchAhead(ctx.shard, ctx.keyHashes, i);
+            entry::Entry *found = db::lookup(ctx.shard, ctx.keyHashes[i], ctx.args[1 + i]);
+            if (found && found->type == entry::Type::STRING)
+                array.add(found->value());
+            else
+                array.addNil();
+        }
+        array.finish();
+    }
+
+    // MSET key value [key value ...]
+    void cmdMSet(Context &ctx)
+    {
+        for (size i = 0; i < ctx.keyHashes.size(); ++i)
+        {
+            db::prefetchAhead(ctx.shard, ctx.keyHashes, i);
+            db::set(ctx.shard, ctx.keyHashes[i], ctx.args[1 + 2 * i], ctx.args[2 + 2 * i]);
+        }
+        protocol::appendResponse(ctx.out, Response::Status::RES_OK);
+    }
+} // namespace my_redis::command
@@ -0,0 +1,321 @@
+#include "command_handlers.hpp"
+
+#include "db.hpp"
+#include "entry.hpp"
+#include "protocol.hpp"
+#include "response.hpp"
+#include "shard.hpp"
+#include "zset.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis;
+    using namespace my_redis::types;
+
+    constexpr std::string_view K_NOT_A_FLOAT = "value is not a valid float";
+    constexpr std::string_view K_NOT_AN_INTEGER = "value is not an integer or out of range";
+
+    // The sorted set stored at the key, nullptr when the key does not exist.
+    // Sets `wrongType` when the key holds another type.
+    zset::ZSet *findZSet(command::Context &ctx, bool &wrongType)
+    {
+        entry::Entry *found = db::lookup(ctx.shard, ctx.keyHash, ctx.args[1]);
+        wrongType = found && found->type != entry::Type::ZSET;
+        return found && !wrongType ? found->object<zset::ZSet>() : nullptr;
+    }
+
+    // Min/max of a score range: a number, "-inf"/"+inf", and "(" for an exclusive bound
+    struct ScoreBound
+    {
+        double value;
+        bool exclusive;
+    };
+
+    std::optional<ScoreBound> parseBound(std::string_view arg) noexcept
+    {
+        bool exclusive = !arg.empty() && arg.front() == '(';
+        if (exclusive)
+            arg.remove_prefix(1);
+
+        std::optional<double> value = protocol::parseDouble(arg);
+        if (!value)
+            return std::nullopt;
+        return ScoreBound{ *value, exclusive };
+    }
+
+    // First node inside the range starting at `min`
+    zset::ZNode *rangeStart(zset::ZSet *zset, const ScoreBound &min) noexcept
+    {
+        return min.exclusive ? zset::seekGt(zset, min.value) : zset::seekGe(zset, min.value, {});
+    }
+
+    // First node past the range ending at `max`
+    zset::ZNode *rangeEnd(zset::ZSet *zset, const ScoreBound &max) noexcept
+    {
+        return max.exclusive ? zset::seekGe(zset, max.value, {}) : zset::seekGt(zset, max.value);
+    }
+
+    bool beforeEnd(const zset::ZNode *node, const ScoreBound &max) noexcept
+    {
+        return max.exclusive ? node->score < max.value : node->score <= max.value;
+    }
+
+    void addMember(protocol::ArrayWriter &writer, const zset::ZNode *node, bool withScores)
+    {
+        writer.add(node->name());
+        if (withScores)
+            writer.add(node->score);
+    }
+} // namespace
+
+namespace my_redis::command
+{
+    // ZADD key score member [score member ...]
+    void cmdZAdd(Context &ctx)
+    {
+        if (ctx.args.size() % 2 != 0)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "syntax error");
+            return;
+        }
+
+        // Validate every score before touching the set
+        std::vector<double> scores;
+        scores.reserve((ctx.args.size() - 2) / 2);
+        for (size i = 2; i < ctx.args.size(); i += 2)
+        {
+            std::optional<double> score = protocol::parseDouble(ctx.args[i]);
+            if (!score)
+            {
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, K_NOT_A_FLOAT);
+                return;
+            }
+            scores.push_back(*score);
+        }
+
+        bool wrongType = false;
+        zset::ZSet *zset = findZSet(ctx, wrongType);
+        if (wrongType)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+
+        if (!zset)
+        {
+            auto created = std::make_unique<zset::ZSet>();
+            db::insertObject(ctx.shard, ctx.keyHash, ctx.args[1], entry::Type::ZSET, created.get());
+            zset = created.release();
+        }
+
+        size bytes = zset::memoryBytes(zset);
+        i64 added = 0;
+        for (size i = 2; i < ctx.args.size(); i += 2)
+            added += zset::insert(zset, ctx.args[i + 1], scores[(i - 2) / 2]);
+        ctx.shard.objectBytes += zset::memoryBytes(zset) - bytes;
+        // Scores of existing members may have changed as well
+        ctx.shard.dirty += (ctx.args.size() - 2) / 2;
+        protocol::appendInteger(ctx.out, added);
+    }
+
+    // ZREM key member [member ...]
+    void cmdZRem(Context &ctx)
+    {
+        bool wrongType = false;
+        zset::ZSet *zset = findZSet(ctx, wrongType);
+        if (wrongType)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+
+        i64 removed = 0;
+        if (zset)
+        {
+            size bytes = zset::memoryBytes(zset);
+            for (size i = 2; i < ctx.args.size(); ++i)
+                removed += zset::remove(zset, ctx.args[i]);
+            ctx.shard.objectBytes -= bytes - zset::memoryBytes(zset);
+        }
+        ctx.shard.dirty += static_cast<u64>(removed);
+
+        // Empty sets are deleted
+        if (zset && zset::length(zset) == 0)
+            db::erase(ctx.shard, ctx.keyHash, ctx.args[1]);
+
+        protocol::appendInteger(ctx.out, removed);
+    }
+
+    // ZSCORE key member
+    void cmdZScore(Context &ctx)
+    {
+        bool wrongType = false;
+        zset::ZSet *zset = findZSet(ctx, wrongType);
+        if (wrongType)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+
+        zset::ZNode *node = zset ? zset::lookup(zset, ctx.args[2]) : nullptr;
+        if (!node)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_NX);
+            return;
+        }
+        protocol::appendDouble(ctx.out, node->score);
+    }
+
+    // ZRANK key member
+    void cmdZRank(Context &ctx)
+    {
+        bool wrongType = false;
+        zset::ZSet *zset = findZSet(ctx, wrongType);
+        if (wrongType)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+
+        zset::ZNode *node = zset ? zset::lookup(zset, ctx.args[2]) : nullptr;
+        if (!node)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_NX);
+            return;
+        }
+        protocol::appendInteger(ctx.out, zset::rank(node));
+    }
+
+    // ZRANGE key start stop [WITHSCORES], by rank. Negative ranks count from the end.
+    void cmdZRange(Context &ctx)
+    {
+        std::optional<i64> start = protocol::parseInteger(ctx.args[2]);
+        std::optional<i64> stop = protocol::parseInteger(ctx.args[3]);
+        if (!start || !stop)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, K_NOT_AN_INTEGER);
+            return;
+        }
+
+        bool withScores = ctx.args.size() == 5 && argEquals(ctx.args[4], "withscores");
+        if (ctx.args.size() > 5 || (ctx.args.size() == 5 && !withScores))
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "syntax error");
+            return;
+        }
+
+        bool wrongType = false;
+        zset::ZSet *zset = findZSet(ctx, wrongType);
+        if (wrongType)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+
+        protocol::ArrayWriter writer{ ctx.out };
+        auto length = zset ? static_cast<i64>(zset::length(zset)) : 0;
+        i64 first = *start < 0 ? std::max<i64>(*start + length, 0) : *start;
+        i64 last = *stop < 0 ? *stop + length : std::min<i64>(*stop, length - 1);
+
+        // Seek the first rank in O(log n), then walk in order
+        zset::ZNode *node = first <= last ? zset::byRank(zset, first) : nullptr;
+        for (i64 rank = first; node && rank <= last; ++rank, node = zset::offset(node, 1))
+            addMember(writer, node, withScores);
+        writer.finish();
+    }
+
+    // ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+    void cmdZRangeByScore(Context &ctx)
+    {
+        std::optional<ScoreBound> min = parseBound(ctx.args[2]);
+        std::optional<ScoreBound> max = parseBound(ctx.args[3]);
+        if (!min || !max)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "min or max is not a float");
+            return;
+        }
+
+        bool withScores = false;
+        i64 offset = 0;
+        i64 limit = -1;     // Negative: no limit
+        for (size i = 4; i < ctx.args.size(); ++i)
+        {
+            if (argEquals(ctx.args[i], "withscores"))
+                withScores = true;
+            else if (argEquals(ctx.args[i], "limit") && i + 2 < ctx.args.size())
+            {
+                std::optional<i64> parsedOffset = protocol::parseInteger(ctx.args[i + 1]);
+                std::optional<i64> parsedLimit = protocol::parseInteger(ctx.args[i + 2]);
+                if (!parsedOffset || !parsedLimit)
+                {
+                    protocol::appendResponse(ctx.out, Response::Status::RES_ERR, K_NOT_AN_INTEGER);
+                    return;
+                }
+                offset = *parsedOffset;
+                limit = *parsedLimit;
+                i += 2;
+            }
+            else
+            {
+                protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "syntax error");
+                return;
+            }
+        }
+
+        bool wrongType = false;
+        zset::ZSet *zset = findZSet(ctx, wrongType);
+        if (wrongType)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+
+        protocol::ArrayWriter writer{ ctx.out };
+        zset::ZNode *node = zset && offset >= 0 ? rangeStart(zset, *min) : nullptr;
+        // Skipping `offset` nodes is O(log n) thanks to the subtree sizes
+        if (node && offset > 0)
+            node = zset::offset(node, offset);
+
+        for (; node && limit != 0 && beforeEnd(node, *max); node = zset::offset(node, 1), --limit)
+            addMember(writer, node, withScores);
+        writer.finish();
+    }
+
+    // ZCOUNT key min max, in O(log n) from the ranks of the range bounds
+    void cmdZCount(Context &ctx)
+    {
+        std::optional<ScoreBound> min = parseBound(ctx.args[2]);
+        std::optional<ScoreBound> max = parseBound(ctx.args[3]);
+        if (!min || !max)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, "min or max is not a float");
+            return;
+        }
+
+        bool wrongType = false;
+        zset::ZSet *zset = findZSet(ctx, wrongType);
+        if (wrongType)
+        {
+            protocol::appendResponse(ctx.out, Response::Status::RES_ERR, db::K_WRONGTYPE);
+            return;
+        }
+
+        if (!zset)
+        {
+            protocol::appendInteger(ctx.out, 0);
+            return;
+        }
+
+        auto length = static_cast<i64>(zset::length(zset));
+        zset::ZNode *first = rangeStart(zset, *min);
+        zset::ZNode *end = rangeEnd(zset, *max);
+        i64 firstRank = first ? zset::rank(first) : length;
+        i64 endRank = end ? zset::rank(end) : length;
+        protocol::appendInteger(ctx.out, std::max<i64>(endRank - firstRank, 0));
+    }
+} // namespace my_redis::command
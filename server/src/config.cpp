@@ -0,0 +1,263 @@
+#include "config.hpp"
+
+#include "blob.hpp"
+
+#include <arpa/inet.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+#include <string_view>
+
+namespace my_redis::config
+{
+    constexpr int K_MAX_THREADS = 256;
+    // Below this, plain requests of a few large arguments would no longer fit
+    constexpr types::size K_MIN_BUFFER_LIMIT = 64 * 1024;
+
+    namespace
+    {
+        // A decimal integer in [0, max]
+        std::optional<types::u64> parseUnsigned(const char *text, types::u64 max)
+        {
+            char *end = nullptr;
+            errno = 0;
+            auto value = std::strtoull(text, &end, 10);
+            if (*text == '\0' || *text == '-' || *end != '\0' || errno == ERANGE || value > max)
+                return std::nullopt;
+            return value;
+        }
+    } // namespace
+
+    std::optional<Config> parseArgs(int argc, char *argv[])
+    {
+        Config config{};
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view arg{ argv[i] };
+
+            // Every option takes exactly one value
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "> Missing value for option '%s'\n", argv[i]);
+                return std::nullopt;
+            }
+            std::string_view value{ argv[++i] };
+
+            if (arg == "--engine")
+            {
+                auto engine = event::EventLoop::parseEngine(value);
+                if (!engine)
+                {
+                    std::fprintf(stderr, "> Unknown engine '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.engine = *engine;
+            }
+            else if (arg == "--poller")
+            {
+                auto backend = event::EventPoller::parseBackend(value);
+                if (!backend)
+                {
+                    std::fprintf(stderr, "> Unknown poller '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.poller = *backend;
+            }
+            else if (arg == "--bind")
+            {
+                in_addr addr{};
+                if (1 != ::inet_pton(AF_INET, argv[i], &addr))
+                {
+                    std::fprintf(stderr, "> Invalid bind address '%s', expected an IPv4 address\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.endpoint.ip = argv[i];
+            }
+            else if (arg == "--port")
+            {
+                auto port = parseUnsigned(argv[i], std::numeric_limits<types::u16>::max());
+                if (!port)
+                {
+                    std::fprintf(stderr, "> Invalid port '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.endpoint.port = static_cast<types::u16>(*port);
+            }
+            else if (arg == "--unixsocket")
+            {
+                if (value.empty() || value.size() >= sizeof(sockaddr_un::sun_path))
+                {
+                    std::fprintf(stderr, "> Invalid unix socket path '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.unixSocket = value;
+            }
+            else if (arg == "--tcp-nodelay")
+            {
+                if (value != "yes" && value != "no")
+                {
+                    std::fprintf(stderr, "> Invalid TCP_NODELAY setting '%s', expected yes or no\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.listenOptions.noDelay = value == "yes";
+            }
+            else if (arg == "--tcp-defer-accept" || arg == "--busy-poll" || arg == "--socket-rcvbuf" || arg == "--socket-sndbuf")
+            {
+                auto number = parseUnsigned(argv[i], std::numeric_limits<types::i32>::max());
+                if (!number)
+                {
+                    std::fprintf(stderr, "> Invalid value '%s' of option '%s'\n", argv[i], argv[i - 1]);
+                    return std::nullopt;
+                }
+
+                auto &options = config.listenOptions;
+                auto &field = arg == "--tcp-defer-accept" ? options.deferAcceptSecs
+                            : arg == "--busy-poll"        ? options.busyPollUsecs
+                            : arg == "--socket-rcvbuf"    ? options.recvBuffer
+                                                          : options.sendBuffer;
+                field = static_cast<types::i32>(*number);
+            }
+            else if (arg == "--threads")
+            {
+                auto threads = parseUnsigned(argv[i], K_MAX_THREADS);
+                if (!threads || *threads < 1)
+                {
+                    std::fprintf(stderr, "> Invalid thread count '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.threads = static_cast<types::u32>(*threads);
+            }
+            else if (arg == "--log-level")
+            {
+                auto level = log::parseLevel(value);
+                if (!level)
+                {
+                    std::fprintf(stderr, "> Unknown log level '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.logLevel = *level;
+            }
+            else if (arg == "--snapshot")
+            {
+                if (value.empty())
+                {
+                    std::fprintf(stderr, "> Invalid snapshot path '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.snapshotPath = value;
+            }
+            else if (arg == "--aof")
+            {
+                if (value.empty())
+                {
+                    std::fprintf(stderr, "> Invalid append-only log path '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.aofPath = value;
+            }
+            else if (arg == "--aof-fsync")
+            {
+                auto policy = aof::parseFsyncPolicy(value);
+                if (!policy)
+                {
+                    std::fprintf(stderr, "> Unknown fsync policy '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.aofFsync = *policy;
+            }
+            else if (arg == "--conn-buffer-limit")
+            {
+                auto bytes = parseUnsigned(argv[i], std::numeric_limits<types::size>::max());
+                if (!bytes || *bytes < K_MIN_BUFFER_LIMIT)
+                {
+                    std::fprintf(stderr, "> Invalid connection buffer limit '%s', at least %zu bytes\n", argv[i], K_MIN_BUFFER_LIMIT);
+                    return std::nullopt;
+                }
+                config.bufferLimit = static_cast<types::size>(*bytes);
+            }
+            else if (arg == "--max-value-size")
+            {
+                auto bytes = parseUnsigned(argv[i], std::numeric_limits<types::u32>::max());
+                if (!bytes || *bytes < blob::K_MIN_SIZE)
+                {
+                    std::fprintf(stderr, "> Invalid value size limit '%s', at least %zu bytes\n", argv[i], blob::K_MIN_SIZE);
+                    return std::nullopt;
+                }
+                config.maxValueSize = static_cast<types::size>(*bytes);
+            }
+            else if (arg == "--maxmemory")
+            {
+                auto bytes = parseUnsigned(argv[i], std::numeric_limits<types::size>::max());
+                if (!bytes)
+                {
+                    std::fprintf(stderr, "> Invalid memory limit '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.maxMemory = static_cast<types::size>(*bytes);
+            }
+            else if (arg == "--maxmemory-policy")
+            {
+                auto policy = evict::parsePolicy(value);
+                if (!policy)
+                {
+                    std::fprintf(stderr, "> Unknown eviction policy '%s'\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.maxMemoryPolicy = *policy;
+            }
+            else if (arg == "--lazyfree")
+            {
+                if (value != "yes" && value != "no")
+                {
+                    std::fprintf(stderr, "> Invalid lazy free setting '%s', expected yes or no\n", argv[i]);
+                    return std::nullopt;
+                }
+                config.lazyFree = value == "yes";
+            }
+            else
+            {
+                std::fprintf(stderr, "> Unknown option '%s'\n", argv[i - 1]);
+                return std::nullopt;
+            }
+        }
+
+        if (config.endpoint.port == 0 && config.unixSocket.empty())
+        {
+            std::fprintf(stderr, "> No listener, the TCP port is 0 and no unix socket is set\n");
+            return std::nullopt;
+        }
+
+        return config;
+    }
+
+    void printUsage(const char *program)
+    {
+        std::fprintf(stderr, "Usage:\n"
+                             "  %s [options]\n"
+                             "Options:\n"
+                             "  --bind <ip>                      IPv4 address of the TCP listener (default: 127.0.0.1)\n"
+                             "  --port <port>                    Port of the TCP listener, 0 for none (default: 9999)\n"
+                             "  --unixsocket <path>              Also listen on a unix domain socket at this path\n"
+                             "  --tcp-nodelay <yes|no>           Disable Nagle's algorithm on TCP connections (default: yes)\n"
+                             "  --tcp-defer-accept <seconds>     Accept TCP connections once they sent data, 0 to disable (default: 0)\n"
+                             "  --busy-poll <usecs>              Busy poll the device queue of TCP connections (SO_BUSY_POLL), 0 to disable (default: 0)\n"
+                             "  --socket-rcvbuf <bytes>          Receive buffer of the connections, 0 for the kernel default (default: 0)\n"
+                             "  --socket-sndbuf <bytes>          Send buffer of the connections, 0 for the kernel default (default: 0)\n"
+                             "  --engine <poller|io_uring>       I/O engine (default: poller)\n"
+                             "  --poller <poll|epoll|epoll-et>   I/O readiness backend of the poller engine (default: epoll)\n"
+                             "  --threads <n>                    Event loop threads, the keyspace is sharded between them (default: 1)\n"
+                             "  --log-level <level>              Lowest logged level: debug, info, warn, error or off (default: info)\n"
+                             "  --snapshot <path>                Snapshot written by SAVE/BGSAVE and loaded at startup (default: dump.snap)\n"
+                             "  --aof <path>                     Log write commands to this file, replayed at startup instead of the snapshot\n"
+                             "  --aof-fsync <always|everysec|no> When the log is synced to disk (default: everysec)\n"
+                             "  --conn-buffer-limit <bytes>      Bytes buffered per connection, large values streamed in place excepted (default: 64 MiB)\n"
+                             "  --max-value-size <bytes>         Largest value streamed in place, a larger one closes the connection (default: 512 MiB)\n"
+                             "  --maxmemory <bytes>              Memory limit of the keyspace, blobs and buffers, 0 for none (default: 0)\n"
+                             "  --maxmemory-policy <policy>      Over the limit: noeviction, allkeys-lru, allkeys-lfu or volatile-ttl (default: noeviction)\n"
+                             "  --lazyfree <yes|no>              Free large values of DEL, overwrites, expiry and eviction in the background (default: yes)\n", program);
+    }
+} // namespace my_redis::config
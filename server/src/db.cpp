@@ -0,0 +1,327 @@
+#include "db.hpp"
+
+#include "evict.hpp"
+#include "keyspace.hpp"
+#include "lazyfree.hpp"
+#include "shard.hpp"
+#include "zset.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace my_redis::db
+{
+    using namespace my_redis::types;
+    using entry::Entry;
+
+    namespace
+    {
+        // The clock is only read every few keys while expiring
+        constexpr size K_EXPIRE_CLOCK_INTERVAL = 32;
+
+        bool expired(const Entry *entry, u64 now) noexcept
+        {
+            const entry::Expiry *expiry = entry->expiry();
+            return expiry && expiry->expireAt <= now;
+        }
+
+        // Bytes of the object owned by an entry, counted in `Shard::objectBytes`
+        size objectBytes(Entry *entry) noexcept
+        {
+            switch (entry->type)
+            {
+                case entry::Type::STRING:
+                    return 0;
+                case entry::Type::ZSET:
+                    return zset::memoryBytes(entry->object<zset::ZSet>());
+            }
+            return 0;
+        }
+
+        // A reference to the blob of `entry`, when dropping the entry's own one should be
+        // left to the background thread: the entry then never frees it itself
+        blob::Blob *holdForLazyFree(const Entry *entry, bool lazy) noexcept
+        {
+            blob::Blob *shared = entry->blob();
+            if (!lazy || !shared || !lazyfree::worthIt(shared))
+                return nullptr;
+            blob::retain(shared);
+            return shared;
+        }
+
+        // Free an unlinked entry and the object it owns, costly values in the background when `lazy`
+        void dispose(shard::Shard &shard, Entry *entry, bool lazy) noexcept
+        {
+            shard.objectBytes -= objectBytes(entry);
+            switch (entry->type)
+            {
+                case entry::Type::STRING:
+                    break;
+                case entry::Type::ZSET:
+                    if (auto *set = entry->object<zset::ZSet>(); lazy && lazyfree::worthIt(set))
+                        lazyfree::free(set);
+                    else
+                        delete set;
+                    break;
+            }
+
+            blob::Blob *held = holdForLazyFree(entry, lazy);
+            entry::destroy(shard.allocator, entry);
+            if (held)
+                lazyfree::release(held);
+        }
+
+        void unlinkEntry(shard::Shard &shard, Entry *entry, bool lazy) noexcept
+        {
+            keyspace::remove(shard.db, entry->node.hash, entry->key());
+            if (entry->expiry())
+                shard.expires.remove(entry);
+            dispose(shard, entry, lazy);
+            shard.dirty++;
+        }
+
+        bool unlinkKey(shard::Shard &shard, u64 hash, std::string_view key, bool lazy)
+        {
+            Entry *removed = keyspace::remove(shard.db, hash, key);
+            if (!removed)
+                return false;
+
+            bool existed = !expired(removed, nowMs());
+            if (removed->expiry())
+                shard.expires.remove(removed);
+            dispose(shard, removed, lazy);
+            shard.dirty++;
+            return existed;
+        }
+
+        // Put `to` in place of `from` (same key) in the index and the expiry heap, then free `from`
+        void swap(shard::Shard &shard, Entry *from, Entry *to)
+        {
+            // The object of a non-string entry now belongs to `to`
+            keyspace::replace(shard.db, from, to);
+            if (from->expiry())
+                shard.expires.remove(from);
+            if (to->expiry())
+                shard.expires.push(to);
+            entry::destroy(shard.allocator, from);
+        }
+    } // namespace
+
+    u64 nowMs() noexcept
+    {
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        return static_cast<u64>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+
+    void prefetchAhead(const shard::Shard &shard, std::span<const u64> hashes, size i) noexcept
+    {
+        constexpr size K_DISTANCE = K_PREFETCH_DISTANCE;
+        size count = hashes.size();
+
+        // The first call fills the pipeline
+        if (i == 0)
+        {
+            for (size k = 0; k < std::min(2 * K_DISTANCE, count); ++k)
+                keyspace::prefetchBucket(shard.db, hashes[k]);
+            for (size k = 0; k < std::min(K_DISTANCE, count); ++k)
+                keyspace::prefetchNode(shard.db, hashes[k]);
+        }
+
+        if (i + 2 * K_DISTANCE < count)
+            keyspace::prefetchBucket(shard.db, hashes[i + 2 * K_DISTANCE]);
+        if (i + K_DISTANCE < count)
+            keyspace::prefetchNode(shard.db, hashes[i + K_DISTANCE]);
+    }
+
+    Entry *lookup(shard::Shard &shard, u64 hash, std::string_view key)
+    {
+        Entry *found = keyspace::lookup(shard.db, hash, key);
+        if (found && expired(found, nowMs()))
+        {
+            erase(shard, found);
+            return nullptr;
+        }
+        if (found)
+            evict::touch(found);
+        return found;
+    }
+
+    void set(shard::Shard &shard, u64 hash, std::string_view key, std::string_view value, u64 expireAt, blob::Blob *shared)
+    {
+        u8 flags = expireAt ? entry::ENTRY_EXPIRES : 0;
+        shard.dirty++;
+
+        Entry *current = lookup(shard, hash, key);
+        // Overwriting a key of another type starts from a fresh entry
+        if (current && current->type != entry::Type::STRING)
+        {
+            erase(shard, current);
+            current = nullptr;
+        }
+
+        if (!current)
+        {
+            Entry *created = entry::create(shard.allocator, hash, key, value, flags, shared);
+            evict::init(created);
+            if (expireAt)
+            {
+                created->expiry()->expireAt = expireAt;
+                shard.expires.push(created);
+            }
+            keyspace::insert(shard.db, created);
+            return;
+        }
+
+        flags |= current->flags & ~entry::ENTRY_EXPIRES;
+        blob::Blob *held = holdForLazyFree(current, lazyfree::enabled());
+        Entry *updated = entry::setValue(shard.allocator, current, value, flags, shared);
+        if (held)
+            lazyfree::release(held);
+        if (expireAt)
+            updated->expiry()->expireAt = expireAt;
+
+        if (updated != current)
+            swap(shard, current, updated);
+        else if (expireAt)
+            shard.expires.update(current);
+    }
+
+    Entry *insertObject(shard::Shard &shard, u64 hash, std::string_view key, entry::Type type, void *object)
+    {
+        Entry *created = entry::create(shard.allocator, hash, key, { reinterpret_cast<const char *>(&object), sizeof(object) });
+        created->type = type;
+        evict::init(created);
+        shard.objectBytes += objectBytes(created);
+        keyspace::insert(shard.db, created);
+        shard.dirty++;
+        return created;
+    }
+
+    Entry *restore(shard::Shard &shard, u64 hash, std::string_view key, entry::Type type, std::string_view value, u64 expireAt)
+    {
+        Entry *created = entry::create(shard.allocator, hash, key, value, expireAt ? entry::ENTRY_EXPIRES : 0);
+        created->type = type;
+        evict::init(created);
+        shard.objectBytes += objectBytes(created);
+        if (expireAt)
+        {
+            created->expiry()->expireAt = expireAt;
+            shard.expires.push(created);
+        }
+        keyspace::insert(shard.db, created);
+        return created;
+    }
+
+    bool erase(shard::Shard &shard, u64 hash, std::string_view key)
+    {
+        return unlinkKey(shard, hash, key, lazyfree::enabled());
+    }
+
+    void erase(shard::Shard &shard, Entry *entry) noexcept
+    {
+        unlinkEntry(shard, entry, lazyfree::enabled());
+    }
+
+    bool unlink(shard::Shard &shard, u64 hash, std::string_view key)
+    {
+        return unlinkKey(shard, hash, key, true);
+    }
+
+    void expireAt(shard::Shard &shard, Entry *entry, u64 expireAt)
+    {
+        if (expireAt <= nowMs())
+        {
+            erase(shard, entry);
+            return;
+        }
+
+        shard.dirty++;
+        if (entry::Expiry *expiry = entry->expiry())
+        {
+            expiry->expireAt = expireAt;
+            shard.expires.update(entry);
+            return;
+        }
+
+        // Grow the entry by an `Expiry` section
+        Entry *updated = entry::setValue(shard.allocator, entry, entry->value(), entry->flags | entry::ENTRY_EXPIRES);
+        updated->expiry()->expireAt = expireAt;
+        swap(shard, entry, updated);
+    }
+
+    bool persist(shard::Shard &shard, Entry *entry)
+    {
+        if (!entry->expiry())
+            return false;
+
+        shard.dirty++;
+        Entry *updated = entry::setValue(shard.allocator, entry, entry->value(), entry->flags & ~entry::ENTRY_EXPIRES);
+        swap(shard, entry, updated);
+        return true;
+    }
+
+    std::optional<u64> parseCursor(std::string_view arg) noexcept
+    {
+        u64 cursor = 0;
+        auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), cursor);
+        if (ec != std::errc{} || end != arg.data() + arg.size())
+            return std::nullopt;
+        return cursor;
+    }
+
+    u64 scan(shard::Shard &shard, u64 cursor, size count, std::vector<Entry *> &out)
+    {
+        constexpr u64 K_INDEX_MASK = (u64{ 1 } << K_CURSOR_SHARD_SHIFT) - 1;
+        u64 position = cursor & K_INDEX_MASK;
+        u64 now = nowMs();
+        size visits = 0;
+        size found = out.size();
+
+        do
+        {
+            position = keyspace::scan(shard.db, position, out);
+            // Expired keys are left to lookups and the active expiry, a scan never writes
+            auto live = std::remove_if(out.begin() + static_cast<std::ptrdiff_t>(found), out.end(),
+                                       [now](const Entry *entry) { return expired(entry, now); });
+            out.erase(live, out.end());
+            found = out.size();
+        } while (position != 0 && found < count && ++visits < 10 * count);
+
+        if (position != 0)
+            return (cursor & ~K_INDEX_MASK) | position;
+        // This shard is done, the scan goes on with the next one
+        u32 next = cursorShard(cursor) + 1;
+        return next < shard::count() ? static_cast<u64>(next) << K_CURSOR_SHARD_SHIFT : 0;
+    }
+
+    size activeExpire(shard::Shard &shard, std::chrono::microseconds budget)
+    {
+        if (shard.expires.empty())
+            return 0;
+
+        auto deadline = std::chrono::steady_clock::now() + budget;
+        u64 now = nowMs();
+        size expiredCount = 0;
+
+        while (!shard.expires.empty() && shard.expires.topExpireAt() <= now)
+        {
+            erase(shard, shard.expires.top());
+            expiredCount++;
+
+            // Leave the rest for the next iteration of the event loop
+            if (expiredCount % K_EXPIRE_CLOCK_INTERVAL == 0 && std::chrono::steady_clock::now() >= deadline)
+                break;
+        }
+        return expiredCount;
+    }
+
+    i32 expireTimeout(const shard::Shard &shard) noexcept
+    {
+        if (shard.expires.empty())
+            return -1;
+
+        u64 now = nowMs();
+        u64 next = shard.expires.topExpireAt();
+        return next <= now ? 0 : static_cast<i32>(std::min<u64>(next - now, K_MAX_EXPIRE_WAIT_MS));
+    }
+} // namespace my_redis::db
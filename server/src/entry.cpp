@@ -0,0 +1,121 @@
+#include "entry.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+
+namespace my_redis::entry
+{
+    using namespace my_redis::types;
+
+    bool keyEquals(hashtable::HashNode *node, std::string_view key) noexcept
+    {
+        const Entry *entry = fromNode(node);
+        return entry->keyLen == key.size() && std::memcmp(entry->keyData(), key.data(), key.size()) == 0;
+    }
+
+    namespace
+    {
+        // Allocate an entry holding `value` inline
+        Entry *allocate(slab::Allocator &allocator, u64 hash, std::string_view key, std::string_view value, u8 flags)
+        {
+            size header = sizeof(Entry) + Entry::extraSize(flags);
+            size requested = header + key.size() + value.size();
+            size usable = slab::Allocator::usableSize(requested);
+            assert(value.size() < blob::K_MIN_SIZE && usable - header - key.size() <= 0xFFFF);
+
+            auto *entry = new (allocator.allocate(requested)) Entry{};
+            entry->node.hash = hash;
+            entry->keyLen = static_cast<u32>(key.size());
+            entry->valueLen = static_cast<u16>(value.size());
+            entry->valueCap = static_cast<u16>(usable - header - key.size());
+            entry->flags = flags;
+
+            if (Expiry *expiry = entry->expiry())
+                *expiry = {};
+            std::memcpy(entry->keyData(), key.data(), key.size());
+            std::memcpy(entry->valueData(), value.data(), value.size());
+            return entry;
+        }
+
+        // The inline bytes of an entry referencing `blob`
+        std::string_view pointerBytes(blob::Blob *const &blob) noexcept
+        {
+            return { reinterpret_cast<const char *>(&blob), sizeof(blob) };
+        }
+    } // namespace
+
+    Entry *create(slab::Allocator &allocator, u64 hash, std::string_view key, std::string_view value, u8 flags,
+                  blob::Blob *shared)
+    {
+        flags &= ~ENTRY_BLOB;
+        if (value.size() < blob::K_MIN_SIZE)
+            return allocate(allocator, hash, key, value, flags);
+
+        if (shared)
+        {
+            assert(shared->data() == value.data() && shared->length == value.size());
+            blob::retain(shared);
+        }
+        else
+            shared = blob::create(value);
+        return allocate(allocator, hash, key, pointerBytes(shared), flags | ENTRY_BLOB);
+    }
+
+    void destroy(slab::Allocator &allocator, Entry *entry) noexcept
+    {
+        if (blob::Blob *shared = entry->blob())
+            blob::release(shared);
+
+        size allocSize = entry->allocSize();
+        entry->~Entry();
+        allocator.deallocate(entry, allocSize);
+    }
+
+    Entry *setValue(slab::Allocator &allocator, Entry *entry, std::string_view value, u8 flags, blob::Blob *shared)
+    {
+        // Only the flags change when `value` is the entry's own blob: share it
+        blob::Blob *own = entry->blob();
+        bool sameBlob = own && value.data() == own->data();
+        flags &= ~ENTRY_BLOB;
+        if (sameBlob || value.size() >= blob::K_MIN_SIZE)
+            flags |= ENTRY_BLOB;
+
+        if (flags == entry->flags && (flags & ENTRY_BLOB))
+        {
+            // Blobs are immutable, readers may still be sending the old one
+            if (!sameBlob)
+            {
+                blob::Blob *replacement = shared ? (blob::retain(shared), shared) : blob::create(value);
+                std::memcpy(entry->valueData(), &replacement, sizeof(replacement));
+                blob::release(own);
+            }
+            return entry;
+        }
+
+        // Reuse the allocation unless the value outgrew it, or shrank enough
+        // that keeping it would waste more than half of it
+        size required = sizeof(Entry) + Entry::extraSize(flags) + entry->keyLen + value.size();
+        if (flags == entry->flags && value.size() <= entry->valueCap && required * 2 >= entry->allocSize())
+        {
+            std::memmove(entry->valueData(), value.data(), value.size());
+            entry->valueLen = static_cast<u16>(value.size());
+            return entry;
+        }
+
+        Entry *updated = nullptr;
+        if (sameBlob)
+        {
+            blob::retain(own);
+            updated = allocate(allocator, entry->node.hash, entry->key(), pointerBytes(own), flags);
+        }
+        else
+            updated = create(allocator, entry->node.hash, entry->key(), value, flags, shared);
+
+        updated->type = entry->type;
+        updated->access = entry->access;
+        if (entry->expiry() && updated->expiry())
+            *updated->expiry() = *entry->expiry();
+        return updated;
+    }
+} // namespace my_redis::entry
@@ -0,0 +1,104 @@
+#include "event/epoll_poller.hpp"
+#include "exception.hpp"
+
+#include <unistd.h>
+
+namespace my_redis::event
+{
+    using namespace my_redis::types;
+
+    EpollPoller::EpollPoller(bool edgeTriggered)
+        : m_EdgeTriggered(edgeTriggered), m_Events(K_MAX_EVENTS)
+    {
+        m_EpollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (-1 == m_EpollFd)
+            throw exception::errno_exception{ "EpollPoller::EpollPoller(bool edgeTriggered) -> epoll_create1()" };
+    }
+
+    EpollPoller::~EpollPoller()
+    {
+        if (m_EpollFd >= 0)
+            ::close(m_EpollFd);
+    }
+
+    bool EpollPoller::poll(i32 timeoutMs)
+    {
+        m_Ready.clear();
+
+        auto n = ::epoll_wait(m_EpollFd, m_Events.data(), static_cast<i32>(m_Events.size()), timeoutMs);
+        if (-1 == n)
+        {
+            if (errno == EINTR)
+                return false;
+            else
+                throw exception::errno_exception{ "bool EpollPoller::poll(i32 timeoutMs) -> epoll_wait()" };
+        }
+
+        for (i32 i = 0; i < n; ++i)
+        {
+            const auto &[events, data] = m_Events[i];
+            // Hang-ups are reported as readable so that the pending data and
+            // the EOF are both picked up by `read()`.
+            m_Ready.emplace_back(Event{
+                .fd = data.fd,
+                .flags = (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP) ? EVENT_READ : 0u) |
+                         (events & EPOLLOUT ? EVENT_WRITE : 0u) |
+                         (events & EPOLLERR ? EVENT_ERROR : 0u)
+            });
+        }
+
+        return true;
+    }
+
+    u32 EpollPoller::interestOf(const Connection &connection) const noexcept
+    {
+        // In edge-triggered mode both directions stay registered for the whole
+        // lifetime of the connection; the handlers decide what to act upon.
+        if (m_EdgeTriggered)
+            return EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+
+        return (connection.wantRead ? EPOLLIN : 0u) |
+               (connection.wantWrite ? EPOLLOUT : 0u);
+    }
+
+    void EpollPoller::watch(const ConnectionInfo &connectionInfo)
+    {
+        const auto &[type, connection] = connectionInfo;
+        auto fd = connection->fd();
+
+        u32 interest = type == ConnectionInfo::Type::CLIENT
+                           ? interestOf(*connection)
+                           : (EPOLLIN | (m_EdgeTriggered ? EPOLLET : 0u));
+
+        epoll_event ev{ .events = interest, .data = { .fd = fd } };
+        if (-1 == ::epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, fd, &ev))
+            throw exception::errno_exception{ "void EpollPoller::watch(const ConnectionInfo &connectionInfo) -> epoll_ctl(EPOLL_CTL_ADD)" };
+
+        if (m_Interest.size() < static_cast<size>(fd) + 1)
+            m_Interest.resize(fd + 1);
+        m_Interest[fd] = interest;
+    }
+
+    void EpollPoller::unwatch(i32 fd)
+    {
+        // Closing the fd is not enough while a forked child (BGSAVE) still holds a
+        // duplicate: the registration would outlive it and report a dead fd
+        if (-1 == ::epoll_ctl(m_EpollFd, EPOLL_CTL_DEL, fd, nullptr))
+            throw exception::errno_exception{ "void EpollPoller::unwatch(i32 fd) -> epoll_ctl(EPOLL_CTL_DEL)" };
+        m_Interest.at(fd) = 0;
+    }
+
+    void EpollPoller::updateInterest(const Connection &connection)
+    {
+        auto fd = connection.fd();
+        u32 interest = interestOf(connection);
+        if (m_Interest.at(fd) == interest)
+            return;
+
+        epoll_event ev{ .events = interest, .data = { .fd = fd } };
+        if (-1 == ::epoll_ctl(m_EpollFd, EPOLL_CTL_MOD, fd, &ev))
+            throw exception::errno_exception{ "void EpollPoller::updateInterest(const Connection &connection) -> epoll_ctl(EPOLL_CTL_MOD)" };
+
+        m_Interest[fd] = interest;
+    }
+} // namespace my_redis::event
@@ -1,349 +1,254 @@
 #include "event/event_loop.hpp"
 
+#include "aof.hpp"
+#include "db.hpp"
 #include "exception.hpp"
-#include "hashtable.hpp"
-#include "payload.hpp"
-#include "response.hpp"
+#include "log.hpp"
+#include "request.hpp"
+#include "snapshot.hpp"
 #include "types.hpp"
+#include "util.hpp"
 
-#include <cassert>
-#include <optional>
-#include <sstream>
-#include <string>
-#include <string_view>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-#define container_of(ptr, T, member) \
-    ((T *)( (char *)ptr - offsetof(T, member) ))
+#include <cassert>
 
-namespace
+namespace my_redis::event
 {
     using namespace my_redis::types;
-    using my_redis::hashmap::HashMap;
-    using my_redis::hashtable::HashNode;
-
-    struct { HashMap db; } g_data{};
-
-    struct Entry
-    {
-        HashNode node;
-        std::string key, value;
-    };
-
-    bool entryCmp(HashNode *lhs, HashNode *rhs) noexcept
-    {
-        Entry *le = container_of(lhs, Entry, node);
-        Entry *re = container_of(rhs, Entry, node);
-        return le->key == re->key;
-    }
-    
-    // FNV hash
-    constexpr u32 FNV_OFFSET_BASIS  = 0x811C9DC5;
-    constexpr u32 FNV_PRIME         = 0x01000193;
-    u64 strHash(const u8 *data, size len) noexcept
-    {
-        u32 h = FNV_OFFSET_BASIS;
-        for (size i = 0; i < len; i++)
-            h = (h * FNV_PRIME) ^ data[i];
-        return h;
-    }
-    
-    static inline u64 strHash(std::string_view str) noexcept
-    {
-        return strHash((const u8 *) str.data(), str.size());
-    }
-}
-
-namespace my_redis
-{
-    constexpr size K_MAX_ARGS = 200 * 1000;
-
-    // Consume 32-bit unsigned integer from the buffer and advance the pointer.
-    bool read_u32(const u8 *&curr, const u8 *end, u32 &out)
-    {
-        if (curr + 4 > end)
-            return false;
 
-        std::memcpy(&out, curr, 4);
-        curr += 4;
-        return true;
-    }
+    // Minimum free space offered to read(2)
+    constexpr size K_READ_CHUNK = 16 * 1024;
 
-    void doGet(std::vector<std::string> &command, Response &out)
+    std::optional<EventLoop::Engine> EventLoop::parseEngine(std::string_view name) noexcept
     {
-        Entry entry{
-            .node   = { .hash = strHash(command[1]) },
-            .key    = command[1],
-            .value  = {}
-        };
-
-        // Lookup the entry in the hash map
-        HashNode *hashNode = hashmap::lookup(&g_data.db, &entry.node, entryCmp);
-        // Not found
-        if (!hashNode)
-        {
-            out.status = Response::Status::RES_NX;
-            return;
-        }
-        // Found
-        const std::string &val = container_of(hashNode, Entry, node)->value;
-        out.data.assign(val.begin(), val.end());
+        if (name == "poller")
+            return Engine::POLLER;
+        if (name == "io_uring")
+            return Engine::IO_URING;
+        return std::nullopt;
     }
 
-    void doSet(std::vector<std::string> &command)
+    EventLoop::EventLoop(std::vector<sockets::ServerSocket> &&listeners, Engine engine, EventPoller::Backend backend, shard::Shard &shard)
+        : m_Shard(shard)
     {
-        Entry entry{
-            .node   = { .hash = strHash(command[1]) },
-            .key    = command[1],
-            .value  = {}
-        };
-
-        // Lookup the entry in the hash map
-        HashNode *hashNode = hashmap::lookup(&g_data.db, &entry.node, entryCmp);
-        // If found, update the value
-        if (hashNode)
+        if (engine == Engine::IO_URING)
         {
-            container_of(hashNode, Entry, node)->value.swap(command[2]);
-            return;
-        }
-     
-        // If not found, create a new entry
-        Entry *newEntry = new Entry{};
-        newEntry->node.hash = entry.node.hash;
-        newEntry->key.swap(entry.key);
-        newEntry->value.swap(command[2]);
-        hashmap::insert(&g_data.db, &newEntry->node);
-    }
-
-    void doDel(std::vector<std::string> &command)
-    {
-        Entry entry{
-            .node   = { .hash = strHash(command[1]) },
-            .key    = command[1],
-            .value  = {}
-        };
-
-        // Lookup and detach the entry in the hash map
-        HashNode *removedHashNode = hashmap::remove(&g_data.db, &entry.node, entryCmp);
-        // If found, delete the entry
-        if (removedHashNode)
-            delete container_of(removedHashNode, Entry, node);
-    }
-
-    std::optional<std::vector<std::string>> parseRequest(const u8 *data, size size)
-    {
-        // Request format: "nstr(count of strings) | len1     str1         | len2 str2 | ... | lenN strN"
-        //                  ^ 4Bytes                 ^ 4Bytes ^ len1 Bytes
-
-        const u8 *curr = data;
-        const u8 *end = data + size;
-        std::vector<std::string> command;
-
-        u32 nstr = 0;
-        if (!read_u32(curr, end, nstr))
-            return { std::nullopt };
-
-        if (nstr > K_MAX_ARGS)
-            return { std::nullopt };
-
-        // Read command
-        while (command.size() < nstr)
-        {
-            // Read the length of the next string
-            u32 len = 0;
-            if (!read_u32(curr, end, len))
-                return { std::nullopt };
-
-            if (curr + len > end)
-                return { std::nullopt };
-
-            // Read the string itself
-            command.emplace_back(std::string{curr, curr + len});
-            curr += len;
-        }
-
-        if (curr != end)
-            return { std::nullopt };
-
-        return { command };
-    }
-
-    Response handleRequest(std::vector<std::string> &command)
-    {
-        Response response{};
-        if (command.size() == 2 && command.at(0) == "get")
-            doGet(command, response);
-        else if (command.size() == 3 && command.at(0) == "set")
-            doSet(command);
-        else if (command.size() == 2 && command.at(0) == "del")
-            doDel(command);
-        else
-            response.status = Response::Status::RES_ERR;
-
-        return response;
-    }
-
-    bool tryParseRequest(Connection &connection)
-    {
-        // Not enough data to read the header
-        if (connection.incomingBuffer.size() < payload::HEADER_LEN)
-            return false;
-
-        // 1. Read the length of the payload
-        u32 requestLen = 0;
-        std::memcpy(&requestLen, connection.incomingBuffer.data(), payload::HEADER_LEN);
-        if (requestLen > payload::MAX_MSG_LEN)
-        {
-            std::fprintf(stderr, "> Requested message is too long!\n");
-            connection.wantClose = true;
-            return false;
-        }
-
-        // Not enough data to read the entire payload
-        if (connection.incomingBuffer.size() < payload::HEADER_LEN + requestLen)
-            return false;
-
-        // Request ready to be processed
-        const u8 *request = connection.incomingBuffer.data() + payload::HEADER_LEN;
+            m_UringEngine = UringEngine::create(shard);
+            if (m_UringEngine)
+            {
+                for (auto &listener : listeners)
+                    m_UringEngine->addListener(std::move(listener));
+                return;
+            }
 
-        std::optional<std::vector<std::string>> command = parseRequest(request, requestLen);
-        if (!command)
-        {
-            std::fprintf(stderr, "> Bad Request\n");
-            connection.wantClose = true;
-            return false;
+            LOG_WARN("Falling back to the poller engine");
         }
 
+        m_EventPoller = EventPoller::create(backend);
+        for (auto &listener : listeners)
         {
-            std::stringstream ss;
-            for (auto i = 0; i < command->size() - 1; ++i)
-                ss << command->at(i) << ", ";
-            ss << command->back();
-            std::fprintf(stderr, "> Parsed Request: [ %s ]\n", ss.str().c_str());
+            m_EventPoller->addConnection({
+                .type       = EventPoller::ConnectionInfo::Type::LISTENING,
+                .connection = std::make_unique<Connection>(std::move(listener)),
+            });
         }
 
-        Response resp = handleRequest(*command);
-
-        // Prepare the response
-        u32 responseLength = resp.data.size() + 4;
-        buffer::append(connection.outgoingBuffer, &responseLength, 4);
-        buffer::append(connection.outgoingBuffer, &resp.status, 4);
-        buffer::append(connection.outgoingBuffer, resp.data.data(), resp.data.size());
+        // The poller owns a duplicate of the eventfd, the mailbox keeps its own
+        auto wakeFd = ::dup(shard.mailbox.fd());
+        if (-1 == wakeFd)
+            throw exception::errno_exception{ "EventLoop::EventLoop() -> dup()" };
 
-        // Consume the processed payload
-        buffer::consume(connection.incomingBuffer, payload::HEADER_LEN + requestLen);
-
-        return true;
+        m_EventPoller->addConnection({
+            .type       = EventPoller::ConnectionInfo::Type::MAILBOX,
+            .connection = std::make_unique<Connection>(sockets::Socket{ wakeFd }),
+        });
     }
-}
 
-namespace my_redis::event
-{
     void EventLoop::run()
     {
+        if (m_UringEngine)
+            return m_UringEngine->run();
+
         while (true)
         {
-            if (!m_EventPoller.poll())
+            shard::parkIfStopped(m_Shard);
+            shard::applyStatsReset(m_Shard);
+            snapshot::poll(m_Shard);
+            aof::flush(m_Shard);
+
+            // Sleep only until the next key expires
+            db::activeExpire(m_Shard);
+            if (!m_EventPoller->poll(db::expireTimeout(m_Shard)))
                 continue;
 
+            auto ready = m_EventPoller->ready();
+            m_Shard.loopStats.wakeups.add(1);
+            m_Shard.loopStats.readyPerWakeup.record(ready.size());
+
             // Dispatch events for all ready connections
-            for (const auto &pfd : m_EventPoller.ready())
-                dispatch(pfd);
+            for (const auto &event : ready)
+                dispatch(event);
         }
     }
 
-    void EventLoop::dispatch(const pollfd &pfd)
+    void EventLoop::dispatch(const Event &event)
     {
-        auto &[fd, events, revents] = pfd;
-        auto &[type, connection] = m_EventPoller.connections().at(fd);
+        auto &[type, connection] = m_EventPoller->connections().at(event.fd);
+        // Closed earlier in the same batch, e.g. by a failed write of a forwarded reply
+        if (!connection)
+            return;
 
         if (type == EventPoller::ConnectionInfo::Type::LISTENING)
         {
             // handle accept
             if (!handleAccept(*connection))
-                std::fprintf(stderr, "> Failed to accept new client!\n");
+                LOG_ERROR("Failed to accept new client");
 
             return;
         }
 
+        if (type == EventPoller::ConnectionInfo::Type::MAILBOX)
+        {
+            // Reset the eventfd counter, then handle the messages
+            u64 count = 0;
+            [[maybe_unused]] auto n = ::read(connection->fd(), &count, sizeof(count));
+            drainMailbox();
+            return;
+        }
+
         // handle read
-        if (revents & POLLIN)
+        if (event.flags & EVENT_READ)
             handleRead(*connection);
         
         // handle write
-        if (revents & POLLOUT)
+        if (event.flags & EVENT_WRITE && connection->wantWrite)
             handleWrite(*connection);
 
+        // pick up the input left while reading was paused
+        resumeRead(*connection);
+
         // handle error and close
-        if (revents & POLLERR || connection->wantClose)
+        if (event.flags & EVENT_ERROR || connection->wantClose)
         {
-            std::fprintf(stderr, "> Client disconnected.\n");
-            m_EventPoller.closeConnection(connection->fd());
+            LOG_DEBUG("Client disconnected[fd %d]", connection->fd());
+            m_EventPoller->closeConnection(connection->fd());
+            return;
         }
+
+        m_EventPoller->updateInterest(*connection);
     }
 
     bool EventLoop::handleAccept(const Connection &connection)
     {
-        sockaddr_in addr{};
-        socklen_t len{ sizeof(addr) };
-
-        auto fd = ::accept(connection.fd(), (struct sockaddr *)&addr, &len);
-        if (fd >= 0)
+        // Accept the whole backlog in one wakeup, whatever the poller: one accept per
+        // event would cost a poll round trip per connection during a connection storm.
+        // accept4() returns the sockets non-blocking, without the fcntl() round trips.
+        while (true)
         {
-            std::fprintf(stderr, "> Accepted new client[%s:%d]\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+            sockets::Socket client{ ::accept4(connection.fd(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) };
+            if (!client.isValid())
+            {
+                // Aborted before being accepted, or interrupted: the backlog may hold more
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                if (errno == EAGAIN)
+                    return true;
+
+                // Out of descriptors or memory: leave the backlog until the next wakeup
+                LOG_ERROR("bool handleAccept(const Connection &connection) -> accept4() : %s", util::strerror(errno).c_str());
+                return false;
+            }
+
+            LOG_DEBUG("Accepted new client[fd %d]", client.fd());
 
-            sockets::Socket client{ fd };
-            client.setNonBlock();
             auto clientConnection = std::make_unique<Connection>(std::move(client));
+            clientConnection->id = m_NextConnectionId++;
             clientConnection->wantRead = true;
 
-            m_EventPoller.addConnection(EventPoller::ConnectionInfo{
+            m_EventPoller->addConnection(EventPoller::ConnectionInfo{
                 .type       = EventPoller::ConnectionInfo::Type::CLIENT,
                 .connection = std::move(clientConnection),
             });
-
-            return true;
         }
-
-        if (errno == EINTR || errno == EAGAIN)
-            return false;
-
-        if (-1 == fd)
-            throw exception::errno_exception{ "bool handleAccept(const Connection &connection) -> accept()" };
-
-        return true;
     }
 
     bool EventLoop::handleRead(Connection &connection)
     {
-        u8 buffer[64 * 1024];
-        ssize bytesRead = ::read(connection.fd(), buffer, sizeof(buffer));
-        if (-1 == bytesRead) // Error
+        // Edge-triggered: both directions stay registered, leave the input in the
+        // socket while reading is paused. `resumeRead()` picks it up later.
+        if (m_EventPoller->edgeTriggered() && !connection.wantRead)
+        {
+            connection.readPending = true;
+            return true;
+        }
+
+        while (true)
         {
-            if (errno != EAGAIN)
+            // Read straight into the free space of the connection buffer
+            u8 *buffer = connection.incomingBuffer.prepare(K_READ_CHUNK);
+            size capacity = connection.incomingBuffer.writable();
+            ssize bytesRead = ::read(connection.fd(), buffer, capacity);
+            if (-1 == bytesRead) // Error
             {
-                std::fprintf(stderr, "bool handleRead(ConnectionImpl &connection) -> read() : %s\n", util::strerror(errno).c_str());
+                if (errno != EAGAIN)
+                {
+                    LOG_WARN("bool handleRead(Connection &connection) -> read() : %s", util::strerror(errno).c_str());
+                    connection.wantClose = true;
+                    return false;
+                }
+                connection.readPending = false;
+                return processIncoming(connection);
+            }
+
+            if (0 == bytesRead) // EOF
+            {
+                if (connection.incomingBuffer.size() != 0)
+                    LOG_WARN("Unexpected EOF(incomingBuffer size %zu)", connection.incomingBuffer.size());
+
                 connection.wantClose = true;
+                return false;
             }
-            return false;
-        }
 
-        if (0 == bytesRead) // EOF
-        {
-            if (connection.incomingBuffer.size() != 0)
-                std::fprintf(stderr, "> Unexpected EOF(read %zd bytes - incomingBuffer size %zu)\n", bytesRead, connection.incomingBuffer.size());
+            // Successfully read data
+            connection.incomingBuffer.commit(bytesRead);
+            m_Shard.loopStats.bytesIn.add(static_cast<u64>(bytesRead));
 
-            connection.wantClose = true;
-            return false;
+            if (!processIncoming(connection))
+                return false;
+
+            // Edge-triggered: drain the socket. A short read means the kernel
+            // buffer is empty, and any data arriving later raises a new edge.
+            // Parsing runs between the reads, so that a pause stops the draining.
+            connection.readPending = m_EventPoller->edgeTriggered() && static_cast<size>(bytesRead) == capacity;
+            if (!connection.readPending || !connection.wantRead)
+                return true;
         }
+    }
 
-        // Successfully read data
-        buffer::append(connection.incomingBuffer, buffer, bytesRead);
+    void EventLoop::resumeRead(Connection &connection)
+    {
+        // Edge-triggered: the input left in the socket while reading was paused raises no new edge
+        if (connection.readPending && connection.wantRead && !connection.wantClose)
+            handleRead(connection);
+    }
 
+    bool EventLoop::processIncoming(Connection &connection)
+    {
         // Pipeline processing of requests
         // Keep processing until no more complete requests are available
-        while (tryParseRequest(connection))
-            ;
+        u64 depth = 0;
+        while (tryParseRequest(connection, m_Shard))
+            depth++;
+        m_Shard.loopStats.pipelineDepth.record(depth);
+
+        if (connection.wantClose)
+            return false;
+
+        // Stop reading while parsing is paused, TCP pushes back on the client
+        connection.wantRead = !readPaused(connection);
 
         if (connection.outgoingBuffer.size() > 0)
         {
@@ -355,27 +260,91 @@ namespace my_redis::event
         return true;
     }
 
+    void EventLoop::drainMailbox()
+    {
+        m_Shard.mailbox.acknowledge();
+
+        while (shard::Message *message = m_Shard.mailbox.pop())
+        {
+            if (message->kind == shard::Message::Kind::REQUEST)
+            {
+                executeForwarded(m_Shard, *message);
+                continue;
+            }
+
+            std::unique_ptr<shard::Message> reply{ message };
+
+            // The client may have disconnected in the meantime
+            auto &connections = m_EventPoller->connections();
+            if (reply->fd >= static_cast<i32>(connections.size()))
+                continue;
+
+            auto &[type, connection] = connections[reply->fd];
+            if (!connection || connection->id != reply->connectionId)
+                continue;
+
+            deliverReply(*connection, *reply);
+            processIncoming(*connection);
+            resumeRead(*connection);
+
+            if (connection->wantClose)
+            {
+                LOG_DEBUG("Client disconnected[fd %d]", connection->fd());
+                m_EventPoller->closeConnection(connection->fd());
+                continue;
+            }
+
+            m_EventPoller->updateInterest(*connection);
+        }
+    }
+
     bool EventLoop::handleWrite(Connection &connection)
     {
         assert(connection.outgoingBuffer.size() > 0);
+        aof::beforeReply(m_Shard);
 
-        ssize bytesWritten = ::write(connection.fd(), connection.outgoingBuffer.data(), connection.outgoingBuffer.size());
-        if (-1 == bytesWritten)
+        size gathered = 0;
+        ssize bytesWritten = 0;
+        do
         {
-            if (errno != EAGAIN)
+            // Large values are sent from the blobs they are stored in
+            iovec iov[output::Queue::K_MAX_IOV];
+            auto count = connection.outgoingBuffer.gather(iov, std::size(iov));
+            gathered = 0;
+            for (size i = 0; i < count; ++i)
+                gathered += iov[i].iov_len;
+
+            // sendmsg() rather than writev(): a peer gone with replies in flight must not raise SIGPIPE
+            msghdr message{};
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+            bytesWritten = ::sendmsg(connection.fd(), &message, MSG_NOSIGNAL);
+            if (-1 == bytesWritten)
             {
-                std::fprintf(stderr, "bool handleWrite(Connection &connection) -> write() : %s\n", util::strerror(errno).c_str());
-                connection.wantClose = true;
+                if (errno != EAGAIN)
+                {
+                    LOG_WARN("bool handleWrite(Connection &connection) -> sendmsg() : %s", util::strerror(errno).c_str());
+                    connection.wantClose = true;
+                }
+                return false;
             }
-            return false;
-        }
 
-        buffer::consume(connection.outgoingBuffer, bytesWritten);
+            connection.outgoingBuffer.consume(bytesWritten);
+            m_Shard.loopStats.bytesOut.add(static_cast<u64>(bytesWritten));
+
+            // Edge-triggered: a complete write of the gathered pieces leaves the socket
+            // writable, no new edge would come for the rest of the output.
+        } while (m_EventPoller->edgeTriggered() && static_cast<size>(bytesWritten) == gathered &&
+                 connection.outgoingBuffer.size() > 0);
 
         if (connection.outgoingBuffer.size() == 0)
         {
-            connection.wantRead = true;
+            connection.wantRead = !readPaused(connection);
             connection.wantWrite = false;
+
+            // Requests left unparsed while the replies were over the buffer limit
+            if (!connection.incomingBuffer.empty())
+                return processIncoming(connection);
         }
 
         return true;
@@ -1,45 +1,29 @@
 #include "event/event_poller.hpp"
-#include "exception.hpp"
-
-#include <ranges>
+#include "event/epoll_poller.hpp"
+#include "event/poll_poller.hpp"
 
 namespace my_redis::event
 {
-    bool EventPoller::poll()
+    std::unique_ptr<EventPoller> EventPoller::create(Backend backend)
     {
-        m_Pfds.clear();
-
-        // Prepare pollfd structures for all connections
-        // Filter out empty connections
-        auto filtered = m_Connections |
-                        std::views::filter([](const ConnectionInfo &ci)
-                                           { return ci.connection != nullptr; });
-
-        m_Pfds.reserve(std::ranges::distance(filtered));
-        
-        // Fill pollfd structures
-        for (const auto &[type, connection] : filtered)
-        {
-            m_Pfds.emplace_back(pollfd{
-                .fd = connection->fd(),
-                .events = POLLERR, // Listen for errors by default
-                .revents = 0
-            });
-            m_Pfds.back().events |= (type == ConnectionInfo::Type::LISTENING ? POLLIN : 0) |
-                                    (connection->wantRead ? POLLIN : 0) |
-                                    (connection->wantWrite ? POLLOUT : 0);
-        }
-
-        auto result = ::poll(m_Pfds.data(), m_Pfds.size(), -1);
-        if (-1 == result)
+        switch (backend)
         {
-            if (errno == EINTR)
-                return false;
-            else
-                throw exception::errno_exception{ "bool EventPoller::poll() -> poll()" };
+            case Backend::EPOLL: return std::make_unique<EpollPoller>(false);
+            case Backend::EPOLL_ET: return std::make_unique<EpollPoller>(true);
+            case Backend::POLL:
+            default: return std::make_unique<PollPoller>();
         }
+    }
 
-        return true;
+    std::optional<EventPoller::Backend> EventPoller::parseBackend(std::string_view name) noexcept
+    {
+        if (name == "poll")
+            return Backend::POLL;
+        if (name == "epoll")
+            return Backend::EPOLL;
+        if (name == "epoll-et")
+            return Backend::EPOLL_ET;
+        return std::nullopt;
     }
 
     void EventPoller::addConnection(ConnectionInfo &&connectionInfo)
@@ -49,5 +33,12 @@ namespace my_redis::event
             m_Connections.resize(fd + 1);
 
         m_Connections.at(fd) = std::move(connectionInfo);
+        watch(m_Connections.at(fd));
+    }
+
+    void EventPoller::closeConnection(types::i32 fd)
+    {
+        unwatch(fd);
+        m_Connections.at(fd).connection.reset(nullptr);
     }
-}
\ No newline at end of file
+} // namespace my_redis::event
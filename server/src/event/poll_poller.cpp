@@ -0,0 +1,56 @@
+#include "event/poll_poller.hpp"
+#include "exception.hpp"
+
+#include <ranges>
+
+namespace my_redis::event
+{
+    bool PollPoller::poll(types::i32 timeoutMs)
+    {
+        m_Pfds.clear();
+        m_Ready.clear();
+
+        // Prepare pollfd structures for all connections
+        // Filter out empty connections
+        auto filtered = m_Connections |
+                        std::views::filter([](const ConnectionInfo &ci)
+                                           { return ci.connection != nullptr; });
+
+        m_Pfds.reserve(std::ranges::distance(filtered));
+        
+        // Fill pollfd structures
+        for (const auto &[type, connection] : filtered)
+        {
+            m_Pfds.emplace_back(pollfd{
+                .fd = connection->fd(),
+                .events = POLLERR, // Listen for errors by default
+                .revents = 0
+            });
+            m_Pfds.back().events |= (type != ConnectionInfo::Type::CLIENT ? POLLIN : 0) |
+                                    (connection->wantRead ? POLLIN : 0) |
+                                    (connection->wantWrite ? POLLOUT : 0);
+        }
+
+        auto result = ::poll(m_Pfds.data(), m_Pfds.size(), timeoutMs);
+        if (-1 == result)
+        {
+            if (errno == EINTR)
+                return false;
+            else
+                throw exception::errno_exception{ "bool PollPoller::poll(types::i32 timeoutMs) -> poll()" };
+        }
+
+        // Collect the connections that are ready for reading or writing
+        for (const auto &pfd : m_Pfds | std::views::filter([](const pollfd &pfd) { return pfd.revents; }))
+        {
+            m_Ready.emplace_back(Event{
+                .fd = pfd.fd,
+                .flags = (pfd.revents & POLLIN ? EVENT_READ : 0u) |
+                         (pfd.revents & POLLOUT ? EVENT_WRITE : 0u) |
+                         (pfd.revents & POLLERR ? EVENT_ERROR : 0u)
+            });
+        }
+
+        return true;
+    }
+} // namespace my_redis::event
@@ -0,0 +1,175 @@
+#include "event/uring.hpp"
+#include "exception.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace my_redis::event::uring
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        i32 setup(u32 entries, io_uring_params *params) noexcept
+        {
+            return static_cast<i32>(::syscall(__NR_io_uring_setup, entries, params));
+        }
+
+        i32 enter(i32 fd, u32 toSubmit, u32 minComplete, u32 flags) noexcept
+        {
+            return static_cast<i32>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+        }
+
+        i32 registerRing(i32 fd, u32 opcode, void *arg, u32 nrArgs) noexcept
+        {
+            return static_cast<i32>(::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+        }
+
+        template <typename T>
+        T *at(void *base, u32 offset) noexcept
+        {
+            return reinterpret_cast<T *>(static_cast<u8 *>(base) + offset);
+        }
+    } // namespace
+
+    Ring::Ring(u32 entries)
+    {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_CLAMP;
+
+        m_Fd = setup(entries, &params);
+        if (-1 == m_Fd)
+            throw exception::errno_exception{ "Ring::Ring(u32 entries) -> io_uring_setup()" };
+
+        m_Features = params.features;
+        if (!(m_Features & IORING_FEAT_SINGLE_MMAP))
+        {
+            ::close(m_Fd);
+            throw exception::errno_exception{ "Ring::Ring(u32 entries) -> IORING_FEAT_SINGLE_MMAP", ENOTSUP };
+        }
+
+        // With IORING_FEAT_SINGLE_MMAP the SQ and CQ rings share one mapping
+        m_SqMapLen = std::max(params.sq_off.array + params.sq_entries * sizeof(u32),
+                              params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        m_SqMap = ::mmap(nullptr, m_SqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Fd, IORING_OFF_SQ_RING);
+        if (MAP_FAILED == m_SqMap)
+        {
+            auto err = errno;
+            ::close(m_Fd);
+            throw exception::errno_exception{ "Ring::Ring(u32 entries) -> mmap(IORING_OFF_SQ_RING)", err };
+        }
+        m_CqMap = m_SqMap;
+
+        m_SqesLen = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = ::mmap(nullptr, m_SqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Fd, IORING_OFF_SQES);
+        if (MAP_FAILED == sqes)
+        {
+            auto err = errno;
+            ::munmap(m_SqMap, m_SqMapLen);
+            ::close(m_Fd);
+            throw exception::errno_exception{ "Ring::Ring(u32 entries) -> mmap(IORING_OFF_SQES)", err };
+        }
+        m_Sqes = static_cast<io_uring_sqe *>(sqes);
+
+        m_SqHead  = at<u32>(m_SqMap, params.sq_off.head);
+        m_SqTail  = at<u32>(m_SqMap, params.sq_off.tail);
+        m_SqMask  = at<u32>(m_SqMap, params.sq_off.ring_mask);
+        m_SqArray = at<u32>(m_SqMap, params.sq_off.array);
+        m_SqEntries = params.sq_entries;
+        m_SqLocalTail = *m_SqTail;
+
+        m_CqHead = at<u32>(m_CqMap, params.cq_off.head);
+        m_CqTail = at<u32>(m_CqMap, params.cq_off.tail);
+        m_CqMask = at<u32>(m_CqMap, params.cq_off.ring_mask);
+        m_Cqes   = at<io_uring_cqe>(m_CqMap, params.cq_off.cqes);
+    }
+
+    Ring::~Ring()
+    {
+        if (m_Sqes)
+            ::munmap(m_Sqes, m_SqesLen);
+        if (m_SqMap)
+            ::munmap(m_SqMap, m_SqMapLen);
+        if (m_Fd >= 0)
+            ::close(m_Fd);
+    }
+
+    io_uring_sqe *Ring::getSqe() noexcept
+    {
+        u32 head = std::atomic_ref{ *m_SqHead }.load(std::memory_order_acquire);
+        if (m_SqLocalTail - head >= m_SqEntries)
+            return nullptr;
+
+        u32 index = m_SqLocalTail & *m_SqMask;
+        io_uring_sqe *sqe = &m_Sqes[index];
+        m_SqArray[index] = index;
+        m_SqLocalTail++;
+
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    i32 Ring::submitAndWait(u32 waitNr) noexcept
+    {
+        u32 toSubmit = m_SqLocalTail - *m_SqTail;
+        std::atomic_ref{ *m_SqTail }.store(m_SqLocalTail, std::memory_order_release);
+
+        i32 result = enter(m_Fd, toSubmit, waitNr, waitNr > 0 ? IORING_ENTER_GETEVENTS : 0);
+        return result < 0 ? -errno : result;
+    }
+
+    BufferRing::BufferRing(Ring &ring, u16 groupId, u16 count, u32 bufferSize)
+        : m_Ring(ring), m_GroupId(groupId), m_Count(count), m_BufferSize(bufferSize),
+          m_Storage(static_cast<size>(count) * bufferSize)
+    {
+        // `count` must be a power of 2
+        m_BufRingLen = count * sizeof(io_uring_buf);
+        void *mem = ::mmap(nullptr, m_BufRingLen, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (MAP_FAILED == mem)
+            throw exception::errno_exception{ "BufferRing::BufferRing() -> mmap()" };
+        m_BufRing = static_cast<io_uring_buf_ring *>(mem);
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<u64>(m_BufRing);
+        reg.ring_entries = count;
+        reg.bgid = groupId;
+        if (0 != registerRing(m_Ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1))
+        {
+            auto err = errno;
+            ::munmap(m_BufRing, m_BufRingLen);
+            throw exception::errno_exception{ "BufferRing::BufferRing() -> io_uring_register(IORING_REGISTER_PBUF_RING)", err };
+        }
+
+        for (u16 bid = 0; bid < count; ++bid)
+            recycle(bid);
+    }
+
+    BufferRing::~BufferRing()
+    {
+        io_uring_buf_reg reg{};
+        reg.bgid = m_GroupId;
+        registerRing(m_Ring.fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        ::munmap(m_BufRing, m_BufRingLen);
+    }
+
+    void BufferRing::recycle(u16 bufferId) noexcept
+    {
+        // Index the entries by hand: the flexible array member of `io_uring_buf_ring`
+        // does not get the C layout when compiled as C++. The ring tail overlays the
+        // `resv` field of the first entry.
+        auto *bufs = reinterpret_cast<io_uring_buf *>(m_BufRing);
+        u16 &ringTail = bufs[0].resv;
+
+        u16 tail = ringTail;
+        io_uring_buf &buf = bufs[tail & (m_Count - 1)];
+        buf.addr = reinterpret_cast<u64>(buffer(bufferId));
+        buf.len = m_BufferSize;
+        buf.bid = bufferId;
+        std::atomic_ref{ ringTail }.store(static_cast<u16>(tail + 1), std::memory_order_release);
+    }
+
+} // namespace my_redis::event::uring
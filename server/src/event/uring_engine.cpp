@@ -0,0 +1,435 @@
+#include "event/uring_engine.hpp"
+
+#include "aof.hpp"
+#include "db.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include "request.hpp"
+#include "snapshot.hpp"
+#include "util.hpp"
+
+#include <sys/socket.h>
+
+#include <cassert>
+
+namespace my_redis::event
+{
+    using namespace my_redis::types;
+
+    std::unique_ptr<UringEngine> UringEngine::create(shard::Shard &shard)
+    {
+        try
+        {
+            return std::unique_ptr<UringEngine>{ new UringEngine{ shard } };
+        }
+        catch (const exception::errno_exception &e)
+        {
+            LOG_WARN("io_uring is not available: %s", e.what());
+            return nullptr;
+        }
+    }
+
+    UringEngine::UringEngine(shard::Shard &shard)
+        : m_Shard(shard),
+          m_Ring(K_RING_ENTRIES),
+          m_BufferRing(m_Ring, K_BUFFER_GROUP, K_BUFFER_COUNT, K_BUFFER_SIZE)
+    {
+        armWakeup();
+    }
+
+    void UringEngine::addListener(sockets::ServerSocket &&listener)
+    {
+        armAccept(listener.fd());
+        m_Listeners.emplace_back(std::move(listener));
+    }
+
+    void UringEngine::run()
+    {
+        while (true)
+        {
+            shard::parkIfStopped(m_Shard);
+            shard::applyStatsReset(m_Shard);
+            snapshot::poll(m_Shard);
+            aof::flush(m_Shard);
+
+            // Expire keys, and make sure the ring wakes up when the next ones are due.
+            // An armed timeout is at most `K_MAX_EXPIRE_WAIT_MS` long, so it is simply
+            // left to fire even if an earlier TTL was set meanwhile.
+            db::activeExpire(m_Shard);
+            auto timeout = db::expireTimeout(m_Shard);
+            if (timeout > 0 && !m_TimeoutArmed)
+                armTimeout(timeout);
+
+            // Submit everything queued by the previous batch and wait for more work,
+            // unless expired keys are left over
+            auto result = m_Ring.submitAndWait(timeout == 0 ? 0 : 1);
+            if (result < 0 && result != -EINTR && result != -EBUSY)
+                throw exception::errno_exception{ "void UringEngine::run() -> io_uring_enter()", -result };
+
+            auto completions = m_Ring.forEachCqe([this](const io_uring_cqe &cqe) { handleCompletion(cqe); });
+            if (completions > 0)
+            {
+                m_Shard.loopStats.wakeups.add(1);
+                m_Shard.loopStats.readyPerWakeup.record(completions);
+            }
+        }
+    }
+
+    io_uring_sqe *UringEngine::getSqe()
+    {
+        io_uring_sqe *sqe = m_Ring.getSqe();
+        while (!sqe)
+        {
+            // Submission queue is full, hand the pending SQEs to the kernel
+            auto result = m_Ring.submitAndWait(0);
+            if (result < 0 && result != -EINTR && result != -EBUSY)
+                throw exception::errno_exception{ "io_uring_sqe *UringEngine::getSqe() -> io_uring_enter()", -result };
+
+            sqe = m_Ring.getSqe();
+        }
+        return sqe;
+    }
+
+    void UringEngine::armAccept(i32 fd)
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->ioprio = m_MultishotAccept ? IORING_ACCEPT_MULTISHOT : 0;
+        sqe->user_data = userData(fd, Op::ACCEPT);
+    }
+
+    void UringEngine::armWakeup()
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = m_Shard.mailbox.fd();
+        sqe->addr = reinterpret_cast<u64>(&m_WakeupCount);
+        sqe->len = sizeof(m_WakeupCount);
+        sqe->user_data = userData(m_Shard.mailbox.fd(), Op::WAKEUP);
+    }
+
+    void UringEngine::armTimeout(i32 timeoutMs)
+    {
+        m_Timeout.tv_sec = timeoutMs / 1000;
+        m_Timeout.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<u64>(&m_Timeout);
+        sqe->len = 1;
+        sqe->user_data = userData(0, Op::TIMEOUT);
+
+        m_TimeoutArmed = true;
+    }
+
+    void UringEngine::armRecv(UringConnection &uc)
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = uc.connection->fd();
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = m_BufferRing.groupId();
+        sqe->ioprio = m_MultishotRecv ? IORING_RECV_MULTISHOT : 0;
+        sqe->user_data = userData(uc.connection->fd(), Op::RECV);
+
+        uc.recvArmed = true;
+        uc.inFlight++;
+    }
+
+    // Pause or resume receiving as parsing does. A multishot recv is cancelled, otherwise
+    // it would keep filling the incoming buffer up to the limit that closes the connection.
+    void UringEngine::updateRecv(UringConnection &uc)
+    {
+        bool paused = readPaused(*uc.connection);
+        if (paused == uc.recvPaused || uc.closing)
+            return;
+
+        uc.recvPaused = paused;
+        if (!paused)
+        {
+            if (!uc.recvArmed)
+                armRecv(uc);
+            return;
+        }
+
+        if (uc.recvArmed && m_MultishotRecv)
+        {
+            io_uring_sqe *sqe = getSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = userData(uc.connection->fd(), Op::RECV);
+            sqe->user_data = userData(uc.connection->fd(), Op::CANCEL);
+        }
+    }
+
+    void UringEngine::flushOutput(UringConnection &uc)
+    {
+        Connection &connection = *uc.connection;
+        if (uc.sendInFlight || uc.closing)
+            return;
+
+        // Requests keep being parsed into `outgoingBuffer` while a send is in flight,
+        // so the send owns a separate buffer that is never touched until it completes.
+        if (uc.sending.empty())
+        {
+            if (connection.outgoingBuffer.empty())
+                return;
+            uc.sending.swap(connection.outgoingBuffer);
+        }
+        aof::beforeReply(m_Shard);
+
+        io_uring_sqe *sqe = getSqe();
+        sqe->fd = connection.fd();
+        sqe->msg_flags = MSG_NOSIGNAL;
+
+        // A plain send for contiguous bytes, sendmsg(2) to splice in the blobs of large values
+        auto count = uc.sending.gather(uc.iov.data(), uc.iov.size());
+        if (count == 1)
+        {
+            sqe->opcode = IORING_OP_SEND;
+            sqe->addr = reinterpret_cast<u64>(uc.iov[0].iov_base);
+            sqe->len = static_cast<u32>(uc.iov[0].iov_len);
+        }
+        else
+        {
+            uc.message = {};
+            uc.message.msg_iov = uc.iov.data();
+            uc.message.msg_iovlen = count;
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = reinterpret_cast<u64>(&uc.message);
+            sqe->len = 1;
+        }
+        sqe->user_data = userData(connection.fd(), Op::SEND);
+
+        uc.sendInFlight = true;
+        uc.inFlight++;
+    }
+
+    void UringEngine::startClose(UringConnection &uc)
+    {
+        if (!uc.closing)
+        {
+            uc.closing = true;
+            // Terminates the armed recv, so that every operation completes
+            // before the fd is closed and can be reused.
+            ::shutdown(uc.connection->fd(), SHUT_RDWR);
+        }
+
+        if (uc.inFlight == 0)
+        {
+            LOG_DEBUG("Client disconnected[fd %d]", uc.connection->fd());
+            m_Connections.at(uc.connection->fd()).reset(nullptr);
+        }
+    }
+
+    void UringEngine::handleCompletion(const io_uring_cqe &cqe)
+    {
+        auto fd = static_cast<i32>(cqe.user_data >> 8);
+        auto op = static_cast<Op>(cqe.user_data & 0xFF);
+
+        if (op == Op::ACCEPT)
+        {
+            handleAccept(fd, cqe);
+            return;
+        }
+
+        if (op == Op::WAKEUP)
+        {
+            drainMailbox();
+            armWakeup();
+            return;
+        }
+
+        // The recv completes on its own with -ECANCELED
+        if (op == Op::CANCEL)
+            return;
+
+        if (op == Op::TIMEOUT)
+        {
+            // -ETIME, the expiry cycle runs before waiting again
+            m_TimeoutArmed = false;
+            return;
+        }
+
+        auto &uc = m_Connections.at(fd);
+        assert(uc != nullptr);
+
+        if (op == Op::RECV)
+            handleRecv(*uc, cqe);
+        else
+            handleSend(*uc, cqe);
+    }
+
+    void UringEngine::handleAccept(i32 listenerFd, const io_uring_cqe &cqe)
+    {
+        if (cqe.res >= 0)
+        {
+            LOG_DEBUG("Accepted new client[fd %d]", cqe.res);
+
+            auto uc = std::make_unique<UringConnection>();
+            uc->connection = std::make_unique<Connection>(sockets::Socket{ cqe.res });
+            uc->connection->id = m_NextConnectionId++;
+            uc->connection->wantRead = true;
+            armRecv(*uc);
+
+            if (m_Connections.size() < static_cast<size>(cqe.res) + 1)
+                m_Connections.resize(cqe.res + 1);
+            m_Connections[cqe.res] = std::move(uc);
+        }
+        else if (cqe.res == -EINVAL && m_MultishotAccept)
+        {
+            // Kernel older than 5.19, fall back to re-arming a single shot accept
+            m_MultishotAccept = false;
+        }
+        else if (cqe.res != -EINTR && cqe.res != -EAGAIN)
+        {
+            LOG_ERROR("Failed to accept new client: %s", util::strerror(-cqe.res).c_str());
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+            armAccept(listenerFd);
+    }
+
+    void UringEngine::handleRecv(UringConnection &uc, const io_uring_cqe &cqe)
+    {
+        Connection &connection = *uc.connection;
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+        {
+            uc.recvArmed = false;
+            uc.inFlight--;
+        }
+
+        if (cqe.res > 0)
+        {
+            auto bufferId = static_cast<u16>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            connection.incomingBuffer.append(m_BufferRing.buffer(bufferId), cqe.res);
+            m_BufferRing.recycle(bufferId);
+            m_Shard.loopStats.bytesIn.add(static_cast<u64>(cqe.res));
+
+            if (!uc.closing)
+            {
+                // Pipeline processing of requests
+                u64 depth = 0;
+                while (tryParseRequest(connection, m_Shard))
+                    depth++;
+                m_Shard.loopStats.pipelineDepth.record(depth);
+
+                if (connection.wantClose)
+                {
+                    startClose(uc);
+                    return;
+                }
+
+                flushOutput(uc);
+                updateRecv(uc);
+            }
+        }
+        else if (cqe.res == -EINVAL && m_MultishotRecv)
+        {
+            // Kernel older than 6.0, fall back to re-arming a single shot recv
+            m_MultishotRecv = false;
+        }
+        else if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED)
+        {
+            // EOF, error, or the shutdown issued by `startClose()`
+            if (cqe.res < 0 && !uc.closing)
+                LOG_WARN("void UringEngine::handleRecv() -> recv() : %s", util::strerror(-cqe.res).c_str());
+            else if (cqe.res == 0 && connection.incomingBuffer.size() != 0)
+                LOG_WARN("Unexpected EOF(incomingBuffer size %zu)", connection.incomingBuffer.size());
+
+            startClose(uc);
+            return;
+        }
+
+        if (uc.closing)
+        {
+            // Completes the close if this was the last operation in flight
+            startClose(uc);
+            return;
+        }
+
+        // On -ENOBUFS every provided buffer was in use. Simply re-arm, the
+        // buffers are recycled as soon as their data has been copied. A paused
+        // connection is re-armed by `updateRecv()` once parsing resumes.
+        if (!uc.recvArmed && !uc.recvPaused)
+            armRecv(uc);
+    }
+
+    void UringEngine::handleSend(UringConnection &uc, const io_uring_cqe &cqe)
+    {
+        uc.sendInFlight = false;
+        uc.inFlight--;
+
+        if (cqe.res < 0)
+        {
+            if (!uc.closing)
+                LOG_WARN("void UringEngine::handleSend() -> send() : %s", util::strerror(-cqe.res).c_str());
+            startClose(uc);
+            return;
+        }
+
+        if (uc.closing)
+        {
+            startClose(uc);
+            return;
+        }
+
+        uc.sending.consume(cqe.res);
+        m_Shard.loopStats.bytesOut.add(static_cast<u64>(cqe.res));
+
+        // Requests left unparsed while the replies were over the buffer limit
+        Connection &connection = *uc.connection;
+        if (!connection.incomingBuffer.empty())
+        {
+            while (tryParseRequest(connection, m_Shard))
+                ;
+            if (connection.wantClose)
+            {
+                startClose(uc);
+                return;
+            }
+        }
+        flushOutput(uc);
+        updateRecv(uc);
+    }
+
+    void UringEngine::drainMailbox()
+    {
+        m_Shard.mailbox.acknowledge();
+
+        while (shard::Message *message = m_Shard.mailbox.pop())
+        {
+            if (message->kind == shard::Message::Kind::REQUEST)
+            {
+                executeForwarded(m_Shard, *message);
+                continue;
+            }
+
+            std::unique_ptr<shard::Message> reply{ message };
+
+            // The client may have disconnected in the meantime
+            if (reply->fd >= static_cast<i32>(m_Connections.size()))
+                continue;
+
+            auto &uc = m_Connections[reply->fd];
+            if (!uc || uc->closing || uc->connection->id != reply->connectionId)
+                continue;
+
+            Connection &connection = *uc->connection;
+            deliverReply(connection, *reply);
+            while (tryParseRequest(connection, m_Shard))
+                ;
+
+            if (connection.wantClose)
+                startClose(*uc);
+            else
+            {
+                flushOutput(*uc);
+                updateRecv(*uc);
+            }
+        }
+    }
+} // namespace my_redis::event
@@ -0,0 +1,306 @@
+#include "evict.hpp"
+
+#include "aof.hpp"
+#include "blob.hpp"
+#include "buffer.hpp"
+#include "command.hpp"
+#include "db.hpp"
+#include "keyspace.hpp"
+#include "lazyfree.hpp"
+#include "log.hpp"
+#include "shard.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace my_redis::evict
+{
+    using namespace my_redis::types;
+    using entry::Entry;
+
+    namespace
+    {
+        // Keys scored per refill of the pool, and refills tried on a sparse table
+        constexpr size K_SAMPLES = 5;
+        constexpr size K_MAX_REFILLS = 8;
+
+        // LFU: new keys start above 0 so that they are not evicted before a second access,
+        // and the counter is halved in probability at every step (about 1M hits saturate it)
+        constexpr u8 K_LFU_INIT = 5;
+        constexpr u32 K_LFU_LOG_FACTOR = 10;
+        constexpr u32 K_LFU_MINUTES_MASK = 0xFFFFFF;   // The minutes take the 24 bits above the counter
+
+        // Written once by `configure()` before the loops start
+        size g_maxMemory = 0;
+        Policy g_policy = Policy::NOEVICTION;
+        bool g_tracking = false;    // An LRU or LFU limit is set, accesses are recorded
+
+        u64 coarseSeconds() noexcept
+        {
+            timespec now{};
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+            return static_cast<u64>(now.tv_sec);
+        }
+
+        u64 next(u64 &state) noexcept
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+
+        u32 lruClock() noexcept
+        {
+            return static_cast<u32>(coarseSeconds());
+        }
+
+        u32 lfuMinutes() noexcept
+        {
+            return static_cast<u32>(coarseSeconds() / 60) & K_LFU_MINUTES_MASK;
+        }
+
+        // Counter of an LFU entry once decayed by one per idle minute
+        u8 lfuCounter(u32 access, u32 minutes) noexcept
+        {
+            u8 counter = static_cast<u8>(access & 0xFF);
+            u32 idle = (minutes - (access >> 8)) & K_LFU_MINUTES_MASK;
+            return counter > idle ? static_cast<u8>(counter - idle) : 0;
+        }
+
+        u32 lfuPack(u32 minutes, u8 counter) noexcept
+        {
+            return (minutes << 8) | counter;
+        }
+
+        u64 score(const Entry *entry) noexcept
+        {
+            if (g_policy == Policy::ALLKEYS_LRU)
+                return lruClock() - entry->access;
+            return 0xFF - lfuCounter(entry->access, lfuMinutes());
+        }
+
+        // Keep the candidates sorted by score, a full pool drops its worst one
+        void offer(Pool &pool, u64 score, const Entry *entry)
+        {
+            auto begin = pool.candidates.begin();
+            auto end = begin + static_cast<std::ptrdiff_t>(pool.count);
+            u64 hash = entry->node.hash;
+            std::string_view key = entry->key();
+
+            if (std::any_of(begin, end, [&](const Pool::Candidate &c) { return c.hash == hash && c.key == key; }))
+                return;
+
+            if (pool.count == Pool::K_SIZE)
+            {
+                if (score <= begin->score)
+                    return;
+                std::move(begin + 1, end, begin);
+                --end;
+                pool.count--;
+            }
+
+            auto at = std::upper_bound(begin, end, score, [](u64 s, const Pool::Candidate &c) { return s < c.score; });
+            std::move_backward(at, end, end + 1);
+            at->score = score;
+            at->hash = hash;
+            at->key.assign(key);
+            pool.count++;
+        }
+
+        void refill(shard::Shard &shard, Pool &pool)
+        {
+            Entry *sampled[K_SAMPLES];
+            size count = keyspace::sample(shard.db, next(pool.random), sampled, K_SAMPLES);
+            for (size i = 0; i < count; ++i)
+                offer(pool, score(sampled[i]), sampled[i]);
+        }
+
+        Entry *nextVictim(shard::Shard &shard)
+        {
+            if (g_policy == Policy::VOLATILE_TTL)
+                return shard.expires.empty() ? nullptr : shard.expires.top();
+
+            if (keyspace::size(shard.db) == 0)
+                return nullptr;
+
+            Pool &pool = shard.evictionPool;
+            for (size refills = 0; refills < K_MAX_REFILLS; ++refills)
+            {
+                refill(shard, pool);
+                while (pool.count > 0)
+                {
+                    Pool::Candidate &best = pool.candidates[--pool.count];
+                    // The key may have been deleted, or evicted, since it was sampled
+                    if (Entry *found = keyspace::lookup(shard.db, best.hash, best.key))
+                        return found;
+                }
+            }
+            return nullptr;
+        }
+
+        void evictEntry(shard::Shard &shard, Entry *victim)
+        {
+            // Replicate the eviction to the log as a DEL, before the key is freed
+            if (aof::enabled())
+            {
+                static const command::Command *del = command::lookup("del");
+                protocol::Args args;
+                args.push_back("del");
+                args.push_back(victim->key());
+                aof::feed(shard, *del, args, victim->node.hash);
+            }
+            db::erase(shard, victim);
+        }
+
+        // Blobs and I/O buffers are counted process-wide. The blobs handed over to the
+        // lazyfree thread are as good as freed, counting them would evict more keys meanwhile.
+        size sharedBytes() noexcept
+        {
+            size blobs = blob::allocatedBytes();
+            return blobs - std::min(lazyfree::pendingBytes(), blobs) + buffer::allocatedBytes();
+        }
+
+        size usedMemory() noexcept
+        {
+            size used = sharedBytes();
+            for (u32 i = 0; i < shard::count(); ++i)
+                used += shard::at(i).memoryUsed.load(std::memory_order_relaxed);
+            return used;
+        }
+    } // namespace
+
+    std::optional<Policy> parsePolicy(std::string_view name) noexcept
+    {
+        if (name == "noeviction")
+            return Policy::NOEVICTION;
+        if (name == "allkeys-lru")
+            return Policy::ALLKEYS_LRU;
+        if (name == "allkeys-lfu")
+            return Policy::ALLKEYS_LFU;
+        if (name == "volatile-ttl")
+            return Policy::VOLATILE_TTL;
+        return std::nullopt;
+    }
+
+    std::string_view policyName(Policy policy) noexcept
+    {
+        switch (policy)
+        {
+            case Policy::NOEVICTION:
+                return "noeviction";
+            case Policy::ALLKEYS_LRU:
+                return "allkeys-lru";
+            case Policy::ALLKEYS_LFU:
+                return "allkeys-lfu";
+            case Policy::VOLATILE_TTL:
+                return "volatile-ttl";
+        }
+        return "unknown";
+    }
+
+    void configure(size maxMemory, Policy policy)
+    {
+        g_maxMemory = maxMemory;
+        g_policy = policy;
+        g_tracking = maxMemory != 0 && (policy == Policy::ALLKEYS_LRU || policy == Policy::ALLKEYS_LFU);
+
+        for (u32 i = 0; i < shard::count(); ++i)
+        {
+            shard::Shard &shard = shard::at(i);
+            shard.evictionPool.random ^= (static_cast<u64>(i) + 1) * 0xBF58476D1CE4E5B9;
+            // The keys loaded from the snapshot or the log count as just accessed
+            if (g_tracking)
+                keyspace::forEach(shard.db, [](Entry *entry) { init(entry); });
+            account(shard);
+        }
+
+        if (maxMemory)
+            LOG_INFO("Memory limited to %zu bytes, %zu used, policy %s", maxMemory, usedMemory(), policyName(policy).data());
+    }
+
+    void init(Entry *entry) noexcept
+    {
+        if (!g_tracking)
+            return;
+        entry->access = g_policy == Policy::ALLKEYS_LRU ? lruClock() : lfuPack(lfuMinutes(), K_LFU_INIT);
+    }
+
+    void touch(Entry *entry) noexcept
+    {
+        if (!g_tracking)
+            return;
+
+        if (g_policy == Policy::ALLKEYS_LRU)
+        {
+            entry->access = lruClock();
+            return;
+        }
+
+        // Logarithmic increment: the higher the counter, the less likely it grows
+        thread_local u64 random = 0x2545F4914F6CDD1D ^ reinterpret_cast<uintptr_t>(&random);
+        u32 minutes = lfuMinutes();
+        u8 counter = lfuCounter(entry->access, minutes);
+        if (counter < 0xFF)
+        {
+            double base = counter > K_LFU_INIT ? counter - K_LFU_INIT : 0;
+            double chance = static_cast<double>(next(random) >> 11) * 0x1.0p-53;
+            if (chance < 1.0 / (base * K_LFU_LOG_FACTOR + 1))
+                counter++;
+        }
+        entry->access = lfuPack(minutes, counter);
+    }
+
+    void account(shard::Shard &shard) noexcept
+    {
+        size bytes = shard.allocator.allocatedBytes() + keyspace::tableBytes(shard.db) + shard.expires.memoryBytes() + shard.objectBytes;
+        shard.memoryUsed.store(bytes, std::memory_order_relaxed);
+    }
+
+    bool beforeWrite(shard::Shard &shard)
+    {
+        if (g_maxMemory == 0)
+            return true;
+
+        account(shard);
+        if (usedMemory() <= g_maxMemory)
+            return true;
+        if (g_policy == Policy::NOEVICTION)
+            return false;
+
+        // Only the keys of this shard can be evicted from here. Keys hash evenly over the
+        // shards, so each one only evicts down to its share of the limit: the shard writing
+        // most often would otherwise drain itself for the others, hot keys included.
+        size shared = sharedBytes();
+        size share = g_maxMemory > shared ? (g_maxMemory - shared) / shard::count() : 0;
+
+        size evicted = 0;
+        bool under = false;
+        while (evicted < K_MAX_EVICTIONS && shard.memoryUsed.load(std::memory_order_relaxed) > share)
+        {
+            Entry *victim = nextVictim(shard);
+            if (!victim)
+                break;
+
+            evictEntry(shard, victim);
+            evicted++;
+            account(shard);
+            if ((under = usedMemory() <= g_maxMemory))
+                break;
+        }
+
+        shard.evictedKeys.add(evicted);
+        // Within its share, the shard leaves the excess to the others' next writes
+        return under || evicted > 0 || shard.memoryUsed.load(std::memory_order_relaxed) <= share;
+    }
+
+    Status status() noexcept
+    {
+        u64 evictedKeys = 0;
+        for (u32 i = 0; i < shard::count(); ++i)
+            evictedKeys += shard::at(i).evictedKeys.value();
+        return { usedMemory(), g_maxMemory, g_policy, evictedKeys };
+    }
+} // namespace my_redis::evict
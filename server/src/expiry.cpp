@@ -0,0 +1,82 @@
+#include "expiry.hpp"
+
+#include <cassert>
+
+namespace my_redis::expiry
+{
+    // Member definitions spell out `types::size`, which `Heap::size()` shadows
+
+    void Heap::push(entry::Entry *entry)
+    {
+        assert(entry->expiry() != nullptr);
+
+        m_Nodes.push_back({ entry->expiry()->expireAt, entry });
+        entry->expiry()->heapIndex = m_Nodes.size() - 1;
+        siftUp(m_Nodes.size() - 1);
+    }
+
+    void Heap::remove(entry::Entry *entry) noexcept
+    {
+        types::size i = entry->expiry()->heapIndex;
+        assert(i < m_Nodes.size() && m_Nodes[i].entry == entry);
+
+        Node last = m_Nodes.back();
+        m_Nodes.pop_back();
+        if (i == m_Nodes.size())
+            return;
+
+        // Move the last node into the hole, then restore the order in whichever direction
+        place(i, last);
+        siftUp(i);
+        siftDown(last.entry->expiry()->heapIndex);
+    }
+
+    void Heap::update(entry::Entry *entry) noexcept
+    {
+        types::size i = entry->expiry()->heapIndex;
+        assert(i < m_Nodes.size() && m_Nodes[i].entry == entry);
+
+        m_Nodes[i].expireAt = entry->expiry()->expireAt;
+        siftUp(i);
+        siftDown(entry->expiry()->heapIndex);
+    }
+
+    void Heap::place(types::size i, const Node &node) noexcept
+    {
+        m_Nodes[i] = node;
+        node.entry->expiry()->heapIndex = i;
+    }
+
+    void Heap::siftUp(types::size i) noexcept
+    {
+        Node node = m_Nodes[i];
+        while (i > 0)
+        {
+            types::size parent = (i - 1) / 2;
+            if (m_Nodes[parent].expireAt <= node.expireAt)
+                break;
+            place(i, m_Nodes[parent]);
+            i = parent;
+        }
+        place(i, node);
+    }
+
+    void Heap::siftDown(types::size i) noexcept
+    {
+        Node node = m_Nodes[i];
+        types::size count = m_Nodes.size();
+        while (true)
+        {
+            types::size child = 2 * i + 1;
+            if (child >= count)
+                break;
+            if (child + 1 < count && m_Nodes[child + 1].expireAt < m_Nodes[child].expireAt)
+                child++;
+            if (node.expireAt <= m_Nodes[child].expireAt)
+                break;
+            place(i, m_Nodes[child]);
+            i = child;
+        }
+        place(i, node);
+    }
+} // namespace my_redis::expiry
@@ -0,0 +1,27 @@
+#include "hash.hpp"
+
+#include <sys/random.h>
+
+#include <chrono>
+
+namespace my_redis::hash
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        u64 randomSeed() noexcept
+        {
+            u64 seed = 0;
+            if (::getrandom(&seed, sizeof(seed), GRND_NONBLOCK) == sizeof(seed))
+                return seed;
+
+            // Entropy pool not ready yet, which only happens very early at boot
+            auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+            return wyhash(reinterpret_cast<const u8 *>(&now), sizeof(now), reinterpret_cast<uintptr_t>(&seed));
+        }
+    } // namespace
+
+    extern const u64 g_seed = randomSeed();
+
+} // namespace my_redis::hash
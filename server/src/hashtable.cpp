@@ -1,5 +1,6 @@
 #include "hashtable.hpp"
 #include "types.hpp"
+#include <algorithm>
 #include <cstdlib>
 
 namespace my_redis
@@ -29,26 +30,40 @@ namespace my_redis
             hashTable->size++;
         }
 
-        HashNode **lookup(HashTable *hashTable, HashNode *key, CompareFn cmp) noexcept
+        namespace
         {
-            if (!hashTable->table)
-                return nullptr;
-
             // To make node removal easier, return an address of `next` pointer of the parent node
-            size pos = key->hash & hashTable->mask;
-            HashNode **head = &hashTable->table[pos];
-            HashNode **pNext = head;
-            
-            for (
-                HashNode *curr = nullptr;
-                (curr = *pNext) != nullptr; // Move to the next node
-                pNext = &curr->next         // Update the pointer to the address of next node pointer
-            )
+            template <typename Eq>
+            HashNode **lookupIf(HashTable *hashTable, u64 hash, Eq &&eq) noexcept
             {
-                if (curr->hash == key->hash && cmp(curr, key))
-                    return pNext;
+                if (!hashTable->table)
+                    return nullptr;
+
+                size pos = hash & hashTable->mask;
+                HashNode **head = &hashTable->table[pos];
+                HashNode **pNext = head;
+
+                for (
+                    HashNode *curr = nullptr;
+                    (curr = *pNext) != nullptr; // Move to the next node
+                    pNext = &curr->next         // Update the pointer to the address of next node pointer
+                )
+                {
+                    if (curr->hash == hash && eq(curr))
+                        return pNext;
+                }
+                return nullptr;
             }
-            return nullptr;
+        } // namespace
+
+        HashNode **lookup(HashTable *hashTable, HashNode *key, CompareFn cmp) noexcept
+        {
+            return lookupIf(hashTable, key->hash, [&](HashNode *node) { return cmp(node, key); });
+        }
+
+        HashNode **lookup(HashTable *hashTable, u64 hash, std::string_view key, KeyCompareFn cmp) noexcept
+        {
+            return lookupIf(hashTable, hash, [&](HashNode *node) { return cmp(node, key); });
         }
 
         HashNode *detach(HashTable *hashTable, HashNode **from) noexcept
@@ -148,5 +163,97 @@ namespace my_redis
 
             return nullptr;
         }
+
+        HashNode *lookup(HashMap *map, u64 hash, std::string_view key, KeyCompareFn cmp) noexcept
+        {
+            helpRehash(map);
+
+            HashNode **from = hashtable::lookup(&map->newer, hash, key, cmp);
+            if (!from)
+                from = hashtable::lookup(&map->older, hash, key, cmp);
+            return from ? *from : nullptr;
+        }
+
+        HashNode *remove(HashMap *map, u64 hash, std::string_view key, KeyCompareFn cmp) noexcept
+        {
+            helpRehash(map);
+
+            if (HashNode **from = hashtable::lookup(&map->newer, hash, key, cmp))
+                return hashtable::detach(&map->newer, from);
+
+            if (HashNode **from = hashtable::lookup(&map->older, hash, key, cmp))
+                return hashtable::detach(&map->older, from);
+
+            return nullptr;
+        }
+
+        void clear(HashMap *map) noexcept
+        {
+            std::free(map->newer.table);
+            std::free(map->older.table);
+            *map = {};
+        }
+
+        void reserve(HashMap *map, size n) noexcept
+        {
+            assert(map->newer.size == 0 && map->older.table == nullptr);
+
+            // The smallest power of 2 keeping the load factor under the threshold
+            size buckets = 4;
+            while (buckets * K_MAX_LOAD_FACTOR <= n)
+                buckets *= 2;
+
+            if (map->newer.bucketCount() >= buckets && map->newer.table)
+                return;
+            std::free(map->newer.table);
+            hashtable::init(&map->newer, buckets);
+        }
+
+        size sample(const HashMap *map, u64 random, HashNode **out, size n) noexcept
+        {
+            size count = 0;
+            for (const HashTable *tbl : { &map->newer, &map->older })
+            {
+                if (!tbl->table || tbl->size == 0)
+                    continue;
+
+                size pos = random & tbl->mask;
+                size steps = std::min(tbl->bucketCount(), n * 10);
+                for (size step = 0; step < steps && count < n; ++step)
+                {
+                    for (HashNode *node = tbl->table[(pos + step) & tbl->mask]; node && count < n; node = node->next)
+                        out[count++] = node;
+                }
+            }
+            return count;
+        }
+
+        u64 scan(const HashMap *map, u64 cursor, std::vector<HashNode *> &out)
+        {
+            const HashTable *large = &map->newer;
+            const HashTable *small = map->older.table ? &map->older : &map->newer;
+            if (!large->table)
+                return 0;
+            assert(small->mask <= large->mask);
+
+            return hashtable::scanBuckets(cursor, small->mask, large->mask, [&](bool inLarge, size bucket) {
+                for (HashNode *node = (inLarge ? large : small)->table[bucket]; node; node = node->next)
+                    out.push_back(node);
+            });
+        }
+
+        void replace(HashMap *map, HashNode *from, HashNode *to) noexcept
+        {
+            assert(from->hash == to->hash);
+
+            auto same = [from](HashNode *node) { return node == from; };
+            HashNode **slot = hashtable::lookupIf(&map->newer, from->hash, same);
+            if (!slot)
+                slot = hashtable::lookupIf(&map->older, from->hash, same);
+
+            assert(slot != nullptr);
+            to->next = from->next;
+            *slot = to;
+        }
     } // namespace hashmap
 } // namespace my_redis
\ No newline at end of file
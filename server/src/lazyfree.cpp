@@ -0,0 +1,153 @@
+#include "lazyfree.hpp"
+
+#include "log.hpp"
+#include "mpsc_queue.hpp"
+#include "stats.hpp"
+#include "zset.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <stop_token>
+#include <thread>
+
+namespace my_redis::lazyfree
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        // A value handed over, a job with neither only wakes the thread up
+        struct Job
+        {
+            mpsc::Node node;
+            zset::ZSet *set = nullptr;
+            blob::Blob *blob = nullptr;
+            size bytes = 0;             // Of `blob`, as counted by `blob::allocatedBytes()`
+        };
+
+        mpsc::Queue g_queue;
+        // Pushed and not freed yet. Bumped after the push, so a count seen by the
+        // thread always has its job in the queue.
+        std::atomic<u64> g_pending{ 0 };
+        std::atomic<size> g_pendingBytes{ 0 };
+        stats::Counter g_freed;         // Written by the thread only
+
+        bool g_enabled = false;         // Written once by `start()`
+        bool g_running = false;
+        std::jthread g_thread;
+
+        Job *pop() noexcept
+        {
+            mpsc::Node *node = g_queue.pop();
+            return node ? reinterpret_cast<Job *>(reinterpret_cast<u8 *>(node) - offsetof(Job, node)) : nullptr;
+        }
+
+        void push(Job *job) noexcept
+        {
+            g_queue.push(&job->node);
+            g_pending.fetch_add(1, std::memory_order_release);
+            g_pending.notify_one();
+        }
+
+        void backgroundLoop(std::stop_token stop)
+        {
+            while (true)
+            {
+                if (g_pending.load(std::memory_order_acquire) == 0)
+                {
+                    if (stop.stop_requested())
+                        return;
+                    g_pending.wait(0, std::memory_order_acquire);
+                    continue;
+                }
+
+                Job *job = pop();
+                if (job->set || job->blob)
+                {
+                    delete job->set;
+                    if (job->blob)
+                    {
+                        blob::release(job->blob);
+                        g_pendingBytes.fetch_sub(job->bytes, std::memory_order_relaxed);
+                    }
+                    g_freed.add(1);
+                }
+                delete job;
+                g_pending.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+    } // namespace
+
+    void start(bool enabled)
+    {
+        g_enabled = enabled;
+        g_running = true;
+        g_thread = std::jthread{ backgroundLoop };
+    }
+
+    void stop()
+    {
+        if (!g_running)
+            return;
+
+        // Everything still queued is freed before the thread exits
+        g_thread.request_stop();
+        push(new Job{});
+        g_thread.join();
+        g_running = false;
+    }
+
+    bool enabled() noexcept
+    {
+        return g_enabled;
+    }
+
+    bool worthIt(const zset::ZSet *set) noexcept
+    {
+        return zset::length(set) > K_MIN_ZSET_MEMBERS;
+    }
+
+    bool worthIt(const blob::Blob *blob) noexcept
+    {
+        return blob->length >= K_MIN_BLOB_BYTES;
+    }
+
+    void free(zset::ZSet *set)
+    {
+        // Without the thread, e.g. once it stopped, in place
+        if (!g_running)
+        {
+            delete set;
+            return;
+        }
+
+        auto *job = new Job{};
+        job->set = set;
+        push(job);
+    }
+
+    void release(blob::Blob *blob)
+    {
+        if (!g_running)
+        {
+            blob::release(blob);
+            return;
+        }
+
+        auto *job = new Job{};
+        job->blob = blob;
+        job->bytes = sizeof(blob::Blob) + blob->length;
+        g_pendingBytes.fetch_add(job->bytes, std::memory_order_relaxed);
+        push(job);
+    }
+
+    size pendingBytes() noexcept
+    {
+        return g_pendingBytes.load(std::memory_order_relaxed);
+    }
+
+    Status status() noexcept
+    {
+        return { g_pending.load(std::memory_order_relaxed), g_freed.value() };
+    }
+} // namespace my_redis::lazyfree
@@ -0,0 +1,278 @@
+#include "log.hpp"
+
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis::types;
+    using my_redis::log::Level;
+
+    constexpr size K_RECORD_SIZE = 256;
+    constexpr size K_RING_RECORDS = 1024;   // Power of 2
+    constexpr auto K_DRAIN_INTERVAL = std::chrono::milliseconds{ 10 };
+
+    struct Record
+    {
+        i64 timeNs;
+        Level level;
+        u16 len;
+        char text[K_RECORD_SIZE - 12];
+    };
+    static_assert(sizeof(Record) == K_RECORD_SIZE);
+
+    // Single-producer single-consumer ring, written by one thread and drained by the logger
+    struct Ring
+    {
+        alignas(64) std::atomic<u64> head{ 0 };     // Next record to drain, owned by the logger
+        alignas(64) std::atomic<u64> tail{ 0 };     // Next record to write, owned by the thread
+        std::atomic<u64> dropped{ 0 };
+        u32 thread = 0;
+        Record records[K_RING_RECORDS];
+    };
+
+    // Rings are never freed: threads are few and live as long as the server
+    std::mutex g_ringsMutex;
+    std::vector<std::unique_ptr<Ring>> g_rings;
+    thread_local Ring *t_ring = nullptr;
+
+    std::thread g_logger;
+    std::atomic<bool> g_running{ false };
+    std::mutex g_wakeMutex;
+    std::condition_variable g_wake;
+
+    constexpr const char *levelName(Level level) noexcept
+    {
+        switch (level)
+        {
+        case Level::DEBUG:  return "DEBUG";
+        case Level::INFO:   return "INFO ";
+        case Level::WARN:   return "WARN ";
+        case Level::ERROR:  return "ERROR";
+        default:            return "?    ";
+        }
+    }
+
+    i64 nowNs() noexcept
+    {
+        timespec ts{};
+        ::clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<i64>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+
+    Ring &threadRing()
+    {
+        if (!t_ring)
+        {
+            std::lock_guard lock{ g_ringsMutex };
+            g_rings.emplace_back(std::make_unique<Ring>());
+            g_rings.back()->thread = static_cast<u32>(g_rings.size() - 1);
+            t_ring = g_rings.back().get();
+        }
+        return *t_ring;
+    }
+
+    // Format `text` into `record`, with the suppression notice of the rate limiter
+    void fill(Record &record, Level level, u32 suppressed, const char *format, va_list args) noexcept
+    {
+        record.timeNs = nowNs();
+        record.level = level;
+
+        auto n = std::vsnprintf(record.text, sizeof(record.text), format, args);
+        size len = n < 0 ? 0 : std::min(static_cast<size>(n), sizeof(record.text) - 1);
+        if (suppressed > 0 && len < sizeof(record.text) - 1)
+        {
+            n = std::snprintf(record.text + len, sizeof(record.text) - len, " (%u similar messages suppressed)", suppressed);
+            len = n < 0 ? len : std::min(len + static_cast<size>(n), sizeof(record.text) - 1);
+        }
+        record.len = static_cast<u16>(len);
+    }
+
+    void appendLine(std::string &out, const Record &record, u32 thread)
+    {
+        time_t seconds = static_cast<time_t>(record.timeNs / 1'000'000'000);
+        tm local{};
+        ::localtime_r(&seconds, &local);
+
+        char prefix[64];
+        auto n = std::snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03lld [%u] %s ",
+                               local.tm_hour, local.tm_min, local.tm_sec,
+                               static_cast<long long>(record.timeNs / 1'000'000 % 1000), thread, levelName(record.level));
+        out.append(prefix, static_cast<size>(n));
+        out.append(record.text, record.len);
+        out.push_back('\n');
+    }
+
+    void writeAll(const std::string &out) noexcept
+    {
+        size written = 0;
+        while (written < out.size())
+        {
+            auto n = ::write(STDERR_FILENO, out.data() + written, out.size() - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return;
+            written += static_cast<size>(n);
+        }
+    }
+
+    // Move every buffered record to stderr with a single write
+    void drain(std::string &out)
+    {
+        {
+            std::lock_guard lock{ g_ringsMutex };
+            for (auto &ring : g_rings)
+            {
+                u64 head = ring->head.load(std::memory_order_relaxed);
+                u64 tail = ring->tail.load(std::memory_order_acquire);
+                for (; head != tail; ++head)
+                    appendLine(out, ring->records[head & (K_RING_RECORDS - 1)], ring->thread);
+                ring->head.store(head, std::memory_order_release);
+
+                if (auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed))
+                {
+                    Record notice{ .timeNs = nowNs(), .level = Level::WARN, .len = 0, .text = {} };
+                    auto n = std::snprintf(notice.text, sizeof(notice.text), "%llu messages dropped, the log ring was full",
+                                           static_cast<unsigned long long>(dropped));
+                    notice.len = static_cast<u16>(n);
+                    appendLine(out, notice, ring->thread);
+                }
+            }
+        }
+
+        writeAll(out);
+        out.clear();
+    }
+
+    void run()
+    {
+        std::string out;
+        out.reserve(64 * 1024);
+
+        std::unique_lock lock{ g_wakeMutex };
+        while (g_running.load(std::memory_order_relaxed))
+        {
+            lock.unlock();
+            drain(out);
+            lock.lock();
+            g_wake.wait_for(lock, K_DRAIN_INTERVAL, [] { return !g_running.load(std::memory_order_relaxed); });
+        }
+        lock.unlock();
+
+        drain(out);
+    }
+} // namespace
+
+namespace my_redis::log
+{
+    namespace detail
+    {
+        std::atomic<Level> g_level{ Level::INFO };
+    }
+
+    std::optional<Level> parseLevel(std::string_view name) noexcept
+    {
+        if (name == "debug")
+            return Level::DEBUG;
+        if (name == "info")
+            return Level::INFO;
+        if (name == "warn")
+            return Level::WARN;
+        if (name == "error")
+            return Level::ERROR;
+        if (name == "off")
+            return Level::OFF;
+        return std::nullopt;
+    }
+
+    void setLevel(Level level) noexcept
+    {
+        detail::g_level.store(level, std::memory_order_relaxed);
+    }
+
+    void start()
+    {
+        g_running.store(true, std::memory_order_relaxed);
+        g_logger = std::thread{ run };
+    }
+
+    void stop()
+    {
+        if (!g_logger.joinable())
+            return;
+
+        {
+            std::lock_guard lock{ g_wakeMutex };
+            g_running.store(false, std::memory_order_relaxed);
+        }
+        g_wake.notify_one();
+        g_logger.join();
+    }
+
+    bool RateLimit::allow(u32 &suppressed) noexcept
+    {
+        timespec ts{};
+        ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        if (ts.tv_sec != m_Window)
+        {
+            m_Window = ts.tv_sec;
+            m_Count = 0;
+        }
+
+        if (m_Count >= K_BURST)
+        {
+            m_Suppressed++;
+            return false;
+        }
+
+        m_Count++;
+        suppressed = std::exchange(m_Suppressed, 0);
+        return true;
+    }
+
+    void write(Level level, u32 suppressed, const char *format, ...) noexcept
+    {
+        va_list args;
+        va_start(args, format);
+
+        if (!g_running.load(std::memory_order_relaxed))
+        {
+            // No logger thread, e.g. during startup
+            Record record;
+            fill(record, level, suppressed, format, args);
+            va_end(args);
+
+            std::string out;
+            appendLine(out, record, t_ring ? t_ring->thread : 0);
+            writeAll(out);
+            return;
+        }
+
+        Ring &ring = threadRing();
+        u64 tail = ring.tail.load(std::memory_order_relaxed);
+        if (tail - ring.head.load(std::memory_order_acquire) >= K_RING_RECORDS)
+        {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            va_end(args);
+            return;
+        }
+
+        fill(ring.records[tail & (K_RING_RECORDS - 1)], level, suppressed, format, args);
+        va_end(args);
+        ring.tail.store(tail + 1, std::memory_order_release);
+    }
+} // namespace my_redis::log
@@ -1,13 +1,90 @@
+#include "aof.hpp"
+#include "config.hpp"
 #include "event/event_loop.hpp"
+#include "evict.hpp"
+#include "lazyfree.hpp"
+#include "log.hpp"
+#include "request.hpp"
+#include "shard.hpp"
+#include "snapshot.hpp"
 #include "socket.hpp"
 
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis;
+
+    void runEventLoop(const config::Config &config, shard::Shard &shard, const sockets::ServerSocket *unixListener)
+    {
+        std::vector<sockets::ServerSocket> listeners;
+        // Every loop has its own TCP listener, the kernel spreads connections between them
+        if (config.endpoint.port != 0)
+            listeners.emplace_back(config.endpoint, config.threads > 1, config.listenOptions);
+        // A unix socket path cannot be shared with SO_REUSEPORT, the loops accept from one socket
+        if (unixListener)
+            listeners.push_back(unixListener->duplicate());
+
+        event::EventLoop eventLoop{std::move(listeners), config.engine, config.poller, shard};
+        eventLoop.run();
+    }
+} // namespace
+
 int main(int argc, char *argv[])
 {
     using namespace my_redis;
 
-    sockets::Endpoint ep{"127.0.0.1", 9999};
-    sockets::ServerSocket server{ep};
+    auto config = config::parseArgs(argc, argv);
+    if (!config)
+    {
+        config::printUsage(argv[0]);
+        return 1;
+    }
+
+    log::setLevel(config->logLevel);
+    log::start();
+    setBufferLimit(config->bufferLimit);
+    setMaxValueSize(config->maxValueSize);
+
+    shard::init(config->threads);
+    lazyfree::start(config->lazyFree);
+
+    // The append-only log is more recent than any snapshot, a missing one is created
+    // from the snapshot
+    snapshot::init(config->snapshotPath);
+    bool useAof = !config->aofPath.empty();
+    bool loaded = useAof && aof::exists(config->aofPath) ? aof::replay(config->aofPath) : snapshot::load();
+    if (!loaded || (useAof && !aof::start(config->aofPath, config->aofFsync)))
+    {
+        lazyfree::stop();
+        log::stop();
+        return 1;
+    }
+    evict::configure(config->maxMemory, config->maxMemoryPolicy);
+
+    std::optional<sockets::ServerSocket> unixListener;
+    if (!config->unixSocket.empty())
+    {
+        unixListener.emplace(sockets::UnixEndpoint{ config->unixSocket.c_str() }, config->listenOptions);
+        LOG_INFO("Listening on unix socket %s", config->unixSocket.c_str());
+    }
+    if (config->endpoint.port != 0)
+        LOG_INFO("Listening on %s:%u", config->endpoint.ip, config->endpoint.port);
+    LOG_INFO("Serving with %u thread(s)", config->threads);
+
+    const sockets::ServerSocket *sharedListener = unixListener ? &*unixListener : nullptr;
+    std::vector<std::thread> workers;
+    for (types::u32 id = 1; id < config->threads; ++id)
+        workers.emplace_back(runEventLoop, std::cref(*config), std::ref(shard::at(id)), sharedListener);
+
+    runEventLoop(*config, shard::at(0), sharedListener);
+
+    for (auto &worker : workers)
+        worker.join();
 
-    event::EventLoop eventLoop{std::move(server)};
-    eventLoop.run();
+    aof::stop();
+    lazyfree::stop();
+    log::stop();
 }
\ No newline at end of file
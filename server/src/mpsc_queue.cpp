@@ -0,0 +1,61 @@
+#include "mpsc_queue.hpp"
+
+#include <thread>
+
+namespace my_redis::mpsc
+{
+    void Queue::push(Node *node) noexcept
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *prev = m_Head.exchange(node, std::memory_order_seq_cst);
+        // Until this store, the consumer can observe `m_Head` moved without the link
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Node *Queue::pop() noexcept
+    {
+        Node *tail = m_Tail;
+        Node *next = tail->next.load(std::memory_order_acquire);
+
+        // Skip the stub
+        if (tail == &m_Stub)
+        {
+            if (!next)
+            {
+                if (m_Head.load(std::memory_order_seq_cst) == &m_Stub)
+                    return nullptr;
+                next = waitNext(tail);
+            }
+
+            m_Tail = next;
+            tail = next;
+            next = tail->next.load(std::memory_order_acquire);
+        }
+
+        if (next)
+        {
+            m_Tail = next;
+            return tail;
+        }
+
+        // `tail` is not the last node, a push is in progress
+        if (m_Head.load(std::memory_order_seq_cst) != tail)
+        {
+            m_Tail = waitNext(tail);
+            return tail;
+        }
+
+        // `tail` is the last node: put the stub behind it so that it can be detached
+        push(&m_Stub);
+        m_Tail = waitNext(tail);
+        return tail;
+    }
+
+    Node *Queue::waitNext(Node *node) noexcept
+    {
+        Node *next = nullptr;
+        while (!(next = node->next.load(std::memory_order_acquire)))
+            std::this_thread::yield();
+        return next;
+    }
+} // namespace my_redis::mpsc
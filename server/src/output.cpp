@@ -0,0 +1,89 @@
+#include "output.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace my_redis::output
+{
+    using namespace my_redis::types;
+
+    void Queue::append(blob::Ref blob)
+    {
+        m_RefBytes += blob->length;
+        m_Refs.push_back({ .at = endOffset(), .sent = 0, .blob = std::move(blob) });
+    }
+
+    void Queue::append(Queue &other)
+    {
+        u64 base = endOffset();
+        m_Bytes.append(other.m_Bytes.data(), other.m_Bytes.size());
+        for (Ref &ref : other.m_Refs)
+        {
+            m_RefBytes += ref.blob->length - ref.sent;
+            m_Refs.push_back({ .at = base + (ref.at - other.m_Consumed), .sent = ref.sent, .blob = std::move(ref.blob) });
+        }
+
+        other.m_Consumed += other.m_Bytes.size();
+        other.m_Bytes.clear();
+        other.m_Refs.clear();
+        other.m_RefBytes = 0;
+    }
+
+    types::size Queue::gather(iovec *iov, types::size max) const noexcept
+    {
+        types::size count = 0;
+        types::size pos = 0;    // Relative to the readable bytes
+        auto addBytes = [&](types::size end) {
+            if (end > pos && count < max)
+            {
+                iov[count++] = { const_cast<u8 *>(m_Bytes.data()) + pos, end - pos };
+                pos = end;
+            }
+        };
+
+        for (const Ref &ref : m_Refs)
+        {
+            addBytes(static_cast<types::size>(ref.at - m_Consumed));
+            if (count == max)
+                return count;
+            iov[count++] = { const_cast<char *>(ref.blob->data()) + ref.sent, ref.blob->length - ref.sent };
+        }
+        addBytes(m_Bytes.size());
+        return count;
+    }
+
+    void Queue::consume(types::size n) noexcept
+    {
+        while (n > 0)
+        {
+            // Bytes up to the next blob, or all of them
+            types::size bytes = m_Refs.empty() ? m_Bytes.size() : static_cast<types::size>(m_Refs.front().at - m_Consumed);
+            if (bytes > 0 || m_Refs.empty())
+            {
+                types::size k = std::min(n, bytes);
+                m_Bytes.consume(k);
+                m_Consumed += k;
+                if (m_Refs.empty())
+                    return;
+                n -= k;
+                continue;
+            }
+
+            Ref &ref = m_Refs.front();
+            auto k = static_cast<u32>(std::min<types::size>(n, ref.blob->length - ref.sent));
+            ref.sent += k;
+            m_RefBytes -= k;
+            n -= k;
+            if (ref.sent == ref.blob->length)
+                m_Refs.pop_front();
+        }
+    }
+
+    void Queue::swap(Queue &other) noexcept
+    {
+        m_Bytes.swap(other.m_Bytes);
+        m_Refs.swap(other.m_Refs);
+        std::swap(m_Consumed, other.m_Consumed);
+        std::swap(m_RefBytes, other.m_RefBytes);
+    }
+} // namespace my_redis::output
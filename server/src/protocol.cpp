@@ -0,0 +1,196 @@
+#include "protocol.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace my_redis::protocol
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        // Shortest round-trip representation
+        std::string_view formatDouble(double value, char (&digits)[32]) noexcept
+        {
+            auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+            return { digits, static_cast<size>(end - digits) };
+        }
+
+        // Consume 32-bit unsigned integer from the buffer and advance the pointer.
+        bool read_u32(const u8 *&curr, const u8 *end, u32 &out)
+        {
+            if (curr + 4 > end)
+                return false;
+
+            std::memcpy(&out, curr, 4);
+            curr += 4;
+            return true;
+        }
+    } // namespace
+
+    bool parseRequest(const u8 *data, size size, Args &out)
+    {
+        const u8 *curr = data;
+        const u8 *end = data + size;
+        out.clear();
+
+        u32 nstr = 0;
+        if (!read_u32(curr, end, nstr))
+            return false;
+
+        if (nstr > K_MAX_ARGS)
+            return false;
+
+        return parseArgs(curr, static_cast<types::size>(end - curr), nstr, out);
+    }
+
+    bool parseArgs(const u8 *data, size size, types::size count, Args &out)
+    {
+        const u8 *curr = data;
+        const u8 *end = data + size;
+        types::size total = out.size() + count;
+
+        while (out.size() < total)
+        {
+            // Read the length of the next string
+            u32 len = 0;
+            if (!read_u32(curr, end, len))
+                return false;
+
+            if (len > static_cast<types::size>(end - curr))
+                return false;
+
+            // Reference the string itself
+            out.push_back(std::string_view{ reinterpret_cast<const char *>(curr), len });
+            curr += len;
+        }
+
+        return curr == end;
+    }
+
+    void appendRequest(buffer::Buffer &out, std::span<const std::string_view> args)
+    {
+        size total = 4;
+        for (std::string_view arg : args)
+            total += 4 + arg.size();
+
+        u8 *dst = out.prepare(4 + total);
+        auto requestLength = static_cast<u32>(total);
+        auto count = static_cast<u32>(args.size());
+        std::memcpy(dst, &requestLength, 4);
+        std::memcpy(dst + 4, &count, 4);
+        dst += 8;
+        for (std::string_view arg : args)
+        {
+            auto len = static_cast<u32>(arg.size());
+            std::memcpy(dst, &len, 4);
+            std::memcpy(dst + 4, arg.data(), arg.size());
+            dst += 4 + arg.size();
+        }
+        out.commit(4 + total);
+    }
+
+    void appendResponseHeader(buffer::Buffer &out, Response::Status status, size length)
+    {
+        auto responseLength = static_cast<u32>(length + 4);
+
+        u8 *dst = out.prepare(8);
+        std::memcpy(dst, &responseLength, 4);
+        std::memcpy(dst + 4, &status, 4);
+        out.commit(8);
+    }
+
+    void appendResponse(buffer::Buffer &out, Response::Status status, std::string_view data)
+    {
+        u32 responseLength = data.size() + 4;
+
+        u8 *dst = out.prepare(8 + data.size());
+        std::memcpy(dst, &responseLength, 4);
+        std::memcpy(dst + 4, &status, 4);
+        if (!data.empty())
+            std::memcpy(dst + 8, data.data(), data.size());
+        out.commit(8 + data.size());
+    }
+
+    void appendInteger(buffer::Buffer &out, i64 value)
+    {
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        appendResponse(out, Response::Status::RES_OK, std::string_view{ digits, static_cast<size>(end - digits) });
+    }
+
+    std::optional<i64> parseInteger(std::string_view arg) noexcept
+    {
+        i64 value = 0;
+        auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (ec != std::errc{} || end != arg.data() + arg.size())
+            return std::nullopt;
+        return value;
+    }
+
+    void appendDouble(buffer::Buffer &out, double value)
+    {
+        char digits[32];
+        appendResponse(out, Response::Status::RES_OK, formatDouble(value, digits));
+    }
+
+    std::optional<double> parseDouble(std::string_view arg) noexcept
+    {
+        // from_chars takes "inf" and "-inf" but not the explicit "+inf"
+        if (!arg.empty() && arg.front() == '+')
+            arg.remove_prefix(1);
+
+        double value = 0;
+        auto [end, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (ec != std::errc{} || end != arg.data() + arg.size() || std::isnan(value))
+            return std::nullopt;
+        return value;
+    }
+
+    ArrayWriter::ArrayWriter(buffer::Buffer &out)
+        : m_Out(out), m_Start(out.size())
+    {
+        // | length | status | count |, length and count are filled in by `finish()`
+        auto status = Response::Status::RES_ARR;
+        u8 *dst = m_Out.prepare(12);
+        std::memset(dst, 0, 12);
+        std::memcpy(dst + 4, &status, 4);
+        m_Out.commit(12);
+    }
+
+    void ArrayWriter::add(std::string_view item)
+    {
+        u32 len = item.size();
+        u8 *dst = m_Out.prepare(4 + item.size());
+        std::memcpy(dst, &len, 4);
+        if (!item.empty())
+            std::memcpy(dst + 4, item.data(), item.size());
+        m_Out.commit(4 + item.size());
+        m_Count++;
+    }
+
+    void ArrayWriter::add(double value)
+    {
+        char digits[32];
+        add(formatDouble(value, digits));
+    }
+
+    void ArrayWriter::addNil()
+    {
+        u32 len = Response::K_NIL_LEN;
+        std::memcpy(m_Out.prepare(4), &len, 4);
+        m_Out.commit(4);
+        m_Count++;
+    }
+
+    void ArrayWriter::finish() noexcept
+    {
+        // The buffer may have moved while growing, address the header by offset
+        u8 *header = m_Out.data() + m_Start;
+        u32 responseLength = m_Out.size() - m_Start - 4;
+        std::memcpy(header, &responseLength, 4);
+        std::memcpy(header + 8, &m_Count, 4);
+    }
+
+} // namespace my_redis::protocol
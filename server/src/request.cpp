@@ -0,0 +1,594 @@
+#include "request.hpp"
+
+#include "aof.hpp"
+#include "command.hpp"
+#include "db.hpp"
+#include "hash.hpp"
+#include "log.hpp"
+#include "payload.hpp"
+#include "protocol.hpp"
+#include "response.hpp"
+#include "shard.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using namespace my_redis::types;
+
+    // Log the request without allocating, long requests are truncated.
+    // Only called when debug logging is enabled.
+    void logRequest(const my_redis::protocol::Args &args) noexcept
+    {
+        char line[256];
+        size len = 0;
+        for (size i = 0; i < args.size() && len < sizeof(line); ++i)
+        {
+            auto n = std::snprintf(line + len, sizeof(line) - len, i == 0 ? "%.*s" : ", %.*s",
+                                   static_cast<int>(args[i].size()), args[i].data());
+            if (n < 0)
+                break;
+            len += static_cast<size>(n);
+        }
+        LOG_DEBUG("Parsed Request: [ %.*s ]", static_cast<int>(std::min(len, sizeof(line))), line);
+    }
+
+    // See `setBufferLimit()` and `setMaxValueSize()`
+    size g_bufferLimit = my_redis::K_DEFAULT_BUFFER_LIMIT;
+    size g_maxValueSize = my_redis::K_DEFAULT_MAX_VALUE_SIZE;
+
+    // First allocation of a streamed blob, doubled as the bytes arrive
+    constexpr size K_STREAM_CHUNK = 1 << 20;
+
+    // Parsing pauses while a connection holds this many reply slots, see `ReplySlot`
+    constexpr size K_MAX_REPLY_SLOTS = 1024;
+}
+
+namespace my_redis
+{
+    using protocol::Args;
+
+    // Execute a resolved command, appending its response to `out`.
+    void handleRequest(shard::Shard &shard, const command::Command &command, u64 keyHash, const Args &args, output::Queue &out,
+                       std::span<const u64> keyHashes = {}, blob::Blob *argBlob = nullptr)
+    {
+        command::Context ctx{
+            .shard      = shard,
+            .args       = args,
+            .keyHash    = keyHash,
+            .out        = out,
+            .keyHashes  = keyHashes,
+            .argBlob    = argBlob,
+        };
+        command::execute(command, ctx);
+    }
+
+    namespace
+    {
+        Response::Status statusOf(const buffer::Buffer &response) noexcept
+        {
+            Response::Status status;
+            std::memcpy(&status, response.data() + 4, 4);
+            return status;
+        }
+
+        std::string_view dataOf(const buffer::Buffer &response) noexcept
+        {
+            return { reinterpret_cast<const char *>(response.data()) + 8, response.size() - 8 };
+        }
+
+        // Open the slot of a forwarded request, returns its sequence number
+        u64 openSlot(Connection &connection, std::unique_ptr<Batch> batch)
+        {
+            ReplySlot &slot = connection.replySlots.emplace_back();
+            slot.batch = std::move(batch);
+            slot.forwarded = true;
+            return connection.firstSlot + connection.replySlots.size() - 1;
+        }
+
+        // Where the reply of a request executed here goes: straight out, or behind the
+        // replies still awaited. Consecutive replies share a slot.
+        output::Queue &replyQueue(Connection &connection)
+        {
+            if (connection.replySlots.empty())
+                return connection.outgoingBuffer;
+            if (connection.replySlots.back().forwarded)
+                connection.replySlots.emplace_back();
+            return connection.replySlots.back().reply;
+        }
+
+        // Move the replies no longer held back by a forwarded request to the output
+        void releaseSlots(Connection &connection)
+        {
+            while (!connection.replySlots.empty() && !connection.replySlots.front().forwarded)
+            {
+                ReplySlot &slot = connection.replySlots.front();
+                connection.heldBytes -= slot.reply.size();
+                connection.outgoingBuffer.append(slot.reply);
+                connection.replySlots.pop_front();
+                connection.firstSlot++;
+            }
+        }
+
+        /*
+            * Split a multi-key request by the shard owning each key. Every owner gets one
+            * message with its keys, in order, and the part of the origin runs right away.
+            * The batch is not atomic: each shard applies its keys on its own.
+        */
+        void scatter(Connection &connection, shard::Shard &shard, const command::Command &command, const Args &args,
+                     std::span<const u64> hashes)
+        {
+            auto batch = std::make_unique<Batch>();
+            batch->owners.reserve(hashes.size());
+            batch->replies.resize(shard::count());
+
+            auto step = static_cast<size>(command.keyStep);
+            std::vector<shard::Message *> parts(shard::count(), nullptr);
+            for (size k = 0; k < hashes.size(); ++k)
+            {
+                u32 owner = shard::ownerOf(hashes[k]);
+                batch->owners.push_back(owner);
+
+                shard::Message *&part = parts[owner];
+                if (!part)
+                {
+                    part = new shard::Message{};
+                    part->origin = shard.id;
+                    part->owner = owner;
+                    part->fd = connection.fd();
+                    part->connectionId = connection.id;
+                    part->command = &command;
+                    part->keyHash = hashes[k];
+                    part->args.emplace_back(args[0]);
+                    batch->pending++;
+                }
+                for (size i = 0; i < step; ++i)
+                    part->args.emplace_back(args[static_cast<size>(command.firstKey) + k * step + i]);
+                part->keyHashes.push_back(hashes[k]);
+            }
+
+            if (shard::Message *local = std::exchange(parts[shard.id], nullptr))
+            {
+                Args localArgs;
+                for (const auto &arg : local->args)
+                    localArgs.push_back(arg);
+                handleRequest(shard, command, local->keyHash, localArgs, batch->replies[shard.id], local->keyHashes);
+                batch->pending--;
+                delete local;
+            }
+
+            u64 slot = openSlot(connection, std::move(batch));
+            for (u32 owner = 0; owner < parts.size(); ++owner)
+            {
+                if (parts[owner])
+                {
+                    parts[owner]->slot = slot;
+                    shard::at(owner).mailbox.push(parts[owner]);
+                }
+            }
+        }
+
+        /*
+            * Merge the replies of a split request into one, by their shape:
+            *  - any error is the reply
+            *  - arrays hold one item per key, they are interleaved back in key order
+            *  - integers are counts, they are summed
+            *  - anything else is a plain status, the same for every part
+            * Parts never queue blobs, their bytes are contiguous.
+        */
+        void gather(Batch &batch, output::Queue &out)
+        {
+            const buffer::Buffer *first = nullptr;
+            for (output::Queue &reply : batch.replies)
+            {
+                const buffer::Buffer &bytes = reply;
+                if (reply.empty())
+                    continue;
+                assert(bytes.size() == reply.size());
+                if (statusOf(bytes) == Response::Status::RES_ERR)
+                {
+                    out.append(reply);
+                    return;
+                }
+                if (!first)
+                    first = &bytes;
+            }
+            assert(first != nullptr);
+
+            if (statusOf(*first) == Response::Status::RES_ARR)
+            {
+                // Skip | length | status | count | of every part
+                std::vector<size> cursors(batch.replies.size(), 12);
+                protocol::ArrayWriter array{ out };
+                for (u32 owner : batch.owners)
+                {
+                    const buffer::Buffer &bytes = batch.replies[owner];
+                    size &cursor = cursors[owner];
+                    u32 len = 0;
+                    std::memcpy(&len, bytes.data() + cursor, 4);
+                    cursor += 4;
+                    if (len == Response::K_NIL_LEN)
+                    {
+                        array.addNil();
+                        continue;
+                    }
+                    array.add({ reinterpret_cast<const char *>(bytes.data()) + cursor, len });
+                    cursor += len;
+                }
+                array.finish();
+                return;
+            }
+
+            std::optional<i64> total = protocol::parseInteger(dataOf(*first));
+            if (!total)
+            {
+                protocol::appendResponse(out, statusOf(*first), dataOf(*first));
+                return;
+            }
+            for (output::Queue &reply : batch.replies)
+            {
+                const buffer::Buffer &bytes = reply;
+                if (!reply.empty() && &bytes != first)
+                    *total += protocol::parseInteger(dataOf(bytes)).value_or(0);
+            }
+            protocol::appendInteger(out, *total);
+        }
+    } // namespace
+
+    namespace
+    {
+        // Send a request to the shard owning its key, its reply comes back in a slot
+        void forward(Connection &connection, shard::Shard &shard, const command::Command &command, u64 hash, u32 owner,
+                     const Args &args, blob::Blob *argBlob)
+        {
+            auto *message = new shard::Message{};
+            message->origin = shard.id;
+            message->fd = connection.fd();
+            message->connectionId = connection.id;
+            message->command = &command;
+            message->keyHash = hash;
+            // A streamed argument travels as a reference to its blob
+            for (size i = 0; i < args.size(); ++i)
+            {
+                if (argBlob && args[i].data() == argBlob->data())
+                {
+                    message->argBlob = blob::Ref{ argBlob };
+                    message->argBlobIndex = i;
+                    message->args.emplace_back();
+                }
+                else
+                    message->args.emplace_back(args[i]);
+            }
+            message->slot = openSlot(connection, nullptr);
+            shard::at(owner).mailbox.push(message);
+        }
+
+        // Execute a parsed request, or forward it to the shards owning its keys, then
+        // consume its `consumed` remaining bytes from the incoming buffer.
+        // `argBlob` is set when one of `args` views a blob the request was streamed into.
+        // Returns false, consuming nothing, when the request must wait for the forwarded ones.
+        bool dispatch(Connection &connection, shard::Shard &shard, const Args &args, blob::Blob *argBlob, size consumed)
+        {
+            const command::Command *command = args.empty() ? nullptr : command::lookup(args[0]);
+
+            // A keyless command sees every shard, the requests forwarded before it run first
+            if (command && command->firstKey == 0 && !(command->flags & command::CMD_CURSOR) && !connection.replySlots.empty())
+                return false;
+
+            if (log::enabled(log::Level::DEBUG))
+                logRequest(args);
+
+            u64 hash = 0;
+            std::span<const u64> hashes;
+            if (command && command::checkArity(*command, args.size()))
+            {
+                if (command->keyStep > 0)
+                {
+                    // Every key is hashed up front, the handler prefetches with the hashes
+                    std::vector<u64> &keyHashes = shard.keyHashes;
+                    keyHashes.clear();
+                    for (size i = static_cast<size>(command->firstKey); i < args.size(); i += static_cast<size>(command->keyStep))
+                        keyHashes.push_back(hash::strHash(args[i]));
+
+                    bool local = std::ranges::all_of(keyHashes, [&](u64 keyHash) { return shard::ownerOf(keyHash) == shard.id; });
+                    if (!local)
+                    {
+                        scatter(connection, shard, *command, args, keyHashes);
+                        connection.incomingBuffer.consume(consumed);
+                        return true;
+                    }
+                    hash = keyHashes.front();
+                    hashes = keyHashes;
+                }
+                else
+                {
+                    hash = command->firstKey > 0 ? hash::strHash(args[command->firstKey]) : 0;
+
+                    // Forward the request to the thread owning the key, or the cursor.
+                    // Invalid cursors are left to the handler to reject.
+                    u32 owner = shard.id;
+                    if (shard::count() > 1 && command->firstKey > 0)
+                        owner = shard::ownerOf(hash);
+                    else if (shard::count() > 1 && (command->flags & command::CMD_CURSOR))
+                    {
+                        if (auto cursor = db::parseCursor(args[1]); cursor && db::cursorShard(*cursor) < shard::count())
+                            owner = db::cursorShard(*cursor);
+                    }
+
+                    if (owner != shard.id)
+                    {
+                        forward(connection, shard, *command, hash, owner, args, argBlob);
+                        connection.incomingBuffer.consume(consumed);
+                        return true;
+                    }
+                }
+            }
+
+            output::Queue &out = replyQueue(connection);
+            size before = out.size();
+            if (!command)
+                protocol::appendResponse(out, Response::Status::RES_ERR, "unknown command");
+            else if (!command::checkArity(*command, args.size()))
+                protocol::appendResponse(out, Response::Status::RES_ERR, "wrong number of arguments");
+            else
+                handleRequest(shard, *command, hash, args, out, hashes, argBlob);
+            if (&out != &connection.outgoingBuffer)
+                connection.heldBytes += out.size() - before;
+
+            // Consume the processed payload
+            connection.incomingBuffer.consume(consumed);
+
+            return true;
+        }
+
+        // Start streaming a partially received request of `requestLen` bytes, once its
+        // first incomplete argument turns out to be a large one. Returns whether it started.
+        bool startStreaming(Connection &connection, u32 requestLen)
+        {
+            const u8 *request = connection.incomingBuffer.data() + payload::HEADER_LEN;
+            size available = connection.incomingBuffer.size() - payload::HEADER_LEN;
+            size pos = 4;
+            u32 nstr = 0;
+            if (available < pos)
+                return false;
+            std::memcpy(&nstr, request, 4);
+            if (nstr > protocol::K_MAX_ARGS)
+                return false;
+
+            for (u32 i = 0; i < nstr; ++i)
+            {
+                u32 len = 0;
+                if (available < pos + 4)
+                    return false;
+                std::memcpy(&len, request + pos, 4);
+                pos += 4;
+                if (len > requestLen - pos)
+                    return false;       // Malformed, rejected once complete
+
+                if (available - pos >= len)
+                {
+                    pos += len;
+                    continue;
+                }
+                if (len < blob::K_MIN_SIZE)
+                    return false;
+                if (len > g_maxValueSize)
+                {
+                    LOG_WARN("Streamed argument is too long(%u bytes)", len);
+                    connection.wantClose = true;
+                    return false;
+                }
+
+                // Arguments before this one are complete: copy them, receive this one in place
+                auto stream = std::make_unique<StreamedRequest>();
+                Args head;
+                if (!protocol::parseArgs(request + 4, pos - 8, i, head))
+                    return false;
+                stream->head.assign(head.begin(), head.end());
+                stream->length = len;
+                stream->filled = static_cast<u32>(available - pos);
+                size initial = std::min<size>(len, std::max<size>(stream->filled, K_STREAM_CHUNK));
+                try
+                {
+                    stream->blob = blob::Ref{ blob::allocate(static_cast<u32>(initial)), blob::Ref::Adopt{} };
+                }
+                catch (const std::bad_alloc &)
+                {
+                    LOG_WARN("Cannot allocate %zu bytes for a streamed argument", initial);
+                    connection.wantClose = true;
+                    return false;
+                }
+                std::memcpy(stream->blob.get()->data(), request + pos, stream->filled);
+                stream->tailArgs = nstr - i - 1;
+                stream->tailLen = requestLen - static_cast<u32>(pos) - len;
+
+                connection.incomingBuffer.consume(payload::HEADER_LEN + available);
+                connection.streaming = std::move(stream);
+                return true;
+            }
+            return false;
+        }
+
+        // Move the bytes received since into the blob, then dispatch the request once the
+        // arguments after the blob arrived too
+        bool continueStreaming(Connection &connection, shard::Shard &shard)
+        {
+            StreamedRequest &stream = *connection.streaming;
+            if (stream.filled < stream.length)
+            {
+                auto n = static_cast<u32>(std::min<size>(connection.incomingBuffer.size(), stream.length - stream.filled));
+                if (stream.filled + n > stream.blob->length)
+                {
+                    // Grow geometrically, so that the bytes are moved a bounded number of times
+                    size capacity = std::min<size>(stream.length, std::max<size>(stream.filled + n, size{ stream.blob->length } * 2));
+                    try
+                    {
+                        blob::Blob *grown = blob::resize(stream.blob.get(), static_cast<u32>(capacity));
+                        stream.blob.detach();
+                        stream.blob = blob::Ref{ grown, blob::Ref::Adopt{} };
+                    }
+                    catch (const std::bad_alloc &)
+                    {
+                        LOG_WARN("Cannot allocate %zu bytes for a streamed argument", capacity);
+                        connection.wantClose = true;
+                        return false;
+                    }
+                }
+                std::memcpy(stream.blob.get()->data() + stream.filled, connection.incomingBuffer.data(), n);
+                connection.incomingBuffer.consume(n);
+                stream.filled += n;
+                if (stream.filled < stream.length)
+                    return false;
+            }
+
+            blob::Blob *target = stream.blob.get();
+            assert(target->length == stream.length);
+
+            if (connection.incomingBuffer.size() < stream.tailLen)
+                return false;
+
+            Args args;
+            for (const auto &arg : stream.head)
+                args.push_back(arg);
+            args.push_back(target->view());
+            if (!protocol::parseArgs(connection.incomingBuffer.data(), stream.tailLen, stream.tailArgs, args))
+            {
+                LOG_WARN("Bad Request");
+                connection.wantClose = true;
+                return false;
+            }
+
+            if (!dispatch(connection, shard, args, target, stream.tailLen))
+                return false;
+            connection.streaming.reset();
+            return true;
+        }
+    } // namespace
+
+    void setBufferLimit(types::size bytes) noexcept
+    {
+        g_bufferLimit = bytes;
+    }
+
+    void setMaxValueSize(types::size bytes) noexcept
+    {
+        g_maxValueSize = bytes;
+    }
+
+    bool readPaused(const Connection &connection) noexcept
+    {
+        return connection.replySlots.size() >= K_MAX_REPLY_SLOTS ||
+               connection.outgoingBuffer.size() + connection.heldBytes >= g_bufferLimit ||
+               connection.incomingBuffer.size() > g_bufferLimit;
+    }
+
+    bool tryParseRequest(Connection &connection, shard::Shard &shard)
+    {
+        // Too many requests forwarded and waiting for their reply
+        if (connection.replySlots.size() >= K_MAX_REPLY_SLOTS)
+            return false;
+
+        // Let the replies drain before producing more
+        if (connection.outgoingBuffer.size() + connection.heldBytes >= g_bufferLimit)
+            return false;
+
+        if (connection.streaming)
+            return continueStreaming(connection, shard);
+
+        // Not enough data to read the header
+        if (connection.incomingBuffer.size() < payload::HEADER_LEN)
+            return false;
+
+        // 1. Read the length of the payload
+        u32 requestLen = 0;
+        std::memcpy(&requestLen, connection.incomingBuffer.data(), payload::HEADER_LEN);
+
+        // Not enough data to read the entire payload: a large argument is received
+        // straight into a blob rather than buffered, up to the 4 GiB of the length header
+        if (connection.incomingBuffer.size() < payload::HEADER_LEN + requestLen)
+        {
+            if (requestLen >= blob::K_MIN_SIZE && startStreaming(connection, requestLen))
+                return continueStreaming(connection, shard);
+
+            // A request that does not fit. Reading stops while parsing is paused, so
+            // complete requests only exceed the limit by the input already in flight.
+            if (connection.incomingBuffer.size() > g_bufferLimit)
+            {
+                LOG_WARN("Closing a connection buffering %zu bytes, over the limit of %zu bytes",
+                         connection.incomingBuffer.size(), g_bufferLimit);
+                connection.wantClose = true;
+            }
+            return false;
+        }
+
+        // Only a streamed request may exceed the message limit
+        if (requestLen > payload::MAX_MSG_LEN)
+        {
+            LOG_WARN("Requested message is too long(%u bytes)", requestLen);
+            connection.wantClose = true;
+            return false;
+        }
+
+        // Request ready to be processed
+        const u8 *request = connection.incomingBuffer.data() + payload::HEADER_LEN;
+
+        // Arguments view the incoming buffer, so the payload is consumed only once handled
+        Args args;
+        if (!protocol::parseRequest(request, requestLen, args))
+        {
+            LOG_WARN("Bad Request");
+            connection.wantClose = true;
+            return false;
+        }
+
+        return dispatch(connection, shard, args, nullptr, payload::HEADER_LEN + requestLen);
+    }
+
+    void executeForwarded(shard::Shard &shard, shard::Message &message)
+    {
+        assert(message.kind == shard::Message::Kind::REQUEST);
+
+        Args args;
+        for (size i = 0; i < message.args.size(); ++i)
+            args.push_back(message.argBlob.get() && i == message.argBlobIndex ? message.argBlob->view() : message.args[i]);
+
+        handleRequest(shard, *message.command, message.keyHash, args, message.reply, message.keyHashes, message.argBlob.get());
+        aof::beforeReply(shard);
+        message.kind = shard::Message::Kind::REPLY;
+        shard::at(message.origin).mailbox.push(&message);
+    }
+
+    void deliverReply(Connection &connection, shard::Message &message)
+    {
+        assert(message.kind == shard::Message::Kind::REPLY);
+        assert(message.slot - connection.firstSlot < connection.replySlots.size());
+
+        ReplySlot &slot = connection.replySlots[message.slot - connection.firstSlot];
+        if (slot.batch)
+        {
+            Batch &batch = *slot.batch;
+            batch.replies[message.owner].swap(message.reply);
+            if (--batch.pending > 0)
+                return;
+            gather(batch, slot.reply);
+            slot.batch.reset();
+        }
+        else
+            slot.reply.append(message.reply);
+        slot.forwarded = false;
+        connection.heldBytes += slot.reply.size();
+        releaseSlots(connection);
+    }
+} // namespace my_redis
@@ -0,0 +1,157 @@
+#include "shard.hpp"
+#include "exception.hpp"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    using my_redis::shard::Shard;
+
+    std::vector<std::unique_ptr<Shard>> g_shards;
+
+    // Stop-the-world handshake: the stopping thread waits for every other loop to
+    // park, runs its action, then bumps the epoch to release them
+    std::atomic<bool> g_stopPending{ false };
+    std::mutex g_stopMutex;
+    std::condition_variable g_stopChanged;
+    my_redis::types::u32 g_parked = 0;
+    my_redis::types::u64 g_stopEpoch = 0;
+}
+
+namespace my_redis::shard
+{
+    using namespace my_redis::types;
+
+    Mailbox::Mailbox()
+    {
+        m_WakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (-1 == m_WakeFd)
+            throw exception::errno_exception{ "Mailbox::Mailbox() -> eventfd()" };
+    }
+
+    Mailbox::~Mailbox()
+    {
+        ::close(m_WakeFd);
+    }
+
+    void Mailbox::push(Message *message) noexcept
+    {
+        m_Queue.push(&message->node);
+
+        // Only the first message since the last wake-up pays for the syscall
+        if (!m_Notified.exchange(true, std::memory_order_seq_cst))
+        {
+            u64 one = 1;
+            [[maybe_unused]] auto n = ::write(m_WakeFd, &one, sizeof(one));
+        }
+    }
+
+    void Mailbox::wake() noexcept
+    {
+        u64 one = 1;
+        [[maybe_unused]] auto n = ::write(m_WakeFd, &one, sizeof(one));
+    }
+
+    void Mailbox::acknowledge() noexcept
+    {
+        m_Notified.store(false, std::memory_order_seq_cst);
+    }
+
+    Message *Mailbox::pop() noexcept
+    {
+        mpsc::Node *node = m_Queue.pop();
+        return node ? reinterpret_cast<Message *>(reinterpret_cast<u8 *>(node) - offsetof(Message, node)) : nullptr;
+    }
+
+    void init(u32 count)
+    {
+        assert(count > 0 && g_shards.empty());
+        for (u32 id = 0; id < count; ++id)
+        {
+            g_shards.emplace_back(std::make_unique<Shard>());
+            g_shards.back()->id = id;
+        }
+    }
+
+    u32 count() noexcept
+    {
+        return static_cast<u32>(g_shards.size());
+    }
+
+    Shard &at(u32 id) noexcept
+    {
+        return *g_shards[id];
+    }
+
+    u32 ownerOf(u64 hash) noexcept
+    {
+        // Fibonacci hashing, so that the shard does not correlate with the
+        // low bits used to pick a bucket inside the shard's table.
+        u64 mixed = (hash * 0x9E3779B97F4A7C15ull) >> 32;
+        return static_cast<u32>((mixed * g_shards.size()) >> 32);
+    }
+
+    void requestStatsReset() noexcept
+    {
+        for (auto &shard : g_shards)
+            shard->statsResetPending.store(true, std::memory_order_relaxed);
+    }
+
+    void applyStatsReset(Shard &shard) noexcept
+    {
+        if (!shard.statsResetPending.load(std::memory_order_relaxed))
+            return;
+
+        for (auto &latency : shard.commandStats.latency)
+            latency.reset();
+        shard.loopStats.reset();
+        shard.statsResetPending.store(false, std::memory_order_release);
+    }
+
+    bool stopTheWorld(Shard &caller, const std::function<void()> &action)
+    {
+        bool expected = false;
+        if (!g_stopPending.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+            return false;
+
+        // Loops sleeping in the poller check for the stop once woken up
+        for (auto &shard : g_shards)
+        {
+            if (shard.get() != &caller)
+                shard->mailbox.wake();
+        }
+
+        std::unique_lock lock{ g_stopMutex };
+        g_stopChanged.wait(lock, [] { return g_parked == g_shards.size() - 1; });
+
+        action();
+
+        g_parked = 0;
+        g_stopEpoch++;
+        g_stopPending.store(false, std::memory_order_release);
+        lock.unlock();
+        g_stopChanged.notify_all();
+        return true;
+    }
+
+    void parkIfStopped(Shard &)
+    {
+        if (!g_stopPending.load(std::memory_order_acquire))
+            return;
+
+        std::unique_lock lock{ g_stopMutex };
+        if (!g_stopPending.load(std::memory_order_relaxed))
+            return;
+
+        u64 epoch = g_stopEpoch;
+        g_parked++;
+        g_stopChanged.notify_all();
+        g_stopChanged.wait(lock, [epoch] { return g_stopEpoch != epoch; });
+    }
+} // namespace my_redis::shard
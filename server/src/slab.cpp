@@ -0,0 +1,178 @@
+#include "slab.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+#include <bit>
+
+namespace my_redis::slab
+{
+    using namespace my_redis::types;
+
+    namespace
+    {
+        constexpr size K_SLAB_HEADER = 64;  // Chunks start after the header, cache line aligned
+    }
+
+    Allocator::~Allocator()
+    {
+        // Objects still alive are owned by the keyspace being torn down with the allocator
+        for (auto &sizeClass : m_Classes)
+        {
+            for (Slab **list : { &sizeClass.partial, &sizeClass.full })
+            {
+                while (Slab *slab = *list)
+                {
+                    unlink(*list, slab);
+                    std::free(slab);
+                }
+            }
+        }
+    }
+
+    // Classes 0-7: 16..128 in steps of 16, then 4 classes per power of 2 up to 4096
+    size Allocator::classOf(size n) noexcept
+    {
+        assert(n > 0 && n <= K_MAX_SMALL);
+        if (n <= 128)
+            return (n + 15) / 16 - 1;
+
+        size p = std::bit_width(n - 1) - 1;     // 2^p < n <= 2^(p+1)
+        return 8 + (p - 7) * 4 + ((n - 1) >> (p - 2)) - 4;
+    }
+
+    size Allocator::classSize(size index) noexcept
+    {
+        if (index < 8)
+            return (index + 1) * 16;
+
+        size j = index - 8;
+        size p = 7 + j / 4;
+        return (4 + j % 4 + 1) << (p - 2);
+    }
+
+    size Allocator::usableSize(size n) noexcept
+    {
+        return n <= K_MAX_SMALL ? classSize(classOf(n)) : n;
+    }
+
+    void *Allocator::allocate(size n)
+    {
+        if (n > K_MAX_SMALL)
+        {
+            void *ptr = std::malloc(n);
+            if (!ptr)
+                throw std::bad_alloc{};
+            m_AllocatedBytes += n;
+            return ptr;
+        }
+
+        size index = classOf(n);
+        SizeClass &sizeClass = m_Classes[index];
+        Slab *slab = sizeClass.partial ? sizeClass.partial : newSlab(index);
+
+        void *chunk = nullptr;
+        if (slab->freeList)
+        {
+            chunk = slab->freeList;
+            slab->freeList = slab->freeList->next;
+        }
+        else
+        {
+            chunk = slab->bump;
+            slab->bump += classSize(index);
+        }
+
+        // A full slab leaves the partial list until one of its chunks is freed
+        if (++slab->used == slab->capacity)
+        {
+            unlink(sizeClass.partial, slab);
+            pushFront(sizeClass.full, slab);
+        }
+
+        m_AllocatedBytes += classSize(index);
+        return chunk;
+    }
+
+    void Allocator::deallocate(void *ptr, size n) noexcept
+    {
+        if (!ptr)
+            return;
+
+        if (n > K_MAX_SMALL)
+        {
+            m_AllocatedBytes -= n;
+            std::free(ptr);
+            return;
+        }
+
+        size index = classOf(n);
+        SizeClass &sizeClass = m_Classes[index];
+        auto *slab = reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(ptr) & ~(K_SLAB_SIZE - 1));
+
+        auto *chunk = static_cast<FreeChunk *>(ptr);
+        chunk->next = slab->freeList;
+        slab->freeList = chunk;
+
+        if (slab->used-- == slab->capacity)
+        {
+            unlink(sizeClass.full, slab);
+            pushFront(sizeClass.partial, slab);
+        }
+
+        m_AllocatedBytes -= classSize(index);
+
+        // Give empty slabs back, unless it is the only one with free chunks
+        // left in its class, to avoid thrashing on alloc/free cycles
+        if (slab->used == 0 && (slab->prev || slab->next))
+        {
+            unlink(sizeClass.partial, slab);
+            sizeClass.slabCount--;
+            m_SlabCount--;
+            std::free(slab);
+        }
+    }
+
+    Allocator::Slab *Allocator::newSlab(size index)
+    {
+        void *mem = std::aligned_alloc(K_SLAB_SIZE, K_SLAB_SIZE);
+        if (!mem)
+            throw std::bad_alloc{};
+
+        auto *slab = static_cast<Slab *>(mem);
+        slab->prev = slab->next = nullptr;
+        slab->freeList = nullptr;
+        slab->bump = static_cast<u8 *>(mem) + K_SLAB_HEADER;
+        slab->used = 0;
+        slab->capacity = static_cast<u32>((K_SLAB_SIZE - K_SLAB_HEADER) / classSize(index));
+
+        SizeClass &sizeClass = m_Classes[index];
+        pushFront(sizeClass.partial, slab);
+        sizeClass.slabCount++;
+        m_SlabCount++;
+        return slab;
+    }
+
+    void Allocator::unlink(Slab *&list, Slab *slab) noexcept
+    {
+        if (slab->prev)
+            slab->prev->next = slab->next;
+        else
+            list = slab->next;
+
+        if (slab->next)
+            slab->next->prev = slab->prev;
+
+        slab->prev = slab->next = nullptr;
+    }
+
+    void Allocator::pushFront(Slab *&list, Slab *slab) noexcept
+    {
+        slab->prev = nullptr;
+        slab->next = list;
+        if (list)
+            list->prev = slab;
+        list = slab;
+    }
+} // namespace my_redis::slab
@@ -0,0 +1,530 @@
+#include "snapshot.hpp"
+
+#include "db.hpp"
+#include "entry.hpp"
+#include "exception.hpp"
+#include "hash.hpp"
+#include "keyspace.hpp"
+#include "log.hpp"
+#include "shard.hpp"
+#include "zset.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace my_redis::snapshot
+{
+    using namespace my_redis::types;
+    using entry::Entry;
+
+    namespace
+    {
+        constexpr char K_MAGIC[8] = { 'M', 'Y', 'R', 'S', 'N', 'A', 'P', '\0' };
+        constexpr size K_HEADER_SIZE = 24;
+        constexpr size K_TRAILER_SIZE = 16;
+        // Smallest encodings, bounding the counts read before the checksum is verified
+        constexpr size K_MIN_RECORD_SIZE = 10;      // | type | flags | keyLen | valueLen |
+        constexpr size K_MIN_MEMBER_SIZE = 12;      // | score | len |
+        constexpr u64 K_CHECKSUM_SEED = 0x6D795F7265646973;     // "my_redis"
+
+        std::string g_path;
+        std::atomic<i32> g_child{ 0 };          // Pid of the running background save, 0 if none
+        std::atomic<bool> g_lastSaveOk{ true };
+        std::atomic<u64> g_lastSaveAt{ 0 };
+
+        double msSince(std::chrono::steady_clock::time_point start) noexcept
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // Buffered output computing the checksum as full chunks are written
+        class Writer
+        {
+        public:
+            explicit Writer(i32 fd) : m_Fd(fd), m_Buffer(K_CHUNK_SIZE + sizeof(u64)) {}
+
+        public:
+            void append(const void *data, size n)
+            {
+                const u8 *curr = static_cast<const u8 *>(data);
+                while (n > 0)
+                {
+                    size chunk = std::min(n, K_CHUNK_SIZE - m_Used);
+                    std::memcpy(m_Buffer.data() + m_Used, curr, chunk);
+                    m_Used += chunk;
+                    curr += chunk;
+                    n -= chunk;
+
+                    if (m_Used == K_CHUNK_SIZE)
+                    {
+                        m_Checksum = hash::wyhash(m_Buffer.data(), m_Used, m_Checksum);
+                        flush();
+                    }
+                }
+            }
+
+            template <typename T>
+            void put(const T &value)
+            {
+                append(&value, sizeof(value));
+            }
+
+            // Append the checksum of everything written so far, and write the rest out
+            void seal()
+            {
+                u64 checksum = hash::wyhash(m_Buffer.data(), m_Used, m_Checksum);
+                std::memcpy(m_Buffer.data() + m_Used, &checksum, sizeof(checksum));
+                m_Used += sizeof(checksum);
+                flush();
+            }
+
+        private:
+            void flush()
+            {
+                size written = 0;
+                while (written < m_Used)
+                {
+                    auto n = ::write(m_Fd, m_Buffer.data() + written, m_Used - written);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0)
+                        throw exception::errno_exception{ "snapshot::Writer::flush() -> write()" };
+                    written += static_cast<size>(n);
+                }
+                m_Used = 0;
+            }
+
+        private:
+            i32 m_Fd;
+            std::vector<u8> m_Buffer;   // One chunk, plus room for the checksum when sealing
+            size m_Used = 0;
+            u64 m_Checksum = K_CHECKSUM_SEED;
+        };
+
+        size zsetEncodedSize(zset::ZSet *set) noexcept
+        {
+            size bytes = sizeof(u32);
+            for (zset::ZNode *node = zset::byRank(set, 0); node; node = zset::offset(node, 1))
+                bytes += sizeof(double) + sizeof(u32) + node->len;
+            return bytes;
+        }
+
+        void writeRecord(Writer &out, const Entry *entry)
+        {
+            auto type = static_cast<u8>(entry->type);
+            u8 flags = entry->flags & entry::ENTRY_EXPIRES;
+            auto *set = entry->type == entry::Type::ZSET ? entry->object<zset::ZSet>() : nullptr;
+            std::string_view value = set ? std::string_view{} : entry->value();
+            auto valueLen = static_cast<u32>(set ? zsetEncodedSize(set) : value.size());
+
+            out.put(type);
+            out.put(flags);
+            out.put(entry->keyLen);
+            out.put(valueLen);
+            if (const entry::Expiry *expiry = entry->expiry())
+                out.put(expiry->expireAt);
+            out.append(entry->keyData(), entry->keyLen);
+
+            if (!set)
+            {
+                out.append(value.data(), value.size());
+                return;
+            }
+
+            out.put(static_cast<u32>(zset::length(set)));
+            for (zset::ZNode *node = zset::byRank(set, 0); node; node = zset::offset(node, 1))
+            {
+                out.put(node->score);
+                out.put(node->len);
+                out.append(node->name().data(), node->len);
+            }
+        }
+
+        // Write every live key of every shard to a temporary file, then rename it over
+        // `g_path`, so that a crash never leaves a truncated snapshot behind.
+        // The shards must not change meanwhile. Returns the number of keys.
+        u64 writeSnapshot()
+        {
+            std::string tmpPath = g_path + ".tmp";
+            i32 fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (-1 == fd)
+                throw exception::errno_exception{ "snapshot::writeSnapshot() -> open()" };
+
+            u64 keys = 0;
+            try
+            {
+                Writer out{ fd };
+                out.append(K_MAGIC, sizeof(K_MAGIC));
+                out.put(K_VERSION);
+                out.put(u32{ 0 });
+                out.put(db::nowMs());
+
+                u64 now = db::nowMs();
+                for (u32 id = 0; id < shard::count(); ++id)
+                {
+                    keyspace::forEach(shard::at(id).db, [&](const Entry *entry) {
+                        const entry::Expiry *expiry = entry->expiry();
+                        if (expiry && expiry->expireAt <= now)
+                            return;
+                        writeRecord(out, entry);
+                        keys++;
+                    });
+                }
+
+                out.put(keys);
+                out.seal();
+
+                if (-1 == ::fsync(fd))
+                    throw exception::errno_exception{ "snapshot::writeSnapshot() -> fsync()" };
+            }
+            catch (...)
+            {
+                ::close(fd);
+                ::unlink(tmpPath.c_str());
+                throw;
+            }
+
+            ::close(fd);
+            if (-1 == ::rename(tmpPath.c_str(), g_path.c_str()))
+                throw exception::errno_exception{ "snapshot::writeSnapshot() -> rename()" };
+            return keys;
+        }
+
+        // Bounds-checked reads from the mapped file, checksumming the chunks left behind
+        class Reader
+        {
+        public:
+            Reader(const u8 *data, size end) : m_Data(data), m_End(end) {}
+
+        public:
+            bool read(void *out, size n) noexcept
+            {
+                if (n > m_End - m_Pos)
+                    return false;
+                std::memcpy(out, m_Data + m_Pos, n);
+                m_Pos += n;
+                return true;
+            }
+
+            template <typename T>
+            bool get(T &value) noexcept
+            {
+                return read(&value, sizeof(value));
+            }
+
+            bool view(size n, std::string_view &out) noexcept
+            {
+                if (n > m_End - m_Pos)
+                    return false;
+                out = { reinterpret_cast<const char *>(m_Data + m_Pos), n };
+                m_Pos += n;
+                return true;
+            }
+
+            // Fold the chunks fully read into the checksum while they are still cached
+            void checksumRead() noexcept
+            {
+                checksumChunks(m_Pos);
+            }
+
+            // Checksum of everything before `end`, split in chunks like the writer did
+            u64 checksumUpTo(size end) noexcept
+            {
+                checksumChunks(end);
+                return hash::wyhash(m_Data + m_Checked, end - m_Checked, m_Checksum);
+            }
+
+            bool done() const noexcept { return m_Pos == m_End; }
+            size remaining() const noexcept { return m_End - m_Pos; }
+
+        private:
+            void checksumChunks(size end) noexcept
+            {
+                while (end - m_Checked >= K_CHUNK_SIZE)
+                {
+                    m_Checksum = hash::wyhash(m_Data + m_Checked, K_CHUNK_SIZE, m_Checksum);
+                    m_Checked += K_CHUNK_SIZE;
+                }
+            }
+
+        private:
+            const u8 *m_Data;
+            size m_End;
+            size m_Pos = 0;
+            size m_Checked = 0;
+            u64 m_Checksum = K_CHECKSUM_SEED;
+        };
+
+        std::unique_ptr<zset::ZSet> readZSet(std::string_view encoded)
+        {
+            Reader in{ reinterpret_cast<const u8 *>(encoded.data()), encoded.size() };
+            u32 count = 0;
+            if (!in.get(count) || count > in.remaining() / K_MIN_MEMBER_SIZE)
+                return nullptr;
+
+            auto set = std::make_unique<zset::ZSet>();
+            hashmap::reserve(&set->members, count);
+            for (u32 i = 0; i < count; ++i)
+            {
+                double score = 0;
+                u32 len = 0;
+                std::string_view name;
+                if (!in.get(score) || !in.get(len) || !in.view(len, name))
+                    return nullptr;
+                zset::insert(set.get(), name, score);
+            }
+            if (!in.done())
+                return nullptr;
+            return set;
+        }
+
+        // Parse the mapped snapshot into the shards. Returns false on corruption.
+        bool loadRecords(const u8 *data, size fileSize, u64 &loaded)
+        {
+            size recordsEnd = fileSize - K_TRAILER_SIZE;
+            u64 keys = 0;
+            u64 checksum = 0;
+            std::memcpy(&keys, data + recordsEnd, sizeof(keys));
+            std::memcpy(&checksum, data + recordsEnd + sizeof(keys), sizeof(checksum));
+
+            Reader in{ data, recordsEnd };
+            char magic[sizeof(K_MAGIC)];
+            u32 version = 0, reserved = 0;
+            u64 createdAt = 0;
+            if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, K_MAGIC, sizeof(magic)) != 0)
+                return false;
+            if (!in.get(version) || version != K_VERSION || !in.get(reserved) || !in.get(createdAt))
+                return false;
+            if (keys > in.remaining() / K_MIN_RECORD_SIZE)
+                return false;
+
+            // Each shard gets its share of the keys plus some slack, the owner of a key
+            // depending on its hash
+            u64 perShard = keys / shard::count();
+            for (u32 id = 0; id < shard::count(); ++id)
+                keyspace::reserve(shard::at(id).db, perShard + perShard / 16 + 16);
+
+            u64 records = 0;
+            u64 now = db::nowMs();
+            while (!in.done())
+            {
+                u8 type = 0, flags = 0;
+                u32 keyLen = 0, valueLen = 0;
+                u64 expireAt = 0;
+                std::string_view key, value;
+                if (!in.get(type) || !in.get(flags) || !in.get(keyLen) || !in.get(valueLen))
+                    return false;
+                if ((flags & ~entry::ENTRY_EXPIRES) != 0 || type > static_cast<u8>(entry::Type::ZSET))
+                    return false;
+                if ((flags & entry::ENTRY_EXPIRES) && !in.get(expireAt))
+                    return false;
+                if (!in.view(keyLen, key) || !in.view(valueLen, value))
+                    return false;
+
+                records++;
+                in.checksumRead();
+                if (expireAt && expireAt <= now)
+                    continue;
+
+                u64 hash = hash::strHash(key);
+                shard::Shard &owner = shard::at(shard::ownerOf(hash));
+                if (static_cast<entry::Type>(type) == entry::Type::STRING)
+                    db::restore(owner, hash, key, entry::Type::STRING, value, expireAt);
+                else
+                {
+                    auto set = readZSet(value);
+                    if (!set)
+                        return false;
+                    zset::ZSet *object = set.release();
+                    db::restore(owner, hash, key, entry::Type::ZSET, { reinterpret_cast<const char *>(&object), sizeof(object) }, expireAt);
+                }
+                loaded++;
+            }
+
+            return records == keys && in.checksumUpTo(recordsEnd + sizeof(keys)) == checksum;
+        }
+
+        void reap()
+        {
+            i32 pid = g_child.load(std::memory_order_acquire);
+            if (pid <= 0)
+                return;
+
+            int status = 0;
+            if (::waitpid(pid, &status, WNOHANG) != pid)
+                return;
+            // Another thread may have raced for the same child
+            if (!g_child.compare_exchange_strong(pid, 0, std::memory_order_acq_rel))
+                return;
+
+            bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            g_lastSaveOk.store(ok, std::memory_order_relaxed);
+            if (ok)
+            {
+                g_lastSaveAt.store(db::nowMs(), std::memory_order_relaxed);
+                LOG_INFO("Background save to %s done", g_path.c_str());
+            }
+            else
+                LOG_ERROR("Background save to %s failed (status %d)", g_path.c_str(), status);
+        }
+    } // namespace
+
+    void init(std::string path)
+    {
+        g_path = std::move(path);
+    }
+
+    const std::string &path() noexcept
+    {
+        return g_path;
+    }
+
+    bool load()
+    {
+        i32 fd = ::open(g_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (-1 == fd)
+        {
+            if (errno == ENOENT)
+            {
+                LOG_INFO("No snapshot at %s, starting empty", g_path.c_str());
+                return true;
+            }
+            LOG_ERROR("Cannot open snapshot %s: %s", g_path.c_str(), util::strerror(errno).c_str());
+            return false;
+        }
+
+        struct stat info{};
+        if (-1 == ::fstat(fd, &info) || static_cast<size>(info.st_size) < K_HEADER_SIZE + K_TRAILER_SIZE)
+        {
+            ::close(fd);
+            LOG_ERROR("Snapshot %s is truncated", g_path.c_str());
+            return false;
+        }
+
+        auto fileSize = static_cast<size>(info.st_size);
+        void *mapped = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            LOG_ERROR("Cannot map snapshot %s: %s", g_path.c_str(), util::strerror(errno).c_str());
+            return false;
+        }
+        // Read-ahead aggressively, and drop the pages behind
+        ::madvise(mapped, fileSize, MADV_SEQUENTIAL);
+
+        auto start = std::chrono::steady_clock::now();
+        u64 loaded = 0;
+        bool ok = loadRecords(static_cast<const u8 *>(mapped), fileSize, loaded);
+        ::munmap(mapped, fileSize);
+
+        if (!ok)
+        {
+            LOG_ERROR("Snapshot %s is corrupted", g_path.c_str());
+            return false;
+        }
+
+        double ms = msSince(start);
+        LOG_INFO("Loaded %llu keys from %s in %.1f ms (%.1f MB/s)", static_cast<unsigned long long>(loaded),
+                 g_path.c_str(), ms, static_cast<double>(fileSize) / 1000.0 / std::max(ms, 0.001));
+        return true;
+    }
+
+    Result save(shard::Shard &caller)
+    {
+        reap();
+
+        Result result = Result::BUSY;
+        shard::stopTheWorld(caller, [&result] {
+            if (g_child.load(std::memory_order_acquire) > 0)
+                return;
+
+            auto start = std::chrono::steady_clock::now();
+            try
+            {
+                u64 keys = writeSnapshot();
+                g_lastSaveOk.store(true, std::memory_order_relaxed);
+                g_lastSaveAt.store(db::nowMs(), std::memory_order_relaxed);
+                LOG_INFO("Saved %llu keys to %s in %.1f ms", static_cast<unsigned long long>(keys), g_path.c_str(), msSince(start));
+                result = Result::OK;
+            }
+            catch (const std::exception &e)
+            {
+                g_lastSaveOk.store(false, std::memory_order_relaxed);
+                LOG_ERROR("Save to %s failed: %s", g_path.c_str(), e.what());
+                result = Result::FAILED;
+            }
+        });
+        return result;
+    }
+
+    Result saveInBackground(shard::Shard &caller)
+    {
+        reap();
+
+        Result result = Result::BUSY;
+        shard::stopTheWorld(caller, [&result] {
+            if (g_child.load(std::memory_order_acquire) > 0)
+                return;
+
+            auto start = std::chrono::steady_clock::now();
+            i32 pid = ::fork();
+            if (pid == 0)
+            {
+                // Only this thread exists in the child, which must neither log nor return.
+                // Inherited sockets are closed, so that clients the server disconnects
+                // meanwhile see it right away. stderr is kept.
+                ::close_range(STDERR_FILENO + 1, ~0U, 0);
+                try
+                {
+                    writeSnapshot();
+                    ::_exit(0);
+                }
+                catch (...)
+                {
+                    ::_exit(1);
+                }
+            }
+
+            if (pid < 0)
+            {
+                g_lastSaveOk.store(false, std::memory_order_relaxed);
+                LOG_ERROR("Background save failed: fork() -> %s", util::strerror(errno).c_str());
+                result = Result::FAILED;
+                return;
+            }
+
+            g_child.store(pid, std::memory_order_release);
+            LOG_INFO("Background save started by pid %d, fork took %.1f ms", pid, msSince(start));
+            result = Result::OK;
+        });
+        return result;
+    }
+
+    void poll(const shard::Shard &shard)
+    {
+        if (shard.id == 0 && g_child.load(std::memory_order_relaxed) > 0)
+            reap();
+    }
+
+    Status status()
+    {
+        reap();
+        return {
+            .inProgress = g_child.load(std::memory_order_acquire) > 0,
+            .lastSaveOk = g_lastSaveOk.load(std::memory_order_relaxed),
+            .lastSaveAt = g_lastSaveAt.load(std::memory_order_relaxed),
+        };
+    }
+} // namespace my_redis::snapshot
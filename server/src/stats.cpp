@@ -0,0 +1,88 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace my_redis::stats
+{
+    using namespace my_redis::types;
+
+    size Histogram::bucketOf(u64 value) noexcept
+    {
+        value = std::min<u64>(value, (u64{ 1 } << K_MAX_BITS) - 1);
+        if (value < K_SUB_BUCKETS)
+            return static_cast<size>(value);
+
+        // The top K_SUB_BITS + 1 bits select the bucket, the leading 1 gives the power of 2
+        u32 exponent = static_cast<u32>(std::bit_width(value)) - 1;
+        u32 shift = exponent - K_SUB_BITS;
+        return static_cast<size>(shift + 1) * K_SUB_BUCKETS + static_cast<size>((value >> shift) - K_SUB_BUCKETS);
+    }
+
+    u64 Histogram::bucketMax(size bucket) noexcept
+    {
+        if (bucket < K_SUB_BUCKETS)
+            return bucket;
+
+        u32 shift = static_cast<u32>(bucket / K_SUB_BUCKETS) - 1;
+        u64 lowest = (K_SUB_BUCKETS + bucket % K_SUB_BUCKETS) << shift;
+        return lowest + (u64{ 1 } << shift) - 1;
+    }
+
+    void Histogram::record(u64 value) noexcept
+    {
+        bump(m_Buckets[bucketOf(value)], 1);
+        bump(m_Count, 1);
+        bump(m_Sum, value);
+        if (value > m_Max.load(std::memory_order_relaxed))
+            m_Max.store(value, std::memory_order_relaxed);
+    }
+
+    void Histogram::reset() noexcept
+    {
+        for (auto &bucket : m_Buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        m_Count.store(0, std::memory_order_relaxed);
+        m_Sum.store(0, std::memory_order_relaxed);
+        m_Max.store(0, std::memory_order_relaxed);
+    }
+
+    void Summary::add(const Histogram &histogram) noexcept
+    {
+        for (size i = 0; i < Histogram::K_BUCKETS; ++i)
+            buckets[i] += histogram.m_Buckets[i].load(std::memory_order_relaxed);
+        count += histogram.m_Count.load(std::memory_order_relaxed);
+        sum += histogram.m_Sum.load(std::memory_order_relaxed);
+        max = std::max(max, histogram.m_Max.load(std::memory_order_relaxed));
+    }
+
+    u64 Summary::percentile(double q) const noexcept
+    {
+        // Read concurrently with the owners, so the buckets may not add up to `count` exactly
+        u64 total = 0;
+        for (u64 n : buckets)
+            total += n;
+        if (total == 0)
+            return 0;
+
+        auto rank = std::max<u64>(1, static_cast<u64>(std::ceil(q * static_cast<double>(total))));
+        u64 seen = 0;
+        for (size i = 0; i < Histogram::K_BUCKETS; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(Histogram::bucketMax(i), max);
+        }
+        return max;
+    }
+
+    void LoopStats::reset() noexcept
+    {
+        wakeups.reset();
+        bytesIn.reset();
+        bytesOut.reset();
+        readyPerWakeup.reset();
+        pipelineDepth.reset();
+    }
+} // namespace my_redis::stats
@@ -0,0 +1,427 @@
+#include "swisstable.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace my_redis::swisstable
+{
+    using namespace my_redis::types;
+    using hashtable::HashNode;
+
+    namespace
+    {
+        constexpr size K_GROUP_WIDTH = 16;
+        constexpr size K_MIN_CAPACITY = K_GROUP_WIDTH;
+        constexpr size K_REHASHING_WORK = 128;
+        constexpr size K_NPOS = ~size{ 0 };
+
+        constexpr i8 K_EMPTY = -128;    // 0b10000000
+        constexpr i8 K_DELETED = -2;    // 0b11111110
+        // Full slots hold H2, 0b0xxxxxxx
+
+        constexpr size h1(u64 hash) noexcept { return static_cast<size>(hash >> 7); }
+        constexpr i8 h2(u64 hash) noexcept { return static_cast<i8>(hash & 0x7F); }
+        constexpr bool isFull(i8 ctrl) noexcept { return ctrl >= 0; }
+
+        // 16 control bytes, each query returns a bitmask with one bit per matching byte
+        struct Group
+        {
+#if defined(__SSE2__)
+            __m128i ctrl;
+
+            explicit Group(const i8 *pos) noexcept
+                : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos)))
+            {
+            }
+
+            u32 match(i8 tag) const noexcept
+            {
+                return static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)));
+            }
+
+            // EMPTY and DELETED are the only bytes with the high bit set
+            u32 matchEmptyOrDeleted() const noexcept
+            {
+                return static_cast<u32>(_mm_movemask_epi8(ctrl));
+            }
+#else
+            i8 ctrl[K_GROUP_WIDTH];
+
+            explicit Group(const i8 *pos) noexcept { std::memcpy(ctrl, pos, K_GROUP_WIDTH); }
+
+            u32 match(i8 tag) const noexcept
+            {
+                u32 mask = 0;
+                for (size i = 0; i < K_GROUP_WIDTH; ++i)
+                    mask |= static_cast<u32>(ctrl[i] == tag) << i;
+                return mask;
+            }
+
+            u32 matchEmptyOrDeleted() const noexcept
+            {
+                u32 mask = 0;
+                for (size i = 0; i < K_GROUP_WIDTH; ++i)
+                    mask |= static_cast<u32>(ctrl[i] < 0) << i;
+                return mask;
+            }
+#endif
+            u32 matchEmpty() const noexcept { return match(K_EMPTY); }
+        };
+
+        // Triangular probing over groups, visits every group once when the capacity is a power of 2
+        struct ProbeSeq
+        {
+            size pos;
+            size mask;
+            size step = 0;
+
+            ProbeSeq(u64 hash, size mask) noexcept : pos(h1(hash) & mask), mask(mask) {}
+
+            size offset(size i) const noexcept { return (pos + i) & mask; }
+            void next() noexcept
+            {
+                step += K_GROUP_WIDTH;
+                pos = (pos + step) & mask;
+            }
+        };
+
+        void init(RawTable *raw, size capacity)
+        {
+            assert(capacity >= K_MIN_CAPACITY && ((capacity - 1) & capacity) == 0);
+
+            // One allocation: the slots, then the control bytes
+            size slotBytes = capacity * sizeof(HashNode *);
+            size ctrlBytes = capacity + K_GROUP_WIDTH - 1;
+            void *mem = std::malloc(slotBytes + ctrlBytes);
+            if (!mem)
+                throw std::bad_alloc{};
+
+            raw->slots = static_cast<HashNode **>(mem);
+            raw->ctrl = reinterpret_cast<i8 *>(static_cast<u8 *>(mem) + slotBytes);
+            std::memset(raw->ctrl, K_EMPTY, ctrlBytes);
+            raw->mask = capacity - 1;
+            raw->size = 0;
+            raw->tombstones = 0;
+        }
+
+        void release(RawTable *raw) noexcept
+        {
+            std::free(raw->slots);
+            *raw = {};
+        }
+
+        // Keep the mirrored tail in sync, so a group load starting near the end wraps around
+        void setCtrl(RawTable *raw, size i, i8 value) noexcept
+        {
+            raw->ctrl[i] = value;
+            raw->ctrl[((i - (K_GROUP_WIDTH - 1)) & raw->mask) + (K_GROUP_WIDTH - 1)] = value;
+        }
+
+        // Nodes that can still be added before the load factor exceeds 7/8
+        size growthLeft(const RawTable *raw) noexcept
+        {
+            size limit = raw->capacity() - raw->capacity() / 8;
+            size used = raw->size + raw->tombstones;
+            return used < limit ? limit - used : 0;
+        }
+
+        template <typename Eq>
+        size find(const RawTable *raw, u64 hash, Eq &&eq) noexcept
+        {
+            if (!raw->ctrl || raw->size == 0)
+                return K_NPOS;
+
+            for (ProbeSeq seq{ hash, raw->mask };; seq.next())
+            {
+                Group group{ raw->ctrl + seq.pos };
+                for (u32 match = group.match(h2(hash)); match; match &= match - 1)
+                {
+                    size i = seq.offset(std::countr_zero(match));
+                    if (raw->slots[i]->hash == hash && eq(raw->slots[i]))
+                        return i;
+                }
+
+                if (group.matchEmpty())
+                    return K_NPOS;
+            }
+        }
+
+        void insertRaw(RawTable *raw, HashNode *node) noexcept
+        {
+            assert(raw->size + raw->tombstones < raw->capacity());
+
+            for (ProbeSeq seq{ node->hash, raw->mask };; seq.next())
+            {
+                Group group{ raw->ctrl + seq.pos };
+                if (u32 match = group.matchEmptyOrDeleted())
+                {
+                    size i = seq.offset(std::countr_zero(match));
+                    if (raw->ctrl[i] == K_DELETED)
+                        raw->tombstones--;
+
+                    setCtrl(raw, i, h2(node->hash));
+                    raw->slots[i] = node;
+                    raw->size++;
+                    return;
+                }
+            }
+        }
+
+        HashNode *eraseAt(RawTable *raw, size i) noexcept
+        {
+            HashNode *node = raw->slots[i];
+            raw->size--;
+
+            // If no probe sequence ever saw a full window around `i`, no lookup
+            // went past it, and the slot can become EMPTY instead of a tombstone.
+            size before = (i - K_GROUP_WIDTH) & raw->mask;
+            u32 emptyAfter = Group{ raw->ctrl + i }.matchEmpty();
+            u32 emptyBefore = Group{ raw->ctrl + before }.matchEmpty();
+            bool wasNeverFull = emptyBefore && emptyAfter &&
+                                static_cast<size>(std::countl_zero(static_cast<u16>(emptyBefore)) + std::countr_zero(emptyAfter)) < K_GROUP_WIDTH;
+
+            if (wasNeverFull)
+                setCtrl(raw, i, K_EMPTY);
+            else
+            {
+                setCtrl(raw, i, K_DELETED);
+                raw->tombstones++;
+            }
+            return node;
+        }
+
+        // Start moving `newer` into a fresh table. Its capacity doubles, unless
+        // mostly tombstones filled it up, in which case it is only cleaned.
+        void triggerResize(SwissTable *table)
+        {
+            assert(table->older.ctrl == nullptr);
+
+            size capacity = table->newer.capacity();
+            if (capacity == 0)
+                capacity = K_MIN_CAPACITY;
+            else if (table->newer.size > capacity * 7 / 16)
+                capacity *= 2;
+
+            RawTable fresh;
+            init(&fresh, capacity);
+
+            table->older = table->newer;
+            table->newer = fresh;
+            table->migratePos = 0;
+
+            if (table->older.size == 0)
+                release(&table->older);
+        }
+
+        // Move up to `K_REHASHING_WORK` nodes from `older` to `newer`
+        void helpResize(SwissTable *table, size work = K_REHASHING_WORK) noexcept
+        {
+            RawTable *older = &table->older;
+            if (!older->ctrl)
+                return;
+
+            // Empty slots are cheap to skip, but still bound the scan
+            size nwork = 0;
+            for (size scanned = 0; nwork < work && older->size > 0 && scanned < work * 8; ++scanned)
+            {
+                size i = table->migratePos++;
+                if (!isFull(older->ctrl[i]))
+                    continue;
+
+                // Leave a tombstone, so probing for the nodes not moved yet still works
+                HashNode *node = older->slots[i];
+                setCtrl(older, i, K_DELETED);
+                older->size--;
+                insertRaw(&table->newer, node);
+                nwork++;
+            }
+
+            if (older->size == 0)
+                release(older);
+        }
+
+        size findNode(const RawTable *raw, HashNode *node) noexcept
+        {
+            return find(raw, node->hash, [node](HashNode *candidate) { return candidate == node; });
+        }
+    } // namespace
+
+    SwissTable::~SwissTable()
+    {
+        release(&newer);
+        release(&older);
+    }
+
+    HashNode *lookup(SwissTable *table, u64 hash, std::string_view key, hashtable::KeyCompareFn cmp) noexcept
+    {
+        helpResize(table);
+
+        auto eq = [&](HashNode *node) { return cmp(node, key); };
+        if (size i = find(&table->newer, hash, eq); i != K_NPOS)
+            return table->newer.slots[i];
+        if (size i = find(&table->older, hash, eq); i != K_NPOS)
+            return table->older.slots[i];
+        return nullptr;
+    }
+
+    void insert(SwissTable *table, HashNode *node)
+    {
+        if (!table->newer.ctrl || growthLeft(&table->newer) == 0)
+        {
+            // Inserts outran the migration, finish it before starting another one
+            while (table->older.ctrl)
+                helpResize(table, table->older.capacity());
+            triggerResize(table);
+        }
+
+        insertRaw(&table->newer, node);
+        helpResize(table);
+    }
+
+    void reserve(SwissTable *table, size n)
+    {
+        assert(table->newer.size == 0 && table->older.ctrl == nullptr);
+
+        // The smallest power of 2 keeping the load under 7/8
+        size capacity = K_MIN_CAPACITY;
+        while (capacity - capacity / 8 <= n)
+            capacity *= 2;
+
+        if (table->newer.capacity() >= capacity)
+            return;
+        release(&table->newer);
+        init(&table->newer, capacity);
+    }
+
+    HashNode *remove(SwissTable *table, u64 hash, std::string_view key, hashtable::KeyCompareFn cmp) noexcept
+    {
+        helpResize(table);
+
+        auto eq = [&](HashNode *node) { return cmp(node, key); };
+        if (size i = find(&table->newer, hash, eq); i != K_NPOS)
+            return eraseAt(&table->newer, i);
+        if (size i = find(&table->older, hash, eq); i != K_NPOS)
+        {
+            HashNode *node = eraseAt(&table->older, i);
+            if (table->older.size == 0)
+                release(&table->older);
+            return node;
+        }
+        return nullptr;
+    }
+
+    void replace(SwissTable *table, HashNode *from, HashNode *to) noexcept
+    {
+        assert(from->hash == to->hash);
+
+        for (RawTable *raw : { &table->newer, &table->older })
+        {
+            if (size i = findNode(raw, from); i != K_NPOS)
+            {
+                raw->slots[i] = to;
+                return;
+            }
+        }
+        assert(false && "replaced node is not in the table");
+    }
+
+    size tableBytes(const SwissTable *table) noexcept
+    {
+        size bytes = 0;
+        for (const RawTable *raw : { &table->newer, &table->older })
+        {
+            if (raw->ctrl)
+                bytes += raw->capacity() * sizeof(HashNode *) + raw->capacity() + K_GROUP_WIDTH - 1;
+        }
+        return bytes;
+    }
+
+    size sample(const SwissTable *table, u64 random, HashNode **out, size n) noexcept
+    {
+        size count = 0;
+        for (const RawTable *raw : { &table->newer, &table->older })
+        {
+            if (!raw->ctrl || raw->size == 0)
+                continue;
+
+            size pos = random & raw->mask;
+            size steps = std::min(raw->capacity(), n * 10);
+            for (size step = 0; step < steps && count < n; ++step)
+            {
+                size i = (pos + step) & raw->mask;
+                if (isFull(raw->ctrl[i]))
+                    out[count++] = raw->slots[i];
+            }
+        }
+        return count;
+    }
+
+    u64 scan(const SwissTable *table, u64 cursor, std::vector<HashNode *> &out)
+    {
+        const RawTable *large = &table->newer;
+        const RawTable *small = table->older.ctrl ? &table->older : &table->newer;
+        if (!large->ctrl)
+            return 0;
+        assert(small->mask <= large->mask);
+
+        // A bucket is the set of nodes whose probe sequence starts at a slot, they all sit
+        // before the first group with an EMPTY slot on that sequence
+        auto collect = [&out](const RawTable *raw, size home) {
+            ProbeSeq seq{ 0, raw->mask };
+            seq.pos = home;
+            for (;; seq.next())
+            {
+                Group group{ raw->ctrl + seq.pos };
+                for (u32 full = ~group.matchEmptyOrDeleted() & 0xFFFF; full; full &= full - 1)
+                {
+                    HashNode *node = raw->slots[seq.offset(std::countr_zero(full))];
+                    if ((h1(node->hash) & raw->mask) == home)
+                        out.push_back(node);
+                }
+                if (group.matchEmpty())
+                    break;
+            }
+        };
+
+        // A same-size cleanup keeps the mask, the nodes it already moved sit at the same home
+        // in `newer` and scanBuckets() only visits `older`
+        bool sameSize = table->older.ctrl && small->mask == large->mask;
+        return hashtable::scanBuckets(cursor, small->mask, large->mask, [&](bool inLarge, size home) {
+            collect(inLarge ? large : small, home);
+            if (sameSize)
+                collect(large, home);
+        });
+    }
+
+    void prefetchBucket(const SwissTable *table, u64 hash) noexcept
+    {
+        for (const RawTable *raw : { &table->newer, &table->older })
+        {
+            if (!raw->ctrl)
+                continue;
+            size pos = h1(hash) & raw->mask;
+            __builtin_prefetch(raw->ctrl + pos);
+            __builtin_prefetch(raw->slots + pos);
+        }
+    }
+
+    void prefetchNode(const SwissTable *table, u64 hash) noexcept
+    {
+        for (const RawTable *raw : { &table->newer, &table->older })
+        {
+            if (!raw->ctrl)
+                continue;
+            ProbeSeq seq{ hash, raw->mask };
+            if (u32 match = Group{ raw->ctrl + seq.pos }.match(h2(hash)))
+                __builtin_prefetch(raw->slots[seq.offset(std::countr_zero(match))]);
+        }
+    }
+} // namespace my_redis::swisstable
@@ -0,0 +1,192 @@
+#include "zset.hpp"
+
+#include "hash.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace my_redis::zset
+{
+    using namespace my_redis::types;
+    using hashtable::HashNode;
+
+    namespace
+    {
+        ZNode *fromHmap(HashNode *node) noexcept
+        {
+            return reinterpret_cast<ZNode *>(reinterpret_cast<char *>(node) - offsetof(ZNode, hmap));
+        }
+
+        bool nameEquals(HashNode *node, std::string_view name) noexcept
+        {
+            return fromHmap(node)->name() == name;
+        }
+
+        ZNode *createNode(std::string_view name, double score)
+        {
+            void *mem = std::malloc(sizeof(ZNode) + name.size());
+            if (!mem)
+                throw std::bad_alloc{};
+
+            auto *node = new (mem) ZNode{};
+            node->hmap.hash = hash::strHash(name);
+            node->score = score;
+            node->len = static_cast<u32>(name.size());
+            std::memcpy(node + 1, name.data(), name.size());
+            return node;
+        }
+
+        void destroyNode(ZNode *node) noexcept
+        {
+            node->~ZNode();
+            std::free(node);
+        }
+
+        // Order of the tree: by score, then by name
+        bool less(const ZNode *node, double score, std::string_view name) noexcept
+        {
+            if (node->score != score)
+                return node->score < score;
+            return node->name() < name;
+        }
+
+        // First node for which `before` is false, the tree being partitioned by it
+        template <typename Before>
+        ZNode *lowerBound(ZSet *zset, Before &&before) noexcept
+        {
+            avl::AvlNode *found = nullptr;
+            for (avl::AvlNode *node = zset->root; node;)
+            {
+                if (before(fromTree(node)))
+                    node = node->right;
+                else
+                {
+                    found = node;
+                    node = node->left;
+                }
+            }
+            return fromTree(found);
+        }
+
+        void treeInsert(ZSet *zset, ZNode *node) noexcept
+        {
+            avl::AvlNode *parent = nullptr;
+            avl::AvlNode **from = &zset->root;
+            while (*from)
+            {
+                parent = *from;
+                from = less(node, fromTree(parent)->score, fromTree(parent)->name()) ? &parent->left : &parent->right;
+            }
+
+            *from = &node->tree;
+            node->tree.parent = parent;
+            zset->root = avl::fix(&node->tree);
+        }
+    } // namespace
+
+    ZSet::~ZSet()
+    {
+        // Free the nodes bottom-up, without rebalancing
+        avl::AvlNode *node = root;
+        while (node)
+        {
+            if (node->left)
+                node = node->left;
+            else if (node->right)
+                node = node->right;
+            else
+            {
+                avl::AvlNode *parent = node->parent;
+                if (parent)
+                    (parent->left == node ? parent->left : parent->right) = nullptr;
+                destroyNode(fromTree(node));
+                node = parent;
+            }
+        }
+        hashmap::clear(&members);
+    }
+
+    ZNode *lookup(ZSet *zset, std::string_view name) noexcept
+    {
+        HashNode *node = hashmap::lookup(&zset->members, hash::strHash(name), name, nameEquals);
+        return node ? fromHmap(node) : nullptr;
+    }
+
+    bool insert(ZSet *zset, std::string_view name, double score)
+    {
+        if (ZNode *node = lookup(zset, name))
+        {
+            if (node->score != score)
+            {
+                // Reinsert at the new position
+                zset->root = avl::remove(&node->tree);
+                node->tree = {};
+                node->score = score;
+                treeInsert(zset, node);
+            }
+            return false;
+        }
+
+        ZNode *node = createNode(name, score);
+        zset->nodeBytes += sizeof(ZNode) + name.size();
+        hashmap::insert(&zset->members, &node->hmap);
+        treeInsert(zset, node);
+        return true;
+    }
+
+    bool remove(ZSet *zset, std::string_view name) noexcept
+    {
+        HashNode *removed = hashmap::remove(&zset->members, hash::strHash(name), name, nameEquals);
+        if (!removed)
+            return false;
+
+        ZNode *node = fromHmap(removed);
+        zset->root = avl::remove(&node->tree);
+        zset->nodeBytes -= sizeof(ZNode) + node->len;
+        destroyNode(node);
+        return true;
+    }
+
+    ZNode *seekGe(ZSet *zset, double score, std::string_view name) noexcept
+    {
+        return lowerBound(zset, [&](const ZNode *node) { return less(node, score, name); });
+    }
+
+    ZNode *seekGt(ZSet *zset, double score) noexcept
+    {
+        return lowerBound(zset, [score](const ZNode *node) { return node->score <= score; });
+    }
+
+    ZNode *byRank(ZSet *zset, i64 rank) noexcept
+    {
+        if (rank < 0 || rank >= static_cast<i64>(avl::count(zset->root)))
+            return nullptr;
+
+        // Descend from the root, using the subtree sizes to pick a side
+        avl::AvlNode *node = zset->root;
+        while (true)
+        {
+            i64 left = avl::count(node->left);
+            if (rank < left)
+                node = node->left;
+            else if (rank == left)
+                return fromTree(node);
+            else
+            {
+                rank -= left + 1;
+                node = node->right;
+            }
+        }
+    }
+
+    ZNode *offset(ZNode *node, i64 offset) noexcept
+    {
+        return node ? fromTree(avl::offset(&node->tree, offset)) : nullptr;
+    }
+
+    i64 rank(const ZNode *node) noexcept
+    {
+        return avl::rank(&node->tree);
+    }
+} // namespace my_redis::zset